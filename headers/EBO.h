@@ -12,6 +12,7 @@ public:
     // Constructor that generates a Elements Buffer Object and links it to indices
     EBO(GLuint *indices, GLsizeiptr size);
     EBO(std::vector<GLuint> &indices);
+    EBO(const std::vector<GLushort> &indices);
 
     // Binds the EBO
     void Bind();
@@ -0,0 +1,26 @@
+#ifndef UBO_CLASS_H
+#define UBO_CLASS_H
+
+#include <glad/glad.h>
+
+class UBO
+{
+public:
+    // ID reference of the Uniform Buffer Object
+    GLuint ID;
+    // Constructor that generates a Uniform Buffer Object with room for 'size' bytes
+    UBO(GLsizeiptr size);
+
+    // Overwrites 'size' bytes starting at 'offset'
+    void Update(const void *data, GLsizeiptr size, GLintptr offset = 0);
+    // Attaches the UBO to a uniform block binding point
+    void BindBase(GLuint binding);
+    // Binds the UBO
+    void Bind();
+    // Unbinds the UBO
+    void Unbind();
+    // Deletes the UBO
+    void Delete();
+};
+
+#endif
@@ -16,8 +16,8 @@ public:
     // Constructor that generates a VAO ID
     VAO();
 
-    // Links a VBO to the VAO using a certain layout
-    void LinkAttrib(VBO &VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void *offset);
+    // Links a VBO to the VAO using a certain layout, integer types can be read as normalized floats
+    void LinkAttrib(VBO &VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void *offset, GLboolean normalized = GL_FALSE);
     // Binds the VAO
     void Bind();
     // Unbinds the VAO
@@ -18,6 +18,8 @@ public:
     unsigned int ID;
     VBO(GLfloat *vertices, GLsizeiptr size);
     VBO(std::vector<Vertex> &vertices);
+    // Already packed vertices, see VertexLayout
+    VBO(const std::vector<unsigned char> &data);
 
     void Bind();
     void Unbind();
@@ -0,0 +1,54 @@
+#ifndef ACCESSOR_CLASS_H
+#define ACCESSOR_CLASS_H
+
+#include <glad/glad.h>
+#include <cstddef>
+
+#include "json.h"
+
+using json = nlohmann::json;
+
+// glTF accessor component types
+enum ComponentType : unsigned int
+{
+    COMPONENT_BYTE = 5120,
+    COMPONENT_UNSIGNED_BYTE = 5121,
+    COMPONENT_SHORT = 5122,
+    COMPONENT_UNSIGNED_SHORT = 5123,
+    COMPONENT_UNSIGNED_INT = 5125,
+    COMPONENT_FLOAT = 5126
+};
+
+// Typed, read-only view of a glTF accessor that points straight into the binary buffer
+class AccessorView
+{
+public:
+    // First byte of the first element (nullptr when the accessor has no bufferView)
+    const unsigned char *base = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    unsigned int numComponents = 1;
+    unsigned int componentType = COMPONENT_FLOAT;
+    unsigned int componentSize = 4;
+    bool normalized = false;
+
+    AccessorView() = default;
+    // Resolves the accessor's bufferView, offsets and stride against 'data'
+    AccessorView(const json &gltf, const json &accessor, const unsigned char *data, size_t dataSize);
+
+    // Reads a single component of an element, converted to float (normalized integers are remapped)
+    float ReadFloat(size_t element, unsigned int component) const;
+    // Reads a scalar element as an index
+    GLuint ReadIndex(size_t element) const;
+
+    // Writes every element as floats into 'out', advancing 'outStride' bytes per element.
+    // Tightly packed float data going into a tightly packed destination is a single memcpy.
+    void CopyFloats(float *out, unsigned int outComponents, size_t outStride) const;
+    // Widens every scalar element into 'out'
+    void CopyIndices(GLuint *out) const;
+
+private:
+    bool isPacked(size_t outStride) const;
+};
+
+#endif
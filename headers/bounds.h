@@ -0,0 +1,58 @@
+#ifndef BOUNDS_CLASS_H
+#define BOUNDS_CLASS_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct AABB
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+    float SurfaceArea() const
+    {
+        glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+    bool Contains(const AABB &other) const
+    {
+        return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+    }
+
+    // Grows the box to contain 'point'
+    void Expand(const glm::vec3 &point);
+    // Grows the box to contain 'other'
+    void Expand(const AABB &other);
+    // Box that contains this box after it is transformed by 'matrix'
+    AABB Transform(const glm::mat4 &matrix) const;
+};
+
+// The six planes (xyz normal pointing inwards, w distance) of a view-projection matrix
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    static Frustum FromMatrix(const glm::mat4 &viewProjection);
+
+    bool Intersects(const AABB &box) const;
+};
+
+// World space boxes stored as structure of arrays so the culling loop runs over contiguous floats
+struct BoundsSoA
+{
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    void Clear();
+    void Push(const AABB &box);
+    size_t Size() const { return centerX.size(); }
+};
+
+// Sets visible[i] to 1 if box i touches the frustum and 0 otherwise.
+// Branch free over the boxes so the compiler can vectorize it; returns the number of visible boxes.
+size_t CullBoxes(const Frustum &frustum, const BoundsSoA &boxes, unsigned char *visible);
+
+#endif
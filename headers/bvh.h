@@ -0,0 +1,85 @@
+#ifndef BVH_CLASS_H
+#define BVH_CLASS_H
+
+#include <functional>
+#include <vector>
+
+#include "bounds.h"
+
+// Dynamic bounding volume hierarchy over world space boxes.
+// Leaves are handed out as proxies that stay valid until removed; moving a leaf refits its
+// ancestors, and the tree is rebuilt top-down with the surface area heuristic when it degrades.
+class BVH
+{
+public:
+    // Leaves store a slightly enlarged box so small moves don't touch the tree
+    float margin = 0.1f;
+    // Rebuild once the SAH cost grows past this multiple of the cost after the last rebuild
+    float rebuildThreshold = 1.5f;
+
+    // Adds a box and returns its proxy
+    int Insert(const AABB &box, void *userData);
+    // Removes a proxy
+    void Remove(int proxy);
+    // Updates the box of a proxy and refits its ancestors, returns false if the stored box still covered it
+    bool Move(int proxy, const AABB &box);
+    // Rebuilds the whole tree with binned SAH, proxies are preserved
+    void Rebuild();
+
+    // Calls 'callback' with the user data of every leaf touching the frustum
+    void QueryFrustum(const Frustum &frustum, const std::function<void(void *)> &callback) const;
+    // Calls 'callback' with the user data of every leaf touching the sphere
+    void QuerySphere(const glm::vec3 &center, float radius, const std::function<void(void *)> &callback) const;
+    // Returns the user data of the closest leaf box hit by the ray (nullptr if none), 'distance' receives the hit distance
+    void *Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &distance) const;
+
+    void *UserData(int proxy) const { return nodes[proxy].userData; }
+    const AABB &Box(int proxy) const { return nodes[proxy].box; }
+    size_t LeafCount() const { return leafCount; }
+    int Height() const { return root == -1 ? 0 : nodes[root].height; }
+    // Sum of internal node surface areas relative to the root's
+    float Cost() const;
+
+private:
+    struct Node
+    {
+        AABB box;
+        void *userData = nullptr;
+        int parent = -1;
+        int child1 = -1;
+        int child2 = -1;
+        // Leaves are 0, free nodes -1
+        int height = -1;
+
+        bool IsLeaf() const { return child1 == -1; }
+    };
+
+    // Leaf copied out of the tree while rebuilding, so the build passes run over contiguous memory
+    struct BuildEntry
+    {
+        AABB box;
+        glm::vec3 center;
+        int leaf;
+    };
+
+    std::vector<Node> nodes;
+    int root = -1;
+    int freeList = -1;
+    size_t leafCount = 0;
+    float rebuiltCost = 0.0f;
+    // Inserts and refits since the cost was last measured
+    int changesSinceCheck = 0;
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    // Recomputes the boxes and heights from 'node' up to the root
+    void refit(int node);
+    // Rebuilds if enough changes piled up and the cost has grown past the threshold
+    void checkQuality();
+    // Builds a subtree over entries[begin, end) and returns its root
+    int build(std::vector<BuildEntry> &entries, size_t begin, size_t end);
+};
+
+#endif
@@ -29,6 +29,11 @@ public:
     bool firstClick = true;
     bool isAutoRotating = false;
 
+    // Set by a left click, the world space ray under the cursor for the scene to pick with
+    bool pickRequested = false;
+    glm::vec3 pickOrigin = glm::vec3(0.0f);
+    glm::vec3 pickDirection = glm::vec3(0.0f, 0.0f, -1.0f);
+
     int width;
     int height;
 
@@ -38,9 +43,12 @@ public:
     Camera(int width, int height, glm::vec3 position);
 
     void updateMatrix(float FOVdeg, float nearPlane, float farPlane);
-    void Matrix(Shader &shader, const char *uniform);
+    // Sends the camera matrix and position through the shader's cached locations
+    void Matrix(Shader &shader);
 
     void Inputs(GLFWwindow *window);
+    // Unprojects a cursor position (in pixels) into 'pickOrigin' and 'pickDirection'
+    void CursorRay(double cursorX, double cursorY);
     void autoRotate(GLFWwindow *window, float centerX, float centerY, float centerZ, float distance, float rotationSpeed);
 };
 #endif
\ No newline at end of file
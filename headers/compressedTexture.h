@@ -0,0 +1,90 @@
+#ifndef COMPRESSED_TEXTURE_CLASS_H
+#define COMPRESSED_TEXTURE_CLASS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "mappedFile.h"
+
+// S3TC and BPTC are extensions on a 3.3 context, the loader may not have been generated with them
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// One mip level inside a container file
+struct CompressedLevel
+{
+    size_t offset;
+    size_t size;
+    int width;
+    int height;
+};
+
+// A block compressed 2D texture with its mip chain, read straight out of a mapped .dds or .ktx2 file.
+// The renderer uploads rows bottom first (the PNG path flips on load), files storing the top row first are
+// flipped by CompressedTexture::Load into 'flipped'.
+struct CompressedImage
+{
+    GLenum internalFormat = 0;
+    int width = 0;
+    int height = 0;
+    // Set by the parsers: always for DDS, for KTX2 unless its "KTXorientation" says y goes up
+    bool topRowFirst = false;
+    // Largest level first, offsets into 'flipped' when it is not empty, into 'file' otherwise
+    std::vector<CompressedLevel> levels;
+    MappedFile file;
+    std::vector<unsigned char> flipped;
+
+    const unsigned char *Data(const CompressedLevel &level) const { return (flipped.empty() ? file.Data() : flipped.data()) + level.offset; }
+    // Bytes of every level
+    size_t Bytes() const;
+};
+
+// Reads DDS and KTX2 containers holding BC1, BC3, BC4, BC5 or BC7 data
+class CompressedTexture
+{
+public:
+    // Maps 'path' and parses it by extension (.dds or .ktx2), false if missing, not a supported layout or stored
+    // top row first in a way FlipRows can't turn around
+    static bool Load(const std::string &path, CompressedImage &image);
+    static bool ParseDDS(const unsigned char *data, size_t size, CompressedImage &image);
+    static bool ParseKTX2(const unsigned char *data, size_t size, CompressedImage &image);
+    // Copies every level into 'flipped' with the row order reversed, moving whole block rows and the rows inside
+    // each block. False for BC7, whose blocks can't be flipped without re-encoding, and for levels taller than a
+    // block whose height isn't a multiple of 4.
+    static bool FlipRows(CompressedImage &image);
+    // Writes a KTX2 file holding 'levels', largest first, bottom row first (orientation "ru").
+    // DDS has no way to say so, which is why the encoder doesn't write it.
+    static bool WriteKTX2(const std::string &path, GLenum internalFormat, int width, int height, const std::vector<std::vector<unsigned char>> &levels);
+
+    // Bytes per 4x4 block (8 or 16), 0 for formats this class doesn't know
+    static size_t BlockBytes(GLenum internalFormat);
+    // Bytes of a 'width' x 'height' level
+    static size_t LevelBytes(GLenum internalFormat, int width, int height);
+    // sRGB twin of a color format (BC1, BC3, BC7), 0 for the ones without one
+    static GLenum SRGBFormat(GLenum internalFormat);
+    static const char *FormatName(GLenum internalFormat);
+};
+
+#endif
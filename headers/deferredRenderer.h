@@ -0,0 +1,70 @@
+#ifndef DEFERRED_RENDERER_CLASS_H
+#define DEFERRED_RENDERER_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "shaderClass.h"
+#include "VAO.h"
+
+// Texture units of the lighting passes, between the material maps and the light cluster buffers
+const GLuint LIGHTING_TEXTURE_UNIT = 8;
+const GLuint GBUFFER_ALBEDO_TEXTURE_UNIT = 9;
+const GLuint GBUFFER_NORMAL_TEXTURE_UNIT = 10;
+const GLuint GBUFFER_DEPTH_TEXTURE_UNIT = 11;
+
+// Deferred alternative to shading every rasterized fragment: the scene is drawn once into a G-buffer
+// (gbuffer.glsl), a fullscreen pass adds the ambient and directional light, and every point light
+// is added by an instanced light volume, all into an HDR buffer that is tone mapped into the target.
+class DeferredRenderer
+{
+public:
+    // Point lights through light volumes, otherwise the fullscreen pass loops over the light clusters
+    bool lightVolumes = true;
+
+    DeferredRenderer();
+    ~DeferredRenderer();
+
+    // Program for the scene's draws between Begin and End, stores the material instead of shading it
+    Shader &GeometryShader() { return geometryShader; }
+
+    // Binds the G-buffer, sized to the current viewport, and clears it
+    void Begin();
+    // Lights the G-buffer into the framebuffer bound at Begin and writes the scene depth there
+    void End(Camera &camera);
+
+    glm::ivec2 Size() const { return size; }
+    // G-buffer and lighting buffer bytes per pixel, depth included
+    static size_t BytesPerPixel();
+    // Mode and buffer size for the "Global" panel
+    void UI();
+
+private:
+    Shader geometryShader;
+    Shader lightingShader;
+    Shader volumeShader;
+    Shader resolveShader;
+
+    // Albedo / ao, normal / roughness / metallic and depth
+    GLuint gBuffer = 0;
+    GLuint albedoAo = 0, normalRM = 0, depth = 0;
+    // HDR sum of the lighting passes, with its own copy of the depth for the light volumes' depth test
+    GLuint lightBuffer = 0;
+    GLuint lighting = 0, lightingDepth = 0;
+    glm::ivec2 size = glm::ivec2(0);
+
+    // The fullscreen triangle is made in deferred.vert, it needs no buffers
+    VAO emptyVAO;
+    VAO volumeVAO;
+    GLsizei volumeIndices = 0;
+
+    // Restored by End
+    GLint targetFramebuffer = 0;
+    GLint targetViewport[4] = {};
+
+    // Reallocates every attachment when the viewport changed size
+    void resize(glm::ivec2 newSize);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef DEPTH_PREPASS_CLASS_H
+#define DEPTH_PREPASS_CLASS_H
+
+#include <glad/glad.h>
+
+#include "shaderClass.h"
+#include "renderStats.h"
+#include "VAO.h"
+
+// When the scene gets a depth-only pass before shading
+enum class PrepassMode
+{
+    Off,
+    On,
+    // On while the measured overdraw is above DepthPrepass::threshold
+    Auto
+};
+
+// Optional depth-only pass in front of the scene's shading pass. The scene is drawn once with prepass.vert,
+// which only reads the position stream (GeometryArena::positionVAO), then again with the real programs
+// against a GL_EQUAL depth test, so each covered pixel runs the expensive fragment shader once.
+// Occlusion queries count the fragments passing the depth test in both passes: their ratio is the overdraw
+// the shading pass has without the pre-pass, which is what Auto decides on.
+class DepthPrepass
+{
+public:
+    PrepassMode mode = PrepassMode::Auto;
+    // Fragments per covered pixel above which Auto draws the pre-pass
+    float threshold = 1.5f;
+    // Only a frame with the pre-pass measures the overdraw, so Auto draws one this often while it is off
+    int probeInterval = 30;
+    // Replaces the frame with a heat map of how often each pixel was shaded, counted in the stencil buffer
+    bool showOverdraw = false;
+
+    DepthPrepass();
+    ~DepthPrepass();
+
+    // Program for the scene's draws between Begin and Shade
+    Shader &DepthShader() { return depthShader; }
+    // Whether this frame draws the pre-pass, decided by Begin
+    bool Active() const { return active; }
+
+    // Picks up the last measurement and starts the depth pass when Active, color writes stay off until Shade
+    void Begin();
+    // Starts the shading pass, with GL_EQUAL and no depth writes after a depth pass
+    void Shade();
+    // Restores the depth state and draws the heat map over the framebuffer when 'showOverdraw'
+    void End();
+
+    // Fragments per covered pixel of the last measured frame, 0 before the first measurement
+    float Overdraw() const { return overdraw; }
+    // Mode, overdraw counter and heat map toggle for the "Global" panel
+    void UI();
+
+private:
+    Shader depthShader;
+    Shader heatMapShader;
+    // The heat map is a fullscreen triangle from deferred.vert
+    VAO emptyVAO;
+
+    // GL_SAMPLES_PASSED of the depth pass and of the shading pass after it
+    GLuint depthQuery = 0;
+    GLuint shadeQuery = 0;
+    bool active = false;
+    bool measuring = false;
+    // Queries issued but not read yet, no new ones start until they are
+    bool pending = false;
+    int framesSinceMeasure = 0;
+
+    float overdraw = 0.0f;
+    GLuint64 fragments = 0;
+    GLuint64 pixels = 0;
+
+    // Counters at Begin, the depth pass's own are kept apart so the panel shows the shading pass
+    RenderStats start;
+    unsigned int depthDrawCalls = 0;
+    unsigned int depthTriangles = 0;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef GEOMETRY_ARENA_CLASS_H
+#define GEOMETRY_ARENA_CLASS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "VAO.h"
+#include "EBO.h"
+#include "vertexLayout.h"
+
+// Best fit free list over a range of units, freed blocks merge with their free neighbours
+class RangeAllocator
+{
+public:
+    static const size_t INVALID = (size_t)-1;
+
+    explicit RangeAllocator(size_t capacity = 0);
+
+    // Offset of 'size' free units, or INVALID when no free block is large enough
+    size_t Allocate(size_t size);
+    void Free(size_t offset, size_t size);
+    // Adds 'extra' free units at the end of the range
+    void Grow(size_t extra);
+
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return used; }
+    size_t FreeBlocks() const { return freeByOffset.size(); }
+    size_t LargestFree() const;
+    // 0 while the free space is one block, towards 1 as it splits into many small ones
+    float Fragmentation() const;
+
+private:
+    size_t capacity = 0;
+    size_t used = 0;
+    // Free blocks as offset -> size, and the same blocks as size -> offset for the best fit search
+    std::map<size_t, size_t> freeByOffset;
+    std::multimap<size_t, size_t> freeBySize;
+
+    void insertFree(size_t offset, size_t size);
+    void eraseFree(std::map<size_t, size_t>::iterator block);
+};
+
+// Where a mesh lives inside its arena. Indices stay relative to the mesh's own vertices and are
+// drawn with 'baseVertex', so 16 bit indices keep working in a large buffer.
+struct GeometryAllocation
+{
+    GLint baseVertex = 0;
+    size_t vertexCount = 0;
+    // Byte offset and size inside the index buffer, always a multiple of 4
+    size_t indexOffset = 0;
+    size_t indexBytes = 0;
+    // Unique for every Allocate call and never reused, unlike the ranges, so caches can key on it
+    uint64_t id = 0;
+};
+
+// One large vertex buffer and index buffer shared by every mesh stored in the same VertexLayout,
+// so all of them draw from a single VAO. Buffers double in size when they run out of space.
+// A second vertex buffer repeats just the positions, so depth-only passes fetch nothing else.
+class GeometryArena
+{
+public:
+    // Space reserved up front, vertices and index bytes
+    static const size_t INITIAL_VERTICES = 1 << 18;
+    static const size_t INITIAL_INDEX_BYTES = 4 << 20;
+
+    const VertexLayout layout;
+    VAO vao;
+    // Same meshes and indices with only the position attribute, for programs that read nothing else
+    VAO positionVAO;
+
+    explicit GeometryArena(const VertexLayout &layout);
+
+    // Copies already packed vertices and indices into the arena. GL thread only.
+    GeometryAllocation Allocate(const std::vector<unsigned char> &vertices, const void *indices, size_t indexBytes);
+    void Free(const GeometryAllocation &allocation);
+
+    // VAO a program draws from, see Shader::PositionOnly
+    VAO &VertexArray(bool positionOnly) { return positionOnly ? positionVAO : vao; }
+
+    const RangeAllocator &Vertices() const { return vertexRanges; }
+    const RangeAllocator &Indices() const { return indexRanges; }
+
+    // Arena of meshes stored in 'layout', created on first use
+    static GeometryArena &For(const VertexLayout &layout);
+    // Utilization and fragmentation of every arena for the "Global" panel
+    static void UI();
+    // 'listener' hears the id of every allocation any arena frees from now on, until removed by 'owner'.
+    // For caches keyed on GeometryAllocation::id.
+    static void AddFreeListener(const void *owner, std::function<void(uint64_t)> listener);
+    static void RemoveFreeListener(const void *owner);
+
+private:
+    VBO vertexBuffer;
+    VBO positionBuffer;
+    EBO indexBuffer;
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+
+    // Replace the buffer with one holding at least 'needed' more units, keeping the contents
+    void growVertices(size_t needed);
+    void growIndices(size_t needed);
+    // Points the VAO at the current buffers
+    void linkBuffers();
+
+    static std::vector<std::unique_ptr<GeometryArena>> &arenas();
+    static std::vector<std::pair<const void *, std::function<void(uint64_t)>>> &freeListeners();
+};
+
+#endif
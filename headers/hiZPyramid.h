@@ -0,0 +1,47 @@
+#ifndef HI_Z_PYRAMID_CLASS_H
+#define HI_Z_PYRAMID_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+
+#include "shaderClass.h"
+
+// Texture unit the pyramid is bound to while cull.comp reads it, above the material and environment maps
+const GLuint HI_Z_TEXTURE_UNIT = 15;
+
+// Mip chain of the depth buffer where every texel holds the farthest depth of the pixels below it, so one
+// to four fetches tell whether a screen rectangle is hidden behind what is already drawn. Needs GL 4.3.
+class HiZPyramid
+{
+public:
+    HiZPyramid();
+    ~HiZPyramid();
+
+    // Whether hiz.comp compiled
+    bool Available() const { return program && program->Linked(); }
+    // Copies the depth of the current viewport from the read framebuffer and rebuilds every level
+    void Build();
+    // Binds the R32F pyramid to HI_Z_TEXTURE_UNIT
+    void Bind() const;
+    // Binds the pyramid and sets the hiz_test.glsl uniforms of 'program' (already active), except 'viewProjection'
+    void Bind(Shader &program) const;
+
+    // Size of level 0 (the viewport) and index of the 1x1 level
+    glm::ivec2 Size() const { return size; }
+    int MaxLevel() const { return levels - 1; }
+
+private:
+    std::unique_ptr<Shader> program;
+    // Depth copy of the viewport and the max reduced chain built from it
+    GLuint depthCopy = 0;
+    GLuint pyramid = 0;
+    glm::ivec2 size = glm::ivec2(0);
+    int levels = 0;
+
+    // Reallocates both textures when the viewport changed size
+    void resize(glm::ivec2 newSize);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef IBL_CACHE_CLASS_H
+#define IBL_CACHE_CLASS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bump when the baking shaders or the file layout change, so stale caches are ignored
+const uint32_t IBL_CACHE_VERSION = 4;
+
+// Face sizes of the baked maps, shared by Skybox and the offline baker
+const int IBL_ENVIRONMENT_SIZE = 2048;
+const int IBL_PREFILTER_SIZE = 128;
+const int IBL_PREFILTER_LEVELS = 5;
+const int IBL_BRDF_SIZE = 512;
+// Environment mip the irradiance harmonics are projected from, order 2 harmonics hold no finer detail
+const int IBL_SH_SOURCE_SIZE = 32;
+
+// A 2D texture or cubemap stored in a cache file, every level as half floats
+struct CachedTexture
+{
+    GLuint ID = 0;
+    GLenum target = GL_TEXTURE_2D;
+    GLenum internalFormat = GL_RGB16F;
+    // GL_RGB or GL_RG
+    GLenum format = GL_RGB;
+    GLsizei size = 0;
+    GLint levels = 1;
+};
+
+// Reads and writes baked image based lighting textures so they only have to be rendered once
+class IBLCache
+{
+public:
+    // 64-bit FNV-1a, chain calls through 'hash' to combine several inputs
+    static uint64_t Hash(const void *data, size_t size, uint64_t hash = 14695981039346656037ull);
+    // Hash of a file's contents (0 if it cannot be opened)
+    static uint64_t HashFile(const std::string &path);
+    // Cache key of the maps baked from an HDR: its contents, the bake sizes and the cache version
+    static uint64_t EnvironmentKey(const std::string &hdrPath);
+    // File name (without folder) of the environment cache for 'key'
+    static std::string EnvironmentFile(uint64_t key);
+
+    // Reads every texture back from GL and writes them after a header holding 'key'
+    static bool Write(const std::string &path, uint64_t key, const std::vector<CachedTexture> &textures);
+    // Creates the textures stored in 'path' (filled in to 'textures') if the file exists and matches 'key'.
+    // Only the stored levels are created (GL_TEXTURE_MAX_LEVEL is clamped to them), filtering is left to the caller.
+    static bool Read(const std::string &path, uint64_t key, std::vector<CachedTexture> &textures);
+
+    // GL free halves of Write and Read, for tools running without a context.
+    // 'pixels[i]' holds every level (and face) of 'textures[i]' back to back as half floats.
+    static bool WritePixels(const std::string &path, uint64_t key, const std::vector<CachedTexture> &textures, const std::vector<const void *> &pixels);
+    // Validates a mapped cache file and points 'pixels' into it, 'key' receives the stored key
+    static bool Parse(const unsigned char *data, size_t size, uint64_t &key, std::vector<CachedTexture> &textures, std::vector<const unsigned char *> &pixels);
+    // Bytes of every level and face of 'texture'
+    static size_t TextureBytes(const CachedTexture &texture);
+};
+
+#endif
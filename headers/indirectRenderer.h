@@ -0,0 +1,212 @@
+#ifndef INDIRECT_RENDERER_CLASS_H
+#define INDIRECT_RENDERER_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.h"
+#include "UBO.h"
+#include "uniformBlocks.h"
+#include "hiZPyramid.h"
+#include "occlusionBuffer.h"
+
+// Attribute location of the per object index read by indirect.vert
+const GLuint DRAW_ID_ATTRIB_LOCATION = 11;
+
+// Storage buffer binding points used by indirect.glsl and cull.comp
+enum StorageBinding
+{
+    INDIRECT_OBJECT_BINDING = 0,
+    INDIRECT_MESH_BINDING = 1,
+    INDIRECT_COMMAND_BINDING = 2,
+    INDIRECT_VISIBILITY_BINDING = 3,
+    INDIRECT_STATS_BINDING = 4
+};
+
+// Layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// CPU mirrors of the std430 structs in res/shaders/indirect.glsl, keep both in sync
+struct IndirectMeshBlock
+{
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
+    GLuint firstIndex[MAX_MESH_LODS];
+    GLuint count[MAX_MESH_LODS];
+    float error[MAX_MESH_LODS];
+    GLint baseVertex;
+    GLuint lodCount;
+    GLuint pad[2];
+};
+
+struct IndirectObjectBlock
+{
+    glm::mat4 model;
+    glm::vec4 albedoRoughness;
+    glm::vec4 metallicAoLod;
+    GLuint mesh;
+    GLuint pad[3];
+};
+
+// Counters cull.comp adds to, same layout as its CullStats block
+struct IndirectCullStats
+{
+    GLuint drawn;
+    GLuint frustumCulled;
+    GLuint occluded;
+    GLuint triangles;
+    GLuint lodDraws[MAX_MESH_LODS];
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "Indirect commands are five 32 bit values");
+static_assert(sizeof(IndirectMeshBlock) == 128, "IndirectMesh must match std430");
+static_assert(sizeof(IndirectObjectBlock) == 112, "IndirectObject must match std430");
+
+// GPU driven drawing of untextured meshes: objects and meshes live in storage buffers, a compute pass
+// (or the CPU when compute is unavailable) culls them, picks their level of detail and writes the draw
+// commands, then every geometry arena and index type is drawn with one glMultiDrawElementsIndirect.
+// With occlusion culling the draws happen in two phases: the objects visible last frame are drawn, a
+// Hi-Z pyramid is built from the resulting depth and everything else is tested against it. Without
+// compute the test runs against a small software depth buffer holding the phase 0 objects instead.
+class IndirectRenderer
+{
+public:
+    // Build the commands on the GPU, falls back to the CPU when the cull program is unavailable
+    bool computeCulling = true;
+    // Reads the compute pass's commands back and compares them with the CPU build every flush (slow).
+    // The CPU starts from the GPU's visibility history, so phase 0 must match exactly. Phase 1 is tested
+    // against a software depth buffer instead of the Hi-Z pyramid, so only its draws' ranges are compared and
+    // that it draws nothing phase 0 drew or the frustum rejects.
+    bool verify = false;
+    // Skips objects hidden behind the ones drawn first
+    bool occlusionCulling = true;
+    // Draws into a DeferredRenderer's G-buffer with gbuffer.frag instead of shading with pbr.frag
+    bool deferred = false;
+
+    // Compiles the programs, only construct when Supported()
+    IndirectRenderer();
+    ~IndirectRenderer();
+
+    // Whether the context has storage buffers and multi-draw indirect (GL 4.3)
+    static bool Supported();
+    // Whether cull.comp compiled, without it the CPU builds the commands
+    bool ComputeAvailable() const { return computeAvailable; }
+
+    // Queues a draw of 'mesh' with 'model' as the world matrix, 'levelOfDetail' false always draws level 0
+    void Submit(Mesh &mesh, const glm::mat4 &model, const Material &material, bool levelOfDetail);
+    // Culls and draws everything submitted since the last flush with indirect.vert and pbr.frag (or gbuffer.frag).
+    // 'depthOnly' draws just the depth for a pre-pass, the next flush of the same objects then shades those
+    // commands again without culling, against the GL_EQUAL depth test the caller sets up.
+    void Flush(Camera &camera, bool depthOnly = false);
+
+    // Objects and multi-draw calls of the last flush
+    size_t Objects() const { return lastObjects; }
+    size_t Batches() const { return lastBatches; }
+    // Commands the compute pass and the CPU disagreed on, counted while 'verify' is set
+    size_t Mismatches() const { return mismatches; }
+    // Culling mode and counters for the "Global" panel
+    void UI();
+
+private:
+    std::unique_ptr<Shader> drawProgram;
+    std::unique_ptr<Shader> geometryProgram;
+    std::unique_ptr<Shader> depthProgram;
+    std::unique_ptr<Shader> cullProgram;
+    bool computeAvailable = false;
+
+    GLuint objectBuffer = 0;
+    GLuint meshBuffer = 0;
+    GLuint commandBuffer = 0;
+    // Per object visibility of the last flush, reset to visible when the object count changes
+    GLuint visibilityBuffer = 0;
+    size_t visibilityObjects = 0;
+    // IndirectCullStats of the last GPU culls in a ring, each read back once its fence has signalled so the
+    // read never waits on the GPU. 'gpuStats' holds the newest one read.
+    static const int STATS_BUFFERS = 3;
+    GLuint statsBuffers[STATS_BUFFERS] = {};
+    GLsync statsFences[STATS_BUFFERS] = {};
+    int statsSlot = 0;
+    IndirectCullStats gpuStats = {};
+    // Counters the last culling flush added to RenderStats::frame, added again when the shading flush after
+    // a depth pre-pass reuses its commands (DepthPrepass::Shade drops everything the depth pass counted)
+    IndirectCullStats lastStats = {};
+    std::unique_ptr<HiZPyramid> hiZ;
+    // Occlusion for the CPU path, with the same per object visibility
+    OcclusionBuffer occlusionBuffer;
+    std::vector<unsigned char> cpuVisibility;
+    // 0, 1, 2... read through DRAW_ID_ATTRIB_LOCATION with a divisor, so the value equals baseInstance
+    GLuint drawIDBuffer = 0;
+    size_t drawIDCapacity = 0;
+    // All ones, the per object material is multiplied onto it
+    UBO neutralMaterial{sizeof(MaterialBlock)};
+
+    // Every live mesh seen so far, uploaded again when one is added. Keyed by GeometryAllocation::id rather
+    // than the Mesh address, which a mesh loaded after another was destroyed may get again. Slots of freed
+    // allocations go to 'freeMeshSlots' and are handed to the next new mesh.
+    std::unordered_map<uint64_t, GLuint> meshIndices;
+    std::vector<IndirectMeshBlock> meshBlocks;
+    std::vector<const Mesh *> meshList;
+    std::vector<GLuint> freeMeshSlots;
+    bool meshesDirty = false;
+
+    // This frame's submissions
+    struct Submission
+    {
+        const Mesh *mesh;
+        IndirectObjectBlock object;
+    };
+    std::vector<Submission> submissions;
+
+    // Consecutive objects sharing a VAO and index type
+    struct Batch
+    {
+        GeometryArena *arena;
+        GLenum indexType;
+        size_t first;
+        size_t count;
+    };
+    std::vector<Batch> batches;
+    std::vector<IndirectObjectBlock> objects;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    // Phases the last depth-only flush drew, 0 once they were shaded
+    GLuint prepassPhases = 0;
+    size_t prepassObjects = 0;
+
+    size_t lastObjects = 0;
+    size_t lastBatches = 0;
+    size_t mismatches = 0;
+
+    GLuint meshIndex(const Mesh &mesh);
+    // Called by GeometryArena::Free, releases the slot of a destroyed mesh
+    void forgetMesh(uint64_t id);
+    // Sorts the submissions into 'objects' and 'batches'
+    void buildBatches();
+    // Same work as cull.comp, fills both phases of 'commands' and, with 'countStats', 'lastStats'
+    void cullOnCPU(const Camera &camera, bool occlusion, bool countStats);
+    void cullOnGPU(const Camera &camera, GLuint phase, bool occlusion);
+    // Compares the GPU's commands of 'phase' with the CPU build in 'commands'
+    void verifyPhase(const Camera &camera, GLuint phase);
+    // Reads every stats buffer whose cull has finished into 'gpuStats', oldest first, without waiting
+    void readStats();
+    static void addStats(const IndirectCullStats &stats);
+    // pbr.frag, or gbuffer.frag when 'deferred'
+    Shader &shadingProgram() { return deferred ? *geometryProgram : *drawProgram; }
+    void draw(Camera &camera, GLuint phase, Shader &program);
+};
+
+#endif
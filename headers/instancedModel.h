@@ -0,0 +1,45 @@
+#ifndef INSTANCED_MODEL_CLASS_H
+#define INSTANCED_MODEL_CLASS_H
+
+#include "model.h"
+
+// Placement of one copy of an instanced model
+struct Instance
+{
+    glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
+    // Multiplied with the model's material in the shader
+    Material material;
+};
+
+// A model whose meshes are loaded once and drawn many times with glDrawElementsInstanced.
+// The model's own transform and material apply to the whole group.
+class InstancedModel : public Model
+{
+public:
+    std::vector<Instance> instances;
+
+    InstancedModel(const char *file, std::string n, bool addToList) : Model(file, n, addToList) {}
+    InstancedModel(const char *file, std::string tex, std::string n, bool addToList) : Model(file, tex, n, addToList) {}
+
+    // Adds a copy, the instance buffers are refreshed on the next draw
+    void Add(const Instance &instance);
+    // Must be called after editing 'instances' directly
+    void MarkDirty() { dirty = true; }
+
+    // Draws every instance with one instanced draw call per mesh
+    void Draw(Shader &shader, Camera &camera);
+
+private:
+    // One buffer per mesh, since every mesh carries its own node transform
+    std::vector<GLuint> instanceVBOs;
+    size_t capacity = 0;
+    bool dirty = true;
+    glm::mat4 uploadedGroupMatrix = glm::mat4(1.0f);
+
+    // Rebuilds the per-instance data of every mesh
+    void upload(const glm::mat4 &groupMatrix);
+};
+
+#endif
@@ -2,6 +2,9 @@
 #define LIGHT_CLASS_H
 
 #include "model.h"
+#include "uniformBlocks.h"
+#include "lightClusters.h"
+
 class Light : public Model
 {
 public:
@@ -17,6 +20,8 @@ public:
     std::string type;
 
     static std::vector<Light *> lights;
+    // Point lights sorted into the camera's froxels, rebuilt by UpdateFrameData
+    static LightClusters clusters;
 
     Light(const char *file, std::string n, std::string t) : type(t), Model(file, n, false)
     {
@@ -28,14 +33,23 @@ public:
         } // Increase the point light counter if it's a point light
     }
 
-    void Draw(Shader &objectShader, Shader &lightShader, Camera &camera, bool onlySetShader);
+    // Removes itself from 'lights'
+    ~Light();
+
+    // Gathers the camera and every light into the FrameData uniform block and the light clusters, uploads both once per frame
+    static void UpdateFrameData(Camera &camera);
+
+    // Distance where the attenuation drops the light below 1/256 of its color
+    float Range() const;
+    // Listed models whose bounds are within range of this point or spot light
+    std::vector<Model *> InfluencedModels() const;
 
     void UI();
 
 private:
-    void Directional(Shader &shader);
-    void Point(Shader &shader, int index); // Modify this to take the light index
-    void Spot(Shader &shader);
+    void Directional(FrameBlock &frame);
+    void Point(std::vector<PointLightBlock> &pointLights);
+    void Spot(FrameBlock &frame);
 };
 
 // Initialize static variable
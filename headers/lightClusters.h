@@ -0,0 +1,64 @@
+#ifndef LIGHT_CLUSTERS_CLASS_H
+#define LIGHT_CLUSTERS_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "camera.h"
+#include "uniformBlocks.h"
+
+// Texture units of the light, cluster and index buffers, below HI_Z_TEXTURE_UNIT
+const GLuint POINT_LIGHT_TEXTURE_UNIT = 12;
+const GLuint LIGHT_CLUSTER_TEXTURE_UNIT = 13;
+const GLuint LIGHT_INDEX_TEXTURE_UNIT = 14;
+
+// Froxel grid: tiles across and down the screen, and depth slices growing exponentially from the near plane
+const int CLUSTER_GRID_X = 16;
+const int CLUSTER_GRID_Y = 9;
+const int CLUSTER_GRID_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+// Per frame assignment of point lights to the froxels of the view frustum their range reaches.
+// The lights, the (offset, count) of every cluster and the light indices live in texture buffers,
+// so a fragment only loops over the lights of its own cluster (see LightCluster in uniforms.glsl).
+class LightClusters
+{
+public:
+    // Assigns 'lights' to the clusters of the camera's frustum, fills the grid fields of 'frame' and uploads the lists
+    void Build(const Camera &camera, const std::vector<PointLightBlock> &lights, FrameBlock &frame);
+    // Binds the three buffers to their texture units
+    void Bind() const;
+
+    size_t Lights() const { return lightCount; }
+    // Light / cluster pairs of the last build
+    size_t Assignments() const { return indices.size(); }
+    size_t OccupiedClusters() const { return occupied; }
+    GLuint MaxPerCluster() const { return maxPerCluster; }
+    // Light counts and cluster occupancy for the "Global" panel
+    void UI() const;
+
+private:
+    // Created on the first build, the lights are declared before there is a context
+    GLuint lightBuffer = 0, clusterBuffer = 0, indexBuffer = 0;
+    GLuint lightTexture = 0, clusterTexture = 0, indexTexture = 0;
+    // GL_MAX_TEXTURE_BUFFER_SIZE, the index list is cut to it
+    GLint maxTexels = 0;
+
+    // (offset, count) per cluster, x fastest, then y, then depth slice
+    std::vector<GLuint> clusters;
+    std::vector<GLuint> indices;
+    // (cluster, light) pairs before they are sorted into 'indices'
+    std::vector<std::pair<GLuint, GLuint>> pairs;
+
+    size_t lightCount = 0;
+    size_t occupied = 0;
+    GLuint maxPerCluster = 0;
+
+    void createBuffers();
+};
+
+#endif
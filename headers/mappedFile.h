@@ -0,0 +1,44 @@
+#ifndef MAPPED_FILE_CLASS_H
+#define MAPPED_FILE_CLASS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file. The file is memory mapped when the OS allows it,
+// otherwise it is read into an owned buffer, so callers never care which one they got.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    // Opens and maps 'path', throws std::runtime_error if the file cannot be opened
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+    // True if the bytes come from a mapping rather than the read() fallback
+    bool IsMapped() const { return mapped; }
+
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::vector<unsigned char> fallback;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+
+    bool mapFile(const std::string &path);
+    void readFile(const std::string &path);
+    void release();
+    void moveFrom(MappedFile &other);
+};
+
+#endif
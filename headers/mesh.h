@@ -7,6 +7,11 @@
 #include "EBO.h"
 #include "camera.h"
 #include "texture.h"
+#include "renderStats.h"
+#include "bounds.h"
+#include "meshOptimizer.h"
+#include "vertexLayout.h"
+#include "geometryArena.h"
 
 struct Material
 {
@@ -14,6 +19,31 @@ struct Material
     float roughness = 1.0f;
     float metallic = 1.0f;
     float ao = 1.0f;
+
+    bool operator==(const Material &other) const
+    {
+        return albedo == other.albedo && roughness == other.roughness && metallic == other.metallic && ao == other.ao;
+    }
+    bool operator!=(const Material &other) const { return !(*this == other); }
+};
+
+// Per-instance vertex data read by default.vert at locations 3-8
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::vec4 albedoRoughness;
+    glm::vec4 metallicAo;
+};
+
+// First attribute location of the per-instance data
+const GLuint INSTANCE_ATTRIB_LOCATION = 3;
+
+// Where the DrawElementsIndirectCommand of a draw lives when the GPU decides whether it happens (GL 4.3,
+// see OcclusionCuller). A zero buffer is a plain draw.
+struct IndirectDraw
+{
+    GLuint buffer = 0;
+    size_t offset = 0;
 };
 
 class Mesh
@@ -22,9 +52,26 @@ public:
     std::vector<Vertex> vertices;
     std::vector<GLuint> indices;
     std::vector<Texture> textures;
-    VAO VAO;
+    // Shared buffers holding this mesh, bind arena->vao before drawing
+    GeometryArena *arena = nullptr;
+    GeometryAllocation geometry;
+    // Object space bounds of the vertices
+    AABB bounds;
+    // Ranges of 'indices', finest first, there is always at least the full detail one
+    std::vector<MeshLOD> lods;
+    // GPU storage of the vertices, and GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for the indices
+    VertexLayout layout;
+    GLenum indexType;
+    // Undoes the position quantization of 'layout', passed to the shader as constant attributes
+    glm::vec3 positionScale, positionOffset;
+
+    // GPU bytes of every mesh's vertices and indices
+    static size_t vertexBytes;
+    static size_t indexBytes;
 
-    Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices, std::vector<Texture> &textures);
+    // 'lods' describes the levels packed into 'indices', empty means 'indices' is a single full detail level.
+    // Indices are stored as 16 bit whenever the vertex count allows.
+    Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices, std::vector<Texture> &textures, const std::vector<MeshLOD> &lods = std::vector<MeshLOD>(), const VertexLayout &layout = VertexLayout::Compact());
 
     void Draw(
         Shader &shader,
@@ -32,9 +79,34 @@ public:
         glm::vec3 &translation,
         glm::quat &rotation,
         glm::vec3 &scale,
-        Material &material,
         bool textured,
-        glm::mat4 matrix = glm::mat4(1.0f));
+        glm::mat4 matrix = glm::mat4(1.0f),
+        unsigned int lod = 0,
+        const IndirectDraw &indirect = IndirectDraw());
+
+    // Draws 'count' copies in one call, reading transforms and materials from 'instanceVBO' (laid out as InstanceData)
+    void DrawInstanced(
+        Shader &shader,
+        Camera &camera,
+        GLuint instanceVBO,
+        GLsizei count,
+        bool textured);
+
+    // Points the samplers of 'shader' (already active) at this mesh's textures and binds them
+    void BindTextures(Shader &shader);
+    // Issues the draw of level 'lod' with 'model' as the world matrix, assumes the program, VAO and textures are bound.
+    // With 'indirect' the command in that buffer is drawn instead, it must describe the same level.
+    void DrawElements(Shader &shader, const glm::mat4 &model, unsigned int lod = 0, const IndirectDraw &indirect = IndirectDraw());
+    // Coarsest level whose error is at most 'maxError' object space units
+    unsigned int SelectLOD(float maxError) const;
+    // Returns the mesh's space to its arena and drops its texture references, the mesh can't be drawn afterwards
+    void Delete();
+
+private:
+    // Sets the samplers, camera and per-program state shared by both draw paths
+    void bindState(Shader &shader, Camera &camera, bool textured);
+    // Sets the position dequantization attributes, they are constants and not part of the VAO
+    void setDequantization();
 };
 
 #endif
\ No newline at end of file
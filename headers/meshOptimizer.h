@@ -0,0 +1,72 @@
+#ifndef MESH_OPTIMIZER_CLASS_H
+#define MESH_OPTIMIZER_CLASS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "VBO.h"
+
+// Post-transform vertex cache behaviour of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats
+{
+    // Vertices shaded per triangle (0.5 is ideal for a regular grid, 3 means no reuse at all)
+    float acmr = 0.0f;
+    // Vertices shaded per unique vertex (1 is ideal)
+    float atvr = 0.0f;
+};
+
+// A level of detail of a mesh: a range of its index buffer, every level shares the vertices
+struct MeshLOD
+{
+    GLuint firstIndex = 0;
+    GLsizei count = 0;
+    // Object space distance the level's surface may be off from the full detail one
+    float error = 0.0f;
+};
+
+// What MeshOptimizer::Optimize did to one mesh
+struct MeshOptimizerReport
+{
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    VertexCacheStats before;
+    VertexCacheStats after;
+    // The overdraw pass can be rejected when it costs too much cache efficiency
+    bool overdrawApplied = false;
+    double milliseconds = 0.0;
+};
+
+// Import time index and vertex reordering, all functions are pure CPU work and safe on any thread
+class MeshOptimizer
+{
+public:
+    // Cache size the statistics are simulated with, a conservative guess for current GPUs
+    static const unsigned int STATS_CACHE_SIZE = 16;
+
+    // Merges bit identical vertices and rewrites 'indices' to match, returns how many were removed
+    static size_t WeldVertices(std::vector<Vertex> &vertices, std::vector<GLuint> &indices);
+    // Forsyth's linear speed triangle order, keeps recently used vertices hot in the post-transform cache
+    static void OptimizeVertexCache(std::vector<GLuint> &indices, size_t vertexCount);
+    // Reorders cache friendly clusters of triangles so outward facing ones are drawn first, keeping the
+    // result only if ACMR stays within 'threshold' times the input's. Run after OptimizeVertexCache.
+    static bool OptimizeOverdraw(std::vector<GLuint> &indices, const std::vector<Vertex> &vertices, float threshold = 1.05f);
+    // Renumbers vertices in first use order so the vertex fetch walks memory linearly, drops unused ones
+    static void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<GLuint> &indices);
+
+    // Quadric error metric edge collapse down to about 'targetIndexCount' indices. Vertices are only moved onto
+    // other existing vertices, so the result indexes the same vertex array. Open borders stay in place.
+    // 'error' receives the largest object space distance a collapse introduced.
+    static std::vector<GLuint> Simplify(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices, size_t targetIndexCount, float &error);
+    // Appends up to 'maxLODs' - 1 simplified copies of 'indices' to it, each about half the previous one, and
+    // describes every level (the input being level 0) in 'lods'. Stops early once simplification stalls.
+    static void GenerateLODs(const std::vector<Vertex> &vertices, std::vector<GLuint> &indices, std::vector<MeshLOD> &lods, unsigned int maxLODs);
+
+    static VertexCacheStats AnalyzeVertexCache(const std::vector<GLuint> &indices, size_t vertexCount, unsigned int cacheSize = STATS_CACHE_SIZE);
+
+    // Runs every pass above in order on a triangle list
+    static MeshOptimizerReport Optimize(std::vector<Vertex> &vertices, std::vector<GLuint> &indices);
+};
+
+#endif
@@ -3,6 +3,15 @@
 
 #include "json.h"
 #include "mesh.h"
+#include "accessor.h"
+#include "bvh.h"
+#include "renderQueue.h"
+#include "indirectRenderer.h"
+#include "occlusionCuller.h"
+#include "mappedFile.h"
+#include "meshOptimizer.h"
+#include "UBO.h"
+#include "uniformBlocks.h"
 
 using json = nlohmann::json;
 
@@ -13,18 +22,51 @@ public:
     glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
     glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
     bool display = true;
+    // Skip meshes whose bounds are outside the camera frustum (off for things drawn with custom matrices)
+    bool frustumCulling = true;
+    // Draw coarser levels of detail for meshes that are small on screen (off for things drawn with custom matrices)
+    bool levelOfDetail = true;
 
     Material material;
 
     std::string name;
 
     static std::vector<Model *> models;
+    // World bounds of every model in 'models', for culling, picking and light queries
+    static BVH sceneBVH;
+    // Weld and reorder triangle meshes at import, printing cache stats per mesh
+    static bool optimizeMeshes;
+    // Screen space error in pixels a level of detail may show, 0 always draws full detail
+    static float lodPixelError;
+    // GPU vertex format of meshes loaded from now on
+    static VertexLayout vertexLayout;
 
     // Loads in a model from a file and stores tha information in 'data', 'JSON', and 'file'
     Model(const char *file, std::string n, bool addToList);
     Model(const char *file, std::string tex, std::string n, bool addToList);
-
-    void Draw(Shader &shader, Camera &camera);
+    // Takes the model out of 'models' and 'sceneBVH' and frees its meshes' arena space
+    ~Model();
+
+    // With 'occlusion' only the meshes it lets through phase 0 are drawn, the rest wait for its test
+    void Draw(Shader &shader, Camera &camera, OcclusionCuller *occlusion = nullptr);
+    // Queues the visible meshes instead of drawing them right away
+    void Submit(RenderQueue &queue, Shader &shader, Camera &camera, OcclusionCuller *occlusion = nullptr);
+    // Queues every mesh on 'renderer', which culls them itself. It binds no per mesh textures,
+    // so textured models go through 'queue' instead.
+    void Submit(IndirectRenderer &renderer, RenderQueue &queue, Shader &shader, Camera &camera);
+    // Draws every listed model whose bounds touch the camera frustum, skipping hidden meshes if 'occlusion' is
+    // given and enabled
+    static void DrawVisible(Shader &shader, Camera &camera, OcclusionCuller *occlusion = nullptr);
+    // Same as DrawVisible, but through a render queue. With occlusion the queue is flushed once in between, so
+    // the phase 1 test sees the depth of phase 0.
+    static void SubmitVisible(RenderQueue &queue, Shader &shader, Camera &camera, OcclusionCuller *occlusion = nullptr);
+    // Closest listed model whose bounds the ray hits, or nullptr
+    static Model *Pick(const glm::vec3 &origin, const glm::vec3 &direction);
+
+    // Union of the mesh bounds after the node and model transforms
+    AABB WorldBounds() const;
+    // Refits this model in 'sceneBVH', call after changing the transform
+    void UpdateBounds();
 
     void UI();
 
@@ -32,13 +74,27 @@ public:
 
     void LoadImGuiData(const std::string &filename);
 
-private:
+protected:
     // Variables for easy access
     const char *file;
     std::string texFolder = "";
-    std::vector<unsigned char> data;
     json JSON;
 
+    // The .gltf text or the whole .glb container, and the external .bin buffer if there is one
+    MappedFile source;
+    MappedFile binFile;
+    // Read-only view of the binary buffer inside one of the mappings above
+    const unsigned char *data = nullptr;
+    size_t dataSize = 0;
+
+    // Leaf of this model in 'sceneBVH' (-1 if not listed)
+    int bvhProxy = -1;
+
+    // Material uniform block of this model, re-uploaded only when 'material' changes
+    UBO materialUBO{sizeof(MaterialBlock)};
+    Material uploadedMaterial;
+    bool materialUploaded = false;
+
     // All the meshes and transformations
     std::vector<Mesh> meshes;
     std::vector<glm::vec3> translationsMeshes;
@@ -46,33 +102,80 @@ private:
     std::vector<glm::vec3> scalesMeshes;
     std::vector<glm::mat4> matricesMeshes;
 
-    // Prevents textures from being loaded twice
-    std::vector<std::string> loadedTexName;
-    std::vector<Texture> loadedTex;
-
-    // Loads a single mesh by its index
-    void loadMesh(unsigned int indMesh);
+    // Scratch space for culling, world bounds of every mesh and the per-mesh result
+    BoundsSoA worldBounds;
+    std::vector<unsigned char> meshVisible;
+
+    // One primitive of one mesh instanced by a node, with that node's transform
+    struct MeshJob
+    {
+        unsigned int mesh;
+        unsigned int primitive;
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
+        glm::mat4 matrix;
+    };
+
+    // CPU side geometry of a decoded primitive, ready for upload
+    struct MeshData
+    {
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> indices;
+        AABB bounds;
+        // Filled when the mesh went through MeshOptimizer
+        bool optimized = false;
+        MeshOptimizerReport report;
+        // Levels packed into 'indices'
+        std::vector<MeshLOD> lods;
+    };
+
+    // Every primitive found while traversing the node hierarchy
+    std::vector<MeshJob> meshJobs;
+
+    // Uploads the material block if it changed
+    void uploadMaterial();
+    // Uploads the material block if it changed and binds it
+    void bindMaterial();
+    // Fills 'meshVisible' with the frustum test of every mesh (all visible if culling is off)
+    void cullMeshes(Camera &camera);
+    // Draws mesh 'i' through 'queue', or right away if it is nullptr
+    void drawMesh(unsigned int i, Shader &shader, Camera &camera, RenderQueue *queue, const glm::mat4 &world, unsigned int lod, const IndirectDraw &indirect = IndirectDraw());
+    // Draws (or queues) the meshes of every listed model inside the frustum in the two phases of 'occlusion'
+    static void drawOccluded(RenderQueue *queue, Shader &shader, Camera &camera, OcclusionCuller &occlusion);
+    // Translation * rotation * scale of the whole model
+    glm::mat4 transform() const;
+    // Coarsest level of mesh 'i' whose error stays under 'lodPixelError' when drawn with 'world' from 'camera'
+    unsigned int selectLOD(unsigned int i, const glm::mat4 &world, const Camera &camera) const;
+
+    // Decodes all jobs on the worker pool, then creates the GL meshes on this (the context) thread
+    void loadMeshes();
+    // Decodes the vertices and indices of a single primitive, safe to call from any thread
+    MeshData decodePrimitive(const MeshJob &job) const;
 
     // Traverses a node recursively, so it essentially traverses all connected nodes
     void traverseNode(unsigned int nextNode, glm::mat4 matrix = glm::mat4(1.0f));
 
-    // Gets the binary data from a file
-    std::vector<unsigned char> getData();
-    // Interprets the binary data into floats, indices, and textures
-    std::vector<float> getFloats(json accessor);
-    std::vector<GLuint> getIndices(json accessor);
+    // Parses the file, loads every mesh and restores the saved UI state
+    void load(bool addToList);
+
+    // Splits a binary .glb container into its JSON and BIN chunks, returns false for plain .gltf
+    bool parseGLB();
+    // Points 'data' at the binary buffer, mapping the external .bin file if needed
+    void getData();
+    // Object space bounds of a primitive from the POSITION accessor's min/max, or from the vertices if absent
+    AABB getBounds(const json &primitive, const std::vector<Vertex> &vertices) const;
+    // Views an accessor in place inside 'data' (an empty view if the attribute is missing)
+    AccessorView getAccessor(const json &primitive, const char *attribute) const;
+    // Interprets the binary data into indices and textures
+    std::vector<GLuint> getIndices(const json &accessor) const;
     std::vector<Texture> getTextures();
 
-    // Assembles all the floats into vertices
+    // Assembles the attribute views into vertices, copying each attribute straight into place
     std::vector<Vertex> assembleVertices(
-        std::vector<glm::vec3> positions,
-        std::vector<glm::vec3> normals,
-        std::vector<glm::vec2> texUVs);
-
-    // Helps with the assembly from above by grouping floats
-    std::vector<glm::vec2> groupFloatsVec2(std::vector<float> floatVec);
-    std::vector<glm::vec3> groupFloatsVec3(std::vector<float> floatVec);
-    std::vector<glm::vec4> groupFloatsVec4(std::vector<float> floatVec);
+        const AccessorView &positions,
+        const AccessorView &normals,
+        const AccessorView &texUVs) const;
 };
 
 #endif // !MODEL_CLASS_H
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef OCCLUSION_BUFFER_CLASS_H
+#define OCCLUSION_BUFFER_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "VBO.h"
+#include "bounds.h"
+
+// Small software depth buffer for occlusion tests that need no GPU readback. Occluders are rasterized
+// four pixels at a time (SSE2 where available), depths are window space like the GL depth buffer.
+class OcclusionBuffer
+{
+public:
+    OcclusionBuffer(int width = 256, int height = 144);
+
+    // Resets every pixel to the far plane
+    void Clear();
+    // Rasterizes the triangles in [firstIndex, firstIndex + count) of 'indices'. Triangles crossing
+    // the near plane are skipped, which only ever makes the buffer less occluding.
+    void Rasterize(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices, GLuint firstIndex, GLsizei count, const glm::mat4 &objectToClip);
+    // False only if every pixel the box covers already holds something nearer than the box
+    bool Visible(const AABB &worldBox, const glm::mat4 &viewProjection) const;
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    size_t TrianglesRasterized() const { return trianglesRasterized; }
+
+private:
+    int width, height;
+    // Rows padded to a multiple of four pixels so the inner loop never needs a scalar tail
+    int stride;
+    std::vector<float> depth;
+    size_t trianglesRasterized = 0;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef OCCLUSION_CULLER_CLASS_H
+#define OCCLUSION_CULLER_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.h"
+#include "hiZPyramid.h"
+#include "occlusionBuffer.h"
+
+// Storage buffer binding points of occlusion.comp, after the indirect renderer's
+enum OcclusionBinding
+{
+    OCCLUSION_BOX_BINDING = 5,
+    OCCLUSION_COMMAND_BINDING = 6,
+    OCCLUSION_RESULT_BINDING = 7
+};
+
+// Same layout as Box in occlusion.comp
+struct OcclusionBox
+{
+    glm::vec4 center;
+    glm::vec4 extents;
+};
+
+static_assert(sizeof(OcclusionBox) == 32, "OcclusionBox must match std430");
+
+// A mesh inside the frustum that was hidden last frame, drawn in phase 1 if the test lets it
+struct OcclusionCandidate
+{
+    // Whoever submitted the mesh (a Model) and which of its meshes
+    void *owner;
+    unsigned int index;
+    const Mesh *mesh;
+    unsigned int lod;
+    glm::mat4 world;
+    AABB box;
+    // Set by Test on the GPU path, the draw's instance count is written by occlusion.comp
+    IndirectDraw indirect;
+};
+
+// Two-phase occlusion culling for the CPU driven draw paths (Model::DrawVisible and SubmitVisible).
+// Phase 0 draws the meshes that were visible last frame, then every other mesh inside the frustum is tested
+// against the depth they left and drawn if any of it shows (phase 1). The phase 0 meshes are tested as well,
+// which decides whether they go first next frame.
+// On GL 4.3 the test runs in occlusion.comp against a HiZPyramid of the real depth buffer: it writes the
+// instance count of every phase 1 draw, and the results come back through fenced buffers a frame or two
+// later, so the CPU never waits. On GL 3.3 the phase 0 meshes are rasterized into an OcclusionBuffer and
+// the test runs on the CPU right away.
+class OcclusionCuller
+{
+public:
+    bool enabled = true;
+    // Tests on the GPU when the context can, off uses the software buffer
+    bool gpuTest = true;
+
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    // Whether occlusion.comp and the Hi-Z pyramid are available (GL 4.3)
+    bool GPUAvailable() const;
+
+    // Starts a pass seen through 'camera' and picks up the GPU results that are ready
+    void Begin(const Camera &camera);
+    // Phase 0: true if the mesh was visible last frame, the caller draws it now and it becomes an occluder.
+    // Otherwise it is kept as a phase 1 candidate.
+    bool Submit(void *owner, unsigned int index, const Mesh &mesh, unsigned int lod, const glm::mat4 &world);
+    // The mesh is outside the frustum, it has to pass the test again once it comes back
+    void Culled(const Mesh &mesh);
+    // Phase 1: tests everything against the depth of phase 0, call once the phase 0 draws were issued.
+    // On the GPU path every candidate stays and draws through its IndirectDraw, otherwise only the visible ones stay.
+    void Test();
+    const std::vector<OcclusionCandidate> &Candidates() const { return candidates; }
+
+    // Mode and test resolution for the "Global" panel
+    void UI();
+
+private:
+    std::unique_ptr<Shader> program;
+    std::unique_ptr<HiZPyramid> hiZ;
+    OcclusionBuffer software;
+    // Whether this pass tests on the GPU
+    bool gpu = false;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+
+    // Visibility of every mesh seen so far by GeometryAllocation::id, and the pass it was last submitted in
+    struct History
+    {
+        bool visible = true;
+        unsigned int pass = 0;
+    };
+    std::unordered_map<uint64_t, History> history;
+    unsigned int passes = 0;
+
+    // This pass's phase 0 meshes and phase 1 candidates
+    struct Occluder
+    {
+        uint64_t id;
+        AABB box;
+    };
+    std::vector<Occluder> occluders;
+    std::vector<OcclusionCandidate> candidates;
+
+    GLuint boxBuffer = 0;
+    GLuint commandBuffer = 0;
+    // Results of the last GPU tests in a ring, each read once its fence has signalled
+    static const int RESULT_BUFFERS = 3;
+    struct TestedMesh
+    {
+        uint64_t id;
+        // Only meaningful for candidates, which come first
+        unsigned int triangles;
+        unsigned int lod;
+    };
+    struct PendingResult
+    {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        std::vector<TestedMesh> meshes;
+        size_t candidates = 0;
+    };
+    PendingResult results[RESULT_BUFFERS];
+    int resultSlot = 0;
+
+    // Applies every finished GPU test to 'history' and RenderStats::frame, without waiting
+    void readResults();
+    void testOnGPU();
+    void testOnCPU();
+};
+
+#endif
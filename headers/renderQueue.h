@@ -0,0 +1,47 @@
+#ifndef RENDER_QUEUE_CLASS_H
+#define RENDER_QUEUE_CLASS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+#include "UBO.h"
+
+// One mesh draw recorded for the frame
+struct DrawPacket
+{
+    // Sort key, from most to least significant: program, textures, material, VAO, depth
+    uint64_t key;
+    Shader *shader;
+    Mesh *mesh;
+    // Material block of the owning model
+    UBO *material;
+    glm::mat4 model;
+    bool textured;
+    // Level of detail of 'mesh' to draw
+    unsigned int lod;
+    // Set when the GPU decides whether the draw happens
+    IndirectDraw indirect;
+};
+
+// Collects the frame's draws, sorts them by state and only emits the state that changes between them
+class RenderQueue
+{
+public:
+    // Camera distance mapped onto the 16 depth bits of the key, draws further away share the last bucket
+    float maxDepth = 100.0f;
+
+    // Records a draw of level 'lod' of 'mesh' with the world matrix 'model', see Mesh::DrawElements for 'indirect'
+    void Submit(Shader &shader, Mesh &mesh, UBO *material, const glm::mat4 &model, bool textured, const Camera &camera, unsigned int lod = 0, const IndirectDraw &indirect = IndirectDraw());
+    // Sorts and draws everything submitted since the last flush, then empties the queue
+    void Flush(Camera &camera);
+
+    size_t Size() const { return packets.size(); }
+
+private:
+    std::vector<DrawPacket> packets;
+    // (key, packet index) pairs, sorted instead of the packets themselves
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+};
+
+#endif
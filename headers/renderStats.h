@@ -0,0 +1,34 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+// Levels of detail a mesh can have, the full detail one included
+const unsigned int MAX_MESH_LODS = 4;
+
+// Counters gathered while rendering a frame, shown in the "Global" stats panel
+struct RenderStats
+{
+    unsigned int drawCalls = 0;
+    unsigned int instances = 0;
+    unsigned int triangles = 0;
+    // Meshes that passed / failed frustum culling
+    unsigned int meshesDrawn = 0;
+    unsigned int meshesCulled = 0;
+    // Meshes inside the frustum but hidden behind others
+    unsigned int meshesOccluded = 0;
+    // Scene models rejected by the BVH before their meshes were looked at
+    unsigned int modelsCulled = 0;
+    // State changes: glUseProgram, texture binds and VAO / uniform buffer binds
+    unsigned int programSwitches = 0;
+    unsigned int textureBinds = 0;
+    unsigned int bufferBinds = 0;
+    // Mesh draws per level of detail, full detail first
+    unsigned int lodDraws[MAX_MESH_LODS] = {};
+
+    // Counters for the frame being recorded
+    static RenderStats frame;
+
+    // Clears the counters at the start of a frame
+    static void Reset() { frame = RenderStats(); }
+};
+
+#endif
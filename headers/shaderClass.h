@@ -7,25 +7,66 @@
 #include <sstream>
 #include <iostream>
 #include <cerrno>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
 
 std::string get_file_contents(const char *filename);
+// Reads a shader source file, replacing #include "file" lines (relative to the including file) with their contents
+std::string get_shader_source(const char *filename);
+
+// Locations of the uniforms the engine sets every frame, resolved once after linking.
+// Anything the program doesn't use is -1, which the setters (and GL) ignore.
+struct ShaderUniforms
+{
+    GLint camMatrix, viewPos, camPos, model, textured;
+    GLint albedoMap, normalMap, armMap;
+    GLint view, projection;
+};
 
 class Shader
 {
 public:
     // Reference ID of the Shader Program
     GLuint ID;
+    // Cached locations of the common uniforms
+    ShaderUniforms uniforms;
+
     // Constructor that build the Shader Program from 2 different shaders
     Shader(const char *vertexFile, const char *fragmentFile);
+    // Builds a compute program, needs GL 4.3 (ID is 0 without it)
+    Shader(const char *computeFile);
 
     // Activates the Shader Program
     void Activate();
     // Deletes the Shader Program
     void Delete();
+    // Whether the program compiled and linked
+    bool Linked() const;
+    // Whether the only mesh attribute the program reads is the position, so it can draw from GeometryArena::positionVAO
+    bool PositionOnly() const { return positionOnly; }
+
+    // Looks up a uniform/attribute location in the reflection cache instead of asking the driver (-1 if unused)
+    GLint Uniform(const std::string &name) const;
+    GLint Attribute(const std::string &name) const;
+
+    // Typed setters for the currently active program, keyed by a cached location
+    void SetInt(GLint location, int value);
+    void SetFloat(GLint location, float value);
+    void SetVec3(GLint location, const glm::vec3 &value);
+    void SetMat4(GLint location, const glm::mat4 &value);
 
 private:
+    std::unordered_map<std::string, GLint> uniformLocations;
+    std::unordered_map<std::string, GLint> attributeLocations;
+    bool positionOnly = false;
+
     // Checks if the different Shaders have compiled properly
     void compileErrors(unsigned int shader, const char *type);
+    // Reads every active uniform and attribute of the linked program into the caches
+    void reflect();
+    // Points the shared uniform blocks at their fixed binding points
+    void bindUniformBlocks();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef SHADING_BENCHMARK_CLASS_H
+#define SHADING_BENCHMARK_CLASS_H
+
+#include <glad/glad.h>
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "light.h"
+
+// One configuration timed by ShadingBenchmark
+struct ShadingCase
+{
+    int lights;
+    int layers;
+    bool deferred;
+    // Forward shading after a depth pre-pass
+    bool prepass;
+    // Average GPU time of the scene pass
+    double gpuMs = 0.0;
+};
+
+// Steps through forward, forward after a depth pre-pass and deferred shading at several point light counts
+// and overdraw levels, timing the scene pass of each with a GL_TIME_ELAPSED query. The overdraw comes from
+// screen filling walls drawn farthest first, which the depth test can't reject: forward shading lights every
+// layer, the pre-pass only rasterizes them again and deferred only writes the G-buffer again.
+class ShadingBenchmark
+{
+public:
+    // Frames drawn per case, the first 'warmupFrames' of them aren't timed
+    int framesPerCase = 60;
+    int warmupFrames = 10;
+
+    ShadingBenchmark(const std::vector<int> &lightCounts, const std::vector<int> &overdrawLayers);
+    ~ShadingBenchmark();
+
+    bool Done() const { return current >= cases.size(); }
+    // Shading path of the current case
+    bool Deferred() const { return cases[current].deferred; }
+    bool Prepass() const { return cases[current].prepass; }
+
+    // Switches on the current case's lights, creating them on first use. Call before Light::UpdateFrameData.
+    void Setup();
+    // Draws the current case's walls, farthest first
+    void DrawLayers(Shader &shader, Camera &camera);
+    // Brackets the timed scene pass, EndFrame moves on once the case has all its frames
+    void BeginFrame();
+    void EndFrame();
+
+    // Average GPU milliseconds of every case, the three paths side by side
+    void Report(std::ostream &out) const;
+
+private:
+    std::vector<ShadingCase> cases;
+    size_t current = 0;
+    int frame = 0;
+    double timedMs = 0.0;
+    GLuint query = 0;
+
+    std::vector<std::unique_ptr<Light>> lights;
+    std::vector<std::unique_ptr<Model>> walls;
+};
+
+#endif
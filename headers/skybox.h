@@ -3,27 +3,72 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
 #include "model.h"
+#include "iblCache.h"
+#include "mappedFile.h"
+#include "sphericalHarmonics.h"
+#include "UBO.h"
+
+// Stage of a background environment swap started by Skybox::RequestEnvironment
+enum class SwapState
+{
+    Idle,
+    // Hashing the HDR and decoding it (or mapping its cache file) on a worker
+    Decoding,
+    // Running the upload and baking steps a few per frame
+    Baking
+};
 
 class Skybox
 {
 public:
-    unsigned int hdrTexture;
-    unsigned int envCubemap;
-    unsigned int irradianceMap;
-    unsigned int prefilterMap;
-    unsigned int brdfLUTTexture;
+    unsigned int hdrTexture = 0;
+    unsigned int envCubemap = 0;
+    unsigned int prefilterMap = 0;
+    unsigned int brdfLUTTexture = 0;
+    // Diffuse lighting of the environment, evaluated per fragment from the IrradianceData block
+    SH9 irradiance;
+
+    // Where baked maps are cached, one file per HDR plus the shared BRDF LUT
+    std::string cacheFolder = "saveData/";
+
+    // CPU + GPU milliseconds a background swap may spend per frame, at least one step always runs
+    float swapBudgetMs = 2.0f;
+    // Bytes copied into the upload PBO per step
+    size_t uploadChunkBytes = 4 << 20;
+    // Longest frame while the last swap ran, and the swap's total time
+    float worstSwapFrameMs = 0.0f;
+    float lastSwapMs = 0.0f;
 
     Skybox(const std::string &hdrPath);
+    // Waits for the background decode, which fills this object, and for the last cache write to finish
+    ~Skybox();
 
+    // Loads the maps from the cache, or bakes (and caches) whatever is missing, blocking until done
     void Init(Camera &camera);
     void Render(Camera &camera);
+    // Projects the current environment to 'irradiance' and uploads it to the IrradianceData block
+    void UpdateIrradiance();
+
+    // Starts loading 'path' in the background, the current maps stay in use until the new ones are complete.
+    // Returns false if a swap is already running.
+    bool RequestEnvironment(const std::string &path);
+    // Advances a running swap within 'swapBudgetMs', call once per frame outside of any render pass
+    void Update(Camera &camera);
+    SwapState State() const { return swapState; }
+    // Environment picker and swap stats for the "Global" panel
+    void UI();
 
 private:
+    std::string hdrPath;
     unsigned int captureFBO, captureRBO;
+    GLsizei captureSize = 0;
 
     Shader equirectangularToCubemapShader;
-    Shader irradianceShader;
     Shader prefilterShader;
     Shader brdfShader;
     Shader backgroundShader;
@@ -32,13 +77,81 @@ private:
     glm::mat4 captureViews[6];
 
     Model cubeMap; // Model representing the skybox cube
+    UBO irradianceUBO;
+
+    // One slice of a background swap, small enough to share a frame with rendering
+    struct SwapStep
+    {
+        // Steps of one kind share a cost estimate
+        int kind;
+        std::function<void(Camera &)> run;
+        // Steps waiting on a fence or a worker check it here first, while it returns false the swap resumes next frame
+        std::function<bool()> ready;
+
+        SwapStep(int kind, std::function<void(Camera &)> run, std::function<bool()> ready = nullptr)
+            : kind(kind), run(std::move(run)), ready(std::move(ready)) {}
+    };
+
+    SwapState swapState = SwapState::Idle;
+    std::string swapPath;
+    // Shown by UI, render thread only
+    std::string swapError;
+    std::future<void> decodeJob;
+    std::future<void> saveJob;
+    std::deque<SwapStep> swapSteps;
+    // Results of the decode job, only touched by the render thread once it has finished
+    uint64_t swapKey = 0;
+    std::string decodeError;
+    MappedFile swapFile;
+    std::vector<CachedTexture> swapTextures;
+    std::vector<const unsigned char *> swapPixels;
+    std::vector<float> swapHDR;
+    int swapWidth = 0, swapHeight = 0;
+    // Maps being built, they replace the current ones in the last step
+    GLuint swapHDRTexture = 0, swapEnvironment = 0, swapPrefilter = 0;
+    // Half float copies of the baked maps, handed to a worker to write the cache
+    std::vector<std::vector<uint16_t>> swapReadback;
+    GLuint uploadPBO = 0;
+    // Faces are read into these in turn and copied out once their fence has signalled
+    GLuint readbackPBOs[2] = {0, 0};
+    GLsync readbackFences[2] = {nullptr, nullptr};
+    // Smoothed CPU and GPU cost of each step kind, GPU times arrive a few frames late through timer queries
+    std::vector<float> stepCpuMs, stepGpuMs;
+    std::vector<std::pair<GLuint, int>> pendingQueries;
+    std::vector<GLuint> freeQueries;
+    std::chrono::high_resolution_clock::time_point swapStart, lastUpdate;
+    char pathInput[260] = {};
+
+    // HDR contents, bake sizes and cache version folded into one key
+    uint64_t environmentKey() const;
+    bool loadEnvironment(uint64_t key);
+    void saveEnvironment(uint64_t key);
+    bool loadBRDF();
+    void saveBRDF();
 
     void LoadHDR(const std::string &hdrPath);
     void SetupCubemap(Camera &camera);
-    void SetupIrradiance(Camera &camera);
     void SetupPrefilter(Camera &camera);
     void SetupBRDF(Camera &camera);
     void RenderQuad();
+
+    // Pieces shared by the blocking and background paths
+    GLuint createEnvironment();
+    GLuint createPrefilter();
+    void setCaptureSize(GLsizei size);
+    void renderEnvironmentFace(GLuint target, GLuint source, unsigned int face, Camera &camera);
+    void renderPrefilterFace(GLuint target, GLuint source, unsigned int mip, unsigned int face, Camera &camera);
+    void setCubemapFilters(GLuint texture);
+
+    // Background swap
+    void decodeEnvironment();
+    void queueSwapSteps();
+    void queueUpload(GLuint texture, GLenum target, GLint level, GLsizei width, GLsizei height, GLenum format, GLenum type, const unsigned char *data, size_t rowBytes);
+    void queueReadback(GLuint texture, GLsizei size, GLint levels, std::vector<uint16_t> &destination);
+    // Copies 'bytes' out of readback buffer 'slot' into 'target' once its fence has signalled
+    void queueReadbackCopy(unsigned int slot, uint16_t *target, size_t bytes);
+    void finishSwap();
+    void pollStepQueries();
 };
 
 #endif
@@ -0,0 +1,29 @@
+#ifndef SPHERICAL_HARMONICS_CLASS_H
+#define SPHERICAL_HARMONICS_CLASS_H
+
+#include <glm/glm.hpp>
+
+#include "threadPool.h"
+
+// Order 2 (9 coefficient) spherical harmonics of an RGB signal over the sphere
+struct SH9
+{
+    glm::vec3 coefficients[9] = {};
+
+    // The 9 real basis functions at the unit vector 'direction'
+    static void Basis(const glm::vec3 &direction, float basis[9]);
+    // Direction through the center of texel (x, y) of a cubemap face, faces in GL order
+    static glm::vec3 TexelDirection(int face, int x, int y, int size);
+    // Solid angle a cubemap texel covers
+    static float TexelSolidAngle(int x, int y, int size);
+
+    // Projects an RGB float cubemap with 'size' texels a side, 'faces' in GL order (+X, -X, +Y, -Y, +Z, -Z)
+    static SH9 ProjectCubemap(const float *const faces[6], int size, ThreadPool &pool);
+
+    // Convolves with the clamped cosine lobe and divides by PI, so Evaluate gives the
+    // irradiance term the PBR shaders multiply with the albedo
+    void ConvolveCosine();
+    glm::vec3 Evaluate(const glm::vec3 &direction) const;
+};
+
+#endif
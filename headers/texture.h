@@ -5,18 +5,28 @@
 
 #include "shaderClass.h"
 #include "stb_image.h"
+#include "textureCache.h"
+
 class Texture
 {
 public:
+    // Stable name of the image, a placeholder is bound in its place until the image is resident
     GLuint ID;
     const char *type;
     GLuint unit;
 
+    // Shares the image through TextureCache::Shared(), decoding it in the background the first time
     Texture(const char *image, const char *texType, GLuint slot);
 
     void texUnit(Shader &shader, const char *uniform, GLuint unit);
     void Bind();
     void Unbind();
+    // Drops this texture's reference to the shared image
     void Delete();
+
+    bool Resident() const { return entry->resident; }
+
+private:
+    TextureEntry *entry;
 };
-#endif
\ No newline at end of file
+#endif
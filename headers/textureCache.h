@@ -0,0 +1,105 @@
+#ifndef TEXTURE_CACHE_CLASS_H
+#define TEXTURE_CACHE_CLASS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compressedTexture.h"
+
+// One image file shared by every Texture that names it
+struct TextureEntry
+{
+    std::string path;
+    // Texture name, generated up front so it is stable, filled in once the image is decoded and uploaded
+    GLuint ID = 0;
+    // Textures currently holding this entry
+    int references = 0;
+    bool resident = false;
+    // A decode job still points at this entry, so it can't be freed yet
+    bool decoding = false;
+    // Decoding failed, the placeholder stays bound for good
+    bool failed = false;
+    // GPU memory of the uploaded image with its mips
+    size_t bytes = 0;
+    // Uploaded from a .ktx2 / .dds instead of the image itself
+    bool blockCompressed = false;
+    // Color data, stored in an sRGB format so shaders sample linear values
+    bool srgb = false;
+    // Float image (.hdr), stored as half floats
+    bool hdr = false;
+    // Storage format picked at upload
+    GLenum internalFormat = 0;
+
+    // Decoded pixels waiting for upload, written by the decode job (floats for HDR images, bytes otherwise)
+    void *pixels = nullptr;
+    int width = 0, height = 0, channels = 0;
+    // Block compressed levels used instead of 'pixels' when a .ktx2 / .dds sits next to the image
+    CompressedImage compressed;
+};
+
+// Loads textures by path exactly once, decodes them on worker threads and uploads them a few per frame.
+// Until an image is resident, binding it binds a 1x1 placeholder that leaves the material unchanged.
+class TextureCache
+{
+public:
+    // Bytes Update uploads per frame, at least one image always goes through
+    size_t uploadBudgetBytes = 16 << 20;
+
+    // Lookups that found an existing entry, and ones that had to start a decode
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    // Entries freed after their last reference was released
+    unsigned int evictions = 0;
+    // GPU bytes of every resident texture, mips included, and the block compressed part of them
+    size_t residentBytes = 0;
+    size_t compressedBytes = 0;
+
+    // Entry for 'path' with one more reference, queues a background decode the first time. GL thread only.
+    // 'type' "albedo" is color data and goes into sRGB storage, the other types are linear.
+    TextureEntry *Acquire(const std::string &path, const char *type);
+    // Drops a reference, the texture is deleted with the last one. GL thread only.
+    void Release(TextureEntry *entry);
+    // Uploads decoded images through a PBO within 'uploadBudgetBytes', call once per frame on the GL thread
+    void Update();
+
+    // Texture to bind in place of a non-resident one of 'type' ("normal" and "arm" get neutral values, the rest white)
+    GLuint Placeholder(const char *type);
+
+    size_t Size() const { return entries.size(); }
+    // Images still decoding or waiting for upload
+    size_t Pending() const { return pending; }
+    float HitRate() const { return hits + misses == 0 ? 0.0f : (float)hits / (float)(hits + misses); }
+    // Cache stats and a per texture memory table for the "Global" panel
+    void UI();
+
+    // Cache used by Texture
+    static TextureCache &Shared();
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<TextureEntry>> entries;
+    size_t pending = 0;
+
+    // Entries whose decode finished, handed from the workers to Update
+    std::mutex decodedMutex;
+    std::vector<TextureEntry *> decoded;
+
+    GLuint uploadPBO = 0;
+    GLuint placeholderWhite = 0, placeholderNormal = 0, placeholderARM = 0;
+
+    // Runs on a worker: maps a compressed sibling of the image if there is a usable one, decodes the image otherwise
+    void decode(TextureEntry *entry);
+    // Whether the context can sample a block compressed format, safe to call from the workers
+    static bool supported(GLenum internalFormat);
+    void upload(TextureEntry *entry);
+    void uploadCompressed(TextureEntry *entry);
+    void destroy(TextureEntry *entry);
+    static GLuint createPlaceholder(unsigned char r, unsigned char g, unsigned char b);
+};
+
+#endif
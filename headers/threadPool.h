@@ -0,0 +1,45 @@
+#ifndef THREAD_POOL_CLASS_H
+#define THREAD_POOL_CLASS_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs from a shared queue
+class ThreadPool
+{
+public:
+    // Spawns 'threads' workers (0 picks one per hardware thread)
+    explicit ThreadPool(unsigned int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Queues a job, the future rethrows anything the job threw
+    std::future<void> Submit(std::function<void()> job);
+    // Runs fn(0) .. fn(count - 1) across the workers and the calling thread, blocks until all are done.
+    // Not meant to be called from inside one of this pool's jobs.
+    void ParallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+    unsigned int Size() const { return (unsigned int)workers.size(); }
+
+    // Pool shared by the loaders, sized to the machine
+    static ThreadPool &Shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// CPU mirrors of the std140 blocks in res/shaders/uniforms.glsl, keep both in sync
+
+// Fixed binding points, assigned to every program right after linking
+enum UniformBinding
+{
+    FRAME_DATA_BINDING = 0,
+    MATERIAL_DATA_BINDING = 1,
+    IRRADIANCE_DATA_BINDING = 2
+};
+
+struct DirLightBlock
+{
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 color;
+    float pad1;
+};
+
+// Not a uniform block, three RGBA32F texels of the point light buffer (see FetchPointLight)
+struct PointLightBlock
+{
+    glm::vec3 position;
+    float constant;
+    glm::vec3 color;
+    float linear;
+    float quadratic;
+    // Distance the light is cut off at, see Light::Range
+    float range;
+    float pad[2];
+};
+
+struct SpotLightBlock
+{
+    glm::vec3 position;
+    float constant;
+    glm::vec3 direction;
+    float linear;
+    glm::vec3 color;
+    float quadratic;
+    float cutOff;
+    float outerCutOff;
+    float pad[2];
+};
+
+struct FrameBlock
+{
+    glm::mat4 camMatrix;
+    glm::vec3 viewPos;
+    int pointLightCount;
+    DirLightBlock dLight;
+    SpotLightBlock sLight;
+    // Light cluster grid, see LightClusters::Build: tiles per pixel, slice = log(depth) * z + w
+    glm::vec4 clusterScale;
+    // Near and far plane
+    glm::vec4 clusterDepth;
+    glm::ivec4 clusterGrid;
+};
+
+struct MaterialBlock
+{
+    glm::vec3 albedo;
+    float roughness;
+    float metallic;
+    float ao;
+    float pad[2];
+};
+
+// Diffuse environment lighting as 9 spherical harmonics coefficients (rgb, w unused), see SH9
+struct IrradianceBlock
+{
+    glm::vec4 sh[9];
+};
+
+static_assert(sizeof(PointLightBlock) == 48, "PointLight must be three vec4 texels");
+static_assert(sizeof(SpotLightBlock) == 64, "SpotLight must match std140");
+static_assert(offsetof(FrameBlock, dLight) == 80, "FrameData must match std140");
+static_assert(offsetof(FrameBlock, clusterScale) == 176, "FrameData must match std140");
+static_assert(sizeof(FrameBlock) == 224, "FrameData must match std140");
+static_assert(sizeof(MaterialBlock) == 32, "MaterialData must match std140");
+static_assert(sizeof(IrradianceBlock) == 144, "IrradianceData must match std140");
+
+#endif
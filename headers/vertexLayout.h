@@ -0,0 +1,85 @@
+#ifndef VERTEX_LAYOUT_CLASS_H
+#define VERTEX_LAYOUT_CLASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "VBO.h"
+#include "bounds.h"
+
+// Attribute locations read through vertex.glsl
+const GLuint POSITION_ATTRIB_LOCATION = 0;
+const GLuint NORMAL_ATTRIB_LOCATION = 1;
+const GLuint TEXCOORD_ATTRIB_LOCATION = 2;
+// Constant attributes holding the scale and offset that turn stored positions back into object space
+const GLuint POSITION_SCALE_ATTRIB_LOCATION = 9;
+const GLuint POSITION_OFFSET_ATTRIB_LOCATION = 10;
+
+// Quantized formats are stored relative to the mesh bounds and expanded in the vertex shader
+enum class PositionFormat
+{
+    Float,
+    Half,
+    UNorm16
+};
+
+// Normals are always octahedral encoded, two components of this type
+enum class NormalFormat
+{
+    Float,
+    SNorm16,
+    SNorm8
+};
+
+enum class TexCoordFormat
+{
+    Float,
+    Half
+};
+
+// One glVertexAttribPointer call
+struct VertexAttribute
+{
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+// How Mesh stores its vertices on the GPU, every attribute starts on a 4 byte boundary
+struct VertexLayout
+{
+    PositionFormat position = PositionFormat::UNorm16;
+    NormalFormat normal = NormalFormat::SNorm16;
+    TexCoordFormat texCoord = TexCoordFormat::Half;
+
+    // Full precision floats, 28 bytes per vertex
+    static VertexLayout Full() { return {PositionFormat::Float, NormalFormat::Float, TexCoordFormat::Float}; }
+    // 16 bit positions, normals and UVs, 16 bytes per vertex
+    static VertexLayout Compact() { return {}; }
+
+    bool operator==(const VertexLayout &other) const
+    {
+        return position == other.position && normal == other.normal && texCoord == other.texCoord;
+    }
+
+    std::vector<VertexAttribute> Attributes() const;
+    GLsizei Stride() const;
+    // Bytes per vertex of the position-only copy, the position stored the same way without the other attributes
+    GLsizei PositionStride() const;
+
+    // Converts 'vertices' to this layout, quantized positions cover 'bounds'
+    std::vector<unsigned char> Pack(const std::vector<Vertex> &vertices, const AABB &bounds) const;
+    // Scale and offset vertex.glsl applies to stored positions to get object space ones
+    void Dequantization(const AABB &bounds, glm::vec3 &scale, glm::vec3 &offset) const;
+
+    // Octahedral mapping of a unit vector onto [-1, 1]^2
+    static glm::vec2 EncodeOctahedral(const glm::vec3 &normal);
+    static glm::vec3 DecodeOctahedral(const glm::vec2 &encoded);
+};
+
+#endif
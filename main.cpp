@@ -2,24 +2,113 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+
 #include "Model.h"
 #include "light.h"
+#include "instancedModel.h"
+#include "skybox.h"
+#include "deferredRenderer.h"
+#include "shadingBenchmark.h"
+#include "depthPrepass.h"
 
 const unsigned int width = 1600;
 const unsigned int height = 900;
 
 std::vector<Model *> Model::models;
+BVH Model::sceneBVH;
+bool Model::optimizeMeshes = true;
+float Model::lodPixelError = 1.0f;
+VertexLayout Model::vertexLayout = VertexLayout::Compact();
+size_t Mesh::vertexBytes = 0;
+size_t Mesh::indexBytes = 0;
 std::vector<Light *> Light::lights;
 int Light::pointLightCount = 0;
+LightClusters Light::clusters;
+RenderStats RenderStats::frame;
 
-int main()
+int main(int argc, char **argv)
 {
+    // Scene benchmark: --instances N draws N spheres, --no-instancing draws them one call at a time
+    int benchmarkInstances = 0;
+    bool useInstancing = true;
+    // LOD benchmark: --monkeys N places N monkeys on a grid running away from the camera
+    int benchmarkMonkeys = 0;
+    // Light benchmark: --lights N scatters N point lights over the monkeys' area
+    int benchmarkLights = 0;
+    // --full-vertices stores meshes as plain floats instead of the quantized layout
+    bool fullVertices = false;
+    // --indirect draws the scene through the GPU driven path, --cpu-culling builds its commands on the CPU,
+    // --verify-indirect checks the compute pass against the CPU every frame (exit code 1 on a mismatch, the
+    // occlusion test of phase 1 is only checked for consistency, see IndirectRenderer::verify),
+    // --no-occlusion draws everything inside the frustum, on this path and on the model lists' (OcclusionCuller)
+    bool useIndirect = false;
+    bool cpuCulling = false;
+    bool verifyIndirect = false;
+    bool occlusionCulling = true;
+    // --deferred shades through the G-buffer, --shading-benchmark times forward, depth pre-pass and deferred
+    // shading at several light counts and overdraw levels, prints the table and exits
+    bool useDeferred = false;
+    bool runShadingBenchmark = false;
+    // --depth-prepass always draws a depth-only pass first, --no-depth-prepass never does (default: when the
+    // measured overdraw is high), --show-overdraw starts with the overdraw heat map
+    PrepassMode prepassMode = PrepassMode::Auto;
+    bool showOverdraw = false;
+    // --frames N closes the window after N frames, for headless runs
+    int maxFrames = 0;
+    // --hdr path loads an environment in the background once the window is up
+    std::string hdrPath;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+            benchmarkInstances = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--no-instancing") == 0)
+            useInstancing = false;
+        else if (std::strcmp(argv[i], "--full-vertices") == 0)
+            fullVertices = true;
+        else if (std::strcmp(argv[i], "--indirect") == 0)
+            useIndirect = true;
+        else if (std::strcmp(argv[i], "--cpu-culling") == 0)
+            cpuCulling = true;
+        else if (std::strcmp(argv[i], "--verify-indirect") == 0)
+            verifyIndirect = true;
+        else if (std::strcmp(argv[i], "--no-occlusion") == 0)
+            occlusionCulling = false;
+        else if (std::strcmp(argv[i], "--deferred") == 0)
+            useDeferred = true;
+        else if (std::strcmp(argv[i], "--shading-benchmark") == 0)
+            runShadingBenchmark = true;
+        else if (std::strcmp(argv[i], "--depth-prepass") == 0)
+            prepassMode = PrepassMode::On;
+        else if (std::strcmp(argv[i], "--no-depth-prepass") == 0)
+            prepassMode = PrepassMode::Off;
+        else if (std::strcmp(argv[i], "--show-overdraw") == 0)
+            showOverdraw = true;
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            maxFrames = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--monkeys") == 0 && i + 1 < argc)
+            benchmarkMonkeys = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+            benchmarkLights = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--hdr") == 0 && i + 1 < argc)
+            hdrPath = argv[++i];
+    }
+    if (fullVertices)
+        Model::vertexLayout = VertexLayout::Full();
+
     glfwInit();
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // The overdraw heat map counts in the stencil buffer
+    glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
     GLFWwindow *window = glfwCreateWindow(width, height, "tuf3D", NULL, NULL);
 
@@ -49,11 +138,59 @@ int main()
     gladLoadGL();
 
     glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
 
     Model cube("res/models/Shapes/cube.gltf", "Cube", false);
 
+    Shader pbrShader("res/shaders/default.vert", "res/shaders/pbr.frag");
+    InstancedModel spheres("res/models/Shapes/sphere.gltf", "Spheres", false);
+    if (benchmarkInstances > 0)
+    {
+        // Lay the spheres out on a cube grid in front of the camera
+        int side = (int)std::ceil(std::cbrt((double)benchmarkInstances));
+        for (int i = 0; i < benchmarkInstances; i++)
+        {
+            Instance instance;
+            instance.translation = glm::vec3(i % side, (i / side) % side, -(i / (side * side))) * 0.5f - glm::vec3(side * 0.25f, side * 0.25f, 1.0f);
+            instance.scale = glm::vec3(0.2f);
+            instance.material.albedo = glm::vec3((i % 7) / 6.0f, (i % 5) / 4.0f, (i % 3) / 2.0f);
+            spheres.Add(instance);
+        }
+    }
+
+    // Kept out of Model::models so they aren't saved with the scene
+    std::vector<std::unique_ptr<Model>> monkeys;
+    if (benchmarkMonkeys > 0)
+    {
+        int side = (int)std::ceil(std::sqrt((double)benchmarkMonkeys));
+        for (int i = 0; i < benchmarkMonkeys; i++)
+        {
+            monkeys.emplace_back(new Model("res/models/monkey/monkey.gltf", "Monkey " + std::to_string(i), false));
+            monkeys.back()->translation = glm::vec3((i % side - side * 0.5f) * 3.0f, -1.0f, -3.0f - (i / side) * 3.0f);
+        }
+    }
+
+    // Same seed every run so timings compare
+    std::vector<std::unique_ptr<Light>> pointLights;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < benchmarkLights; i++)
+    {
+        pointLights.emplace_back(new Light("res/models/Shapes/icosphere.gltf", "Point " + std::to_string(i), "Point"));
+        Light &light = *pointLights.back();
+        light.translation = glm::vec3(unit(random) * 30.0f - 15.0f, unit(random) * 3.0f - 1.0f, 2.0f - unit(random) * 32.0f);
+        light.scale = glm::vec3(0.05f);
+        light.material.albedo = glm::vec3(unit(random), unit(random), unit(random)) * 0.5f;
+        light.quadratic = 8.0f + unit(random) * 16.0f;
+    }
+
     Camera camera(width, height, glm::vec3(0.0f, 0.0f, 2.0f));
 
+    // Environments are swapped a few steps per frame, the scene keeps rendering meanwhile
+    Skybox skybox(hdrPath);
+    if (!hdrPath.empty())
+        skybox.RequestEnvironment(hdrPath);
+
     // ImGui Init
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -63,13 +200,157 @@ int main()
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
+    // Model last clicked in the viewport
+    Model *selected = nullptr;
+
+    // Scene models are sorted by state before drawing, the checkbox falls back to drawing in list order
+    RenderQueue renderQueue;
+    bool useRenderQueue = true;
+    // Two-phase occlusion culling of the scene models when they are not drawn indirectly
+    OcclusionCuller occlusionCuller;
+    occlusionCuller.enabled = occlusionCulling;
+
+    // GPU driven path, needs GL 4.3
+    std::unique_ptr<IndirectRenderer> indirectRenderer;
+    if (IndirectRenderer::Supported())
+    {
+        indirectRenderer.reset(new IndirectRenderer());
+        indirectRenderer->computeCulling = !cpuCulling;
+        indirectRenderer->verify = verifyIndirect;
+        indirectRenderer->occlusionCulling = occlusionCulling;
+    }
+    else if (useIndirect)
+    {
+        std::cout << "Indirect drawing needs GL 4.3, using the render queue" << std::endl;
+    }
+    DeferredRenderer deferredRenderer;
+    DepthPrepass depthPrepass;
+    depthPrepass.mode = prepassMode;
+    depthPrepass.showOverdraw = showOverdraw;
+    std::unique_ptr<ShadingBenchmark> shadingBenchmark;
+    if (runShadingBenchmark)
+        shadingBenchmark.reset(new ShadingBenchmark({16, 128, 512}, {1, 4, 8}));
+    int frame = 0;
+
     while (!glfwWindowShouldClose(window))
     {
         glClearColor(0.00f, 0.00f, 0.00f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        RenderStats::Reset();
+        auto cpuStart = std::chrono::high_resolution_clock::now();
+
         camera.Inputs(window);
         camera.updateMatrix(45.0f, 0.1f, 100.0f);
+        if (shadingBenchmark)
+        {
+            shadingBenchmark->Setup();
+            useDeferred = shadingBenchmark->Deferred();
+            depthPrepass.mode = shadingBenchmark->Prepass() ? PrepassMode::On : PrepassMode::Off;
+        }
+        Light::UpdateFrameData(camera);
+        skybox.Update(camera);
+        TextureCache::Shared().Update();
+
+        if (camera.pickRequested)
+        {
+            selected = Model::Pick(camera.pickOrigin, camera.pickDirection);
+            camera.pickRequested = false;
+        }
+
+        // The G-buffer program stores what pbr.frag would shade
+        Shader &sceneShader = useDeferred ? deferredRenderer.GeometryShader() : pbrShader;
+        if (shadingBenchmark)
+            shadingBenchmark->BeginFrame();
+        if (useDeferred)
+            deferredRenderer.Begin();
+
+        // Everything the scene draws, once per pass: 'depthOnly' is the pre-pass with the depth program
+        auto drawScene = [&](Shader &shader, bool depthOnly)
+        {
+            if (useIndirect && indirectRenderer)
+            {
+                indirectRenderer->deferred = useDeferred;
+                for (Model *model : Model::models)
+                    model->Submit(*indirectRenderer, renderQueue, shader, camera);
+                for (std::unique_ptr<Model> &monkey : monkeys)
+                    monkey->Submit(*indirectRenderer, renderQueue, shader, camera);
+                indirectRenderer->Flush(camera, depthOnly);
+                renderQueue.Flush(camera);
+            }
+            else
+            {
+                if (useRenderQueue)
+                {
+                    Model::SubmitVisible(renderQueue, shader, camera, &occlusionCuller);
+                    renderQueue.Flush(camera);
+                }
+                else
+                {
+                    Model::DrawVisible(shader, camera, &occlusionCuller);
+                }
+
+                for (std::unique_ptr<Model> &monkey : monkeys)
+                {
+                    if (useRenderQueue)
+                        monkey->Submit(renderQueue, shader, camera);
+                    else
+                        monkey->Draw(shader, camera);
+                }
+                if (!monkeys.empty() && useRenderQueue)
+                    renderQueue.Flush(camera);
+            }
+
+            if (benchmarkInstances > 0)
+            {
+                if (useInstancing)
+                {
+                    spheres.Draw(shader, camera);
+                }
+                else
+                {
+                    // Same scene through the regular path: one draw and one material update per sphere
+                    for (const Instance &instance : spheres.instances)
+                    {
+                        spheres.translation = instance.translation;
+                        spheres.rotation = instance.rotation;
+                        spheres.scale = instance.scale;
+                        spheres.material = instance.material;
+                        spheres.Model::Draw(shader, camera);
+                    }
+                }
+            }
+
+            if (shadingBenchmark)
+                shadingBenchmark->DrawLayers(shader, camera);
+        };
+
+        // The G-buffer has no stencil to count overdraw in
+        if (useDeferred)
+            depthPrepass.showOverdraw = false;
+        depthPrepass.Begin();
+        if (depthPrepass.Active())
+            drawScene(depthPrepass.DepthShader(), true);
+        depthPrepass.Shade();
+        drawScene(sceneShader, false);
+        depthPrepass.End();
+
+        if (useDeferred)
+            deferredRenderer.End(camera);
+        if (shadingBenchmark)
+        {
+            shadingBenchmark->EndFrame();
+            if (shadingBenchmark->Done())
+            {
+                shadingBenchmark->Report(std::cout);
+                shadingBenchmark.reset();
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
+        }
+
+        skybox.Render(camera);
+
+        std::chrono::duration<double, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - cpuStart;
 
         // ImGui
         ImGui_ImplOpenGL3_NewFrame();
@@ -81,6 +362,40 @@ int main()
         ImGui::TextColored(ImVec4(128.0f, 0.0f, 128.0f, 255.0f), "Stats");
         ImGui::Text("FPS: %.1f", io.Framerate);
         ImGui::Text("Frame time: %.3f ms", 1000.0f / io.Framerate);
+        ImGui::Text("CPU frame time: %.3f ms", cpuTime.count());
+        ImGui::Text("Draw calls: %u", RenderStats::frame.drawCalls);
+        ImGui::Text("Instances: %u", RenderStats::frame.instances);
+        ImGui::Text("Triangles: %u", RenderStats::frame.triangles);
+        ImGui::Text("Meshes drawn: %u, culled: %u, occluded: %u", RenderStats::frame.meshesDrawn, RenderStats::frame.meshesCulled, RenderStats::frame.meshesOccluded);
+        ImGui::Text("Models culled: %u (BVH height %d)", RenderStats::frame.modelsCulled, Model::sceneBVH.Height());
+        ImGui::Text("Program switches: %u", RenderStats::frame.programSwitches);
+        ImGui::Text("Texture binds: %u, buffer binds: %u", RenderStats::frame.textureBinds, RenderStats::frame.bufferBinds);
+        ImGui::Checkbox("Render queue", &useRenderQueue);
+        occlusionCuller.UI();
+        ImGui::Checkbox("Deferred shading", &useDeferred);
+        if (useDeferred)
+            deferredRenderer.UI();
+        depthPrepass.UI();
+        if (indirectRenderer)
+        {
+            ImGui::Checkbox("Indirect drawing", &useIndirect);
+            indirectRenderer->UI();
+        }
+        ImGui::Text("Mesh memory: %.2f MB vertices, %.2f MB indices", Mesh::vertexBytes / (1024.0f * 1024.0f), Mesh::indexBytes / (1024.0f * 1024.0f));
+        GeometryArena::UI();
+        ImGui::SliderFloat("LOD error (px)", &Model::lodPixelError, 0.0f, 8.0f);
+        ImGui::Text("LOD draws: %u / %u / %u / %u", RenderStats::frame.lodDraws[0], RenderStats::frame.lodDraws[1], RenderStats::frame.lodDraws[2], RenderStats::frame.lodDraws[3]);
+        TextureCache::Shared().UI();
+        Light::clusters.UI();
+
+        ImGui::TextColored(ImVec4(128.0f, 0.0f, 128.0f, 255.0f), "Environment");
+        skybox.UI();
+
+        ImGui::TextColored(ImVec4(128.0f, 0.0f, 128.0f, 255.0f), "Selected");
+        if (selected)
+            selected->UI();
+        else
+            ImGui::Text("Click a model to select it");
         ImGui::End();
 
         // ImGui::Begin("Objects", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_AlwaysAutoResize);
@@ -92,6 +407,16 @@ int main()
         glfwSwapBuffers(window);
 
         glfwPollEvents();
+
+        if (maxFrames > 0 && ++frame >= maxFrames)
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+
+    int exitCode = 0;
+    if (indirectRenderer && indirectRenderer->verify)
+    {
+        std::cout << "Indirect commands differing between GPU and CPU: " << indirectRenderer->Mismatches() << std::endl;
+        exitCode = indirectRenderer->Mismatches() == 0 ? 0 : 1;
     }
 
     for (Model *model : Model::models)
@@ -107,5 +432,5 @@ int main()
     glfwDestroyWindow(window);
 
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+
+#include "vertex.glsl"
 
 out vec3 WorldPos;
 
@@ -8,6 +9,6 @@ uniform mat4 view;
 
 void main()
 {
-    WorldPos = aPos;
+    WorldPos = MeshPosition();
     gl_Position =  projection * view * vec4(WorldPos, 1.0);
 }
\ No newline at end of file
@@ -1,60 +1,24 @@
 #version 330 core
-out vec4 FragColor;
 
-struct Material {
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-}; 
-
-struct DirLight {
-    vec3 direction;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-  
-    float constant;
-    float linear;
-    float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;       
-};
+#include "uniforms.glsl"
+
+out vec4 FragColor;
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 in vec4 FragPosLightSpace;
-
-uniform vec3 viewPos;
-uniform DirLight dLight;
-uniform float pointLightCount;
-uniform PointLight pLight[16];
-uniform SpotLight sLight;
-uniform Material material;
+flat in vec3 InstanceAlbedo;
+flat in vec3 InstanceRMA;
 
 uniform sampler2D shadowMap;
+
+// Blinn-Phong terms derived from the shared PBR material
+const float AMBIENT_STRENGTH = 0.05;
+vec3 Albedo() { return material.albedo * InstanceAlbedo; }
+float Roughness() { return material.roughness * InstanceRMA.x; }
+float Shininess() { return mix(256.0, 2.0, Roughness()); }
+
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -67,8 +31,9 @@ void main()
     // vec3 result = CalcDirLight(dLight, norm, viewDir);
     vec3 result = vec3(0.0,0.0,0.0);
 
-    for(int i = 0; i < pointLightCount; i++)
-        result += CalcPointLight(pLight[i], norm, FragPos, viewDir);    
+    uvec2 cluster = LightCluster(gl_FragCoord);
+    for(uint i = 0u; i < cluster.y; i++)
+        result += CalcPointLight(ClusterLight(cluster, i), norm, FragPos, viewDir);    
 
     // result += CalcSpotLight(sLight, norm, FragPos, viewDir); 
 
@@ -115,11 +80,11 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
 
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), Shininess());
 
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
+    vec3 ambient = AMBIENT_STRENGTH * light.color * Albedo();
+    vec3 diffuse = light.color * diff * Albedo();
+    vec3 specular = light.color * spec * (1.0 - Roughness());
     float shadow = ShadowCalculation(FragPosLightSpace, normal, lightDir);
 
     return (ambient + (diffuse + specular));
@@ -131,14 +96,14 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
 
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), Shininess());
 
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
+    vec3 ambient = AMBIENT_STRENGTH * light.color * Albedo();
+    vec3 diffuse = light.color * diff * Albedo();
+    vec3 specular = light.color * spec * (1.0 - Roughness());
 
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -154,7 +119,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
 
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), Shininess());
 
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
@@ -163,9 +128,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
+    vec3 ambient = AMBIENT_STRENGTH * light.color * Albedo();
+    vec3 diffuse = light.color * diff * Albedo();
+    vec3 specular = light.color * spec * (1.0 - Roughness());
 
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
@@ -1,29 +1,40 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTex;
+#include "uniforms.glsl"
+#include "vertex.glsl"
+
+// Per instance when drawn instanced, otherwise the constant value Mesh::Draw sets
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in vec4 aAlbedoRoughness;
+layout (location = 8) in vec2 aMetallicAo;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 out vec4 FragPosLightSpace; // Position in light space
+// Multipliers applied on top of the MaterialData block
+flat out vec3 InstanceAlbedo;
+flat out vec3 InstanceRMA;
 
-uniform mat4 camMatrix;
-uniform mat4 model;
 uniform mat4 lightProjection; // Light's view-projection matrix
 
+// Must match prepass.vert bit for bit, for the GL_EQUAL depth test after a depth pre-pass
+invariant gl_Position;
+
 void main()
 {
     // Compute the fragment position in world space
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    FragPos = vec3(aModel * vec4(MeshPosition(), 1.0));
 
     // Compute normal with respect to model matrix transformations
-    Normal = -normalize(mat3(transpose(inverse(model))) * aNormal);
+    Normal = -normalize(mat3(transpose(inverse(aModel))) * MeshNormal());
 
     // Adjust texture coordinates
     TexCoords = mat2(0.0, -1.0, 1.0, 0.0) * aTex;
 
+    InstanceAlbedo = aAlbedoRoughness.rgb;
+    InstanceRMA = vec3(aAlbedoRoughness.a, aMetallicAo);
+
     // Compute the fragment position in light space
     FragPosLightSpace = lightProjection * vec4(FragPos, 1.0);
 
@@ -0,0 +1,38 @@
+#version 330 core
+
+#include "uniforms.glsl"
+
+// Fullscreen lighting pass: ambient and directional light into the HDR lighting buffer, as in pbr.frag.
+// Point lights are added by lightVolume.frag, or looped over here per cluster.
+out vec4 FragColor;
+
+// Rebuilt from the G-buffer, read by the light functions of pbr.glsl
+vec3 FragPos;
+
+#include "pbr.glsl"
+#include "deferred.glsl"
+
+uniform bool clusteredLights;
+
+void main()
+{
+    Surface surface = ReadGBuffer(ivec2(gl_FragCoord.xy));
+    if (surface.depth == 1.0)
+        discard;
+    FragPos = surface.position;
+
+    vec3 N = surface.normal;
+    vec3 V = normalize(viewPos - FragPos);
+    vec3 F0 = mix(vec3(0.04), surface.albedo, surface.metallic);
+
+    vec3 Lo = CalcDirLight(N, V, F0, surface.albedo, surface.roughness, surface.metallic);
+    if (clusteredLights)
+    {
+        uvec2 cluster = LightCluster(vec4(gl_FragCoord.xy, surface.depth, 1.0));
+        for (uint i = 0u; i < cluster.y; i++)
+            Lo += CalcPointLight(ClusterLight(cluster, i), N, V, F0, surface.albedo, surface.roughness, surface.metallic);
+    }
+
+    vec3 ambient = vec3(0.03) * surface.albedo * surface.ao;
+    FragColor = vec4(ambient + Lo, 1.0);
+}
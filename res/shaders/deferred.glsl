@@ -0,0 +1,38 @@
+// Reads the G-buffer of DeferredRenderer, see gbuffer.glsl for the layout
+
+#include "gbuffer.glsl"
+
+uniform sampler2D gAlbedoAo;
+uniform sampler2D gNormalRM;
+uniform sampler2D gDepth;
+// inverse(camMatrix), takes window depth back to world space
+uniform mat4 inverseCamMatrix;
+
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    float roughness;
+    float metallic;
+    float ao;
+    // Window depth, 1 where nothing was drawn
+    float depth;
+};
+
+Surface ReadGBuffer(ivec2 pixel)
+{
+    Surface surface;
+    surface.depth = texelFetch(gDepth, pixel, 0).r;
+    vec4 albedoAo = texelFetch(gAlbedoAo, pixel, 0);
+    vec4 normalRM = texelFetch(gNormalRM, pixel, 0);
+    surface.albedo = albedoAo.rgb;
+    surface.ao = albedoAo.a;
+    surface.normal = OctDecode(normalRM.xy * 2.0 - 1.0);
+    surface.roughness = normalRM.z;
+    surface.metallic = normalRM.w;
+
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(textureSize(gDepth, 0));
+    vec4 position = inverseCamMatrix * vec4(vec3(uv, surface.depth) * 2.0 - 1.0, 1.0);
+    surface.position = position.xyz / position.w;
+    return surface;
+}
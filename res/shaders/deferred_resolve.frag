@@ -0,0 +1,22 @@
+#version 330 core
+
+// Tone maps the lighting buffer into the target framebuffer and writes the G-buffer depth with it
+in vec2 texCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D lighting;
+uniform sampler2D gDepth;
+
+void main()
+{
+    float depth = texture(gDepth, texCoords).r;
+    if (depth == 1.0)
+        discard;
+
+    vec3 color = texture(lighting, texCoords).rgb;
+    color = color / (color + vec3(1.0));
+    color = pow(color, vec3(1.0/2.2));
+    FragColor = vec4(color, 1.0);
+    gl_FragDepth = depth;
+}
@@ -1,10 +1,11 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+
+#include "vertex.glsl"
 
 uniform mat4 lightProjection;
 uniform mat4 model;
 
 void main()
 {
-    gl_Position = lightProjection * model * vec4(aPos, 1.0);
+    gl_Position = lightProjection * model * vec4(MeshPosition(), 1.0);
 }
\ No newline at end of file
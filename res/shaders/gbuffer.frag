@@ -0,0 +1,42 @@
+#version 330 core
+
+#include "uniforms.glsl"
+#include "gbuffer.glsl"
+
+// Same material inputs as pbr_textured.frag, stored instead of shaded
+layout (location = 0) out vec4 AlbedoAo;
+layout (location = 1) out vec4 NormalRoughnessMetallic;
+
+in vec2 TexCoords;
+in vec3 FragPos;
+in vec3 Normal;
+flat in vec3 InstanceAlbedo;
+flat in vec3 InstanceRMA;
+
+#include "material.glsl"
+
+void main()
+{
+    vec3 albedo = material.albedo * InstanceAlbedo;
+    float ao = material.ao * InstanceRMA.z;
+    float roughness = material.roughness * InstanceRMA.x;
+    float metallic = material.metallic * InstanceRMA.y;
+    vec3 N;
+
+    if (textured)
+    {
+        albedo *= texture(albedoMap, TexCoords).rgb;
+        vec3 arm = texture(armMap, TexCoords).rgb;
+        ao *= arm.r;
+        roughness *= arm.g;
+        metallic *= arm.b;
+        N = getNormalFromMap();
+    }
+    else
+    {
+        N = normalize(Normal);
+    }
+
+    AlbedoAo = vec4(albedo, ao);
+    NormalRoughnessMetallic = vec4(OctEncode(N) * 0.5 + 0.5, roughness, metallic);
+}
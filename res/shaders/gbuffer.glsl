@@ -0,0 +1,24 @@
+// G-buffer layout of DeferredRenderer, written by gbuffer.frag:
+//   0: RGBA8  albedo, ao
+//   1: RGBA16 octahedral normal (mapped to 0..1), roughness, metallic
+// The world position is rebuilt from the depth buffer.
+
+// Unit normal folded onto the octahedron and unwrapped to [-1, 1]^2
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0)
+        e = (1.0 - abs(n.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+// Inverse of OctEncode, same folding as MeshNormal in vertex.glsl
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
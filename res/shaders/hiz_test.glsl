@@ -0,0 +1,42 @@
+// Box test against a HiZPyramid, shared by cull.comp and occlusion.comp. HiZPyramid::Bind sets the
+// pyramid uniforms, the program sets 'viewProjection'.
+
+uniform sampler2D hiZ;
+uniform vec2 hiZSize;
+uniform int hiZMaxLevel;
+uniform mat4 viewProjection;
+
+// Whether the world box lies behind the farthest depth of every pixel it covers
+bool occludedByHiZ(vec3 center, vec3 extents)
+{
+    vec2 minScreen = vec2(1e30);
+    vec2 maxScreen = vec2(-1e30);
+    float minDepth = 1.0;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        vec3 side = vec3((corner & 1) != 0 ? 1.0 : -1.0, (corner & 2) != 0 ? 1.0 : -1.0, (corner & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(center + extents * side, 1.0);
+        // Crossing the near plane, nothing to compare against
+        if (clip.w <= 1e-5)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 screen = (ndc.xy * 0.5 + 0.5) * hiZSize;
+        minScreen = min(minScreen, screen);
+        maxScreen = max(maxScreen, screen);
+        minDepth = min(minDepth, ndc.z * 0.5 + 0.5);
+    }
+
+    ivec2 lastPixel = ivec2(hiZSize) - 1;
+    ivec2 low = clamp(ivec2(floor(minScreen)), ivec2(0), lastPixel);
+    ivec2 high = clamp(ivec2(floor(maxScreen)), ivec2(0), lastPixel);
+    // Level where the rectangle spans at most 2x2 texels
+    vec2 extent = vec2(high - low + 1);
+    int level = clamp(int(ceil(log2(max(extent.x, extent.y)))), 0, hiZMaxLevel);
+    ivec2 lastTexel = max(ivec2(hiZSize) >> level, ivec2(1)) - 1;
+    low = min(low >> level, lastTexel);
+    high = min(high >> level, lastTexel);
+
+    float farthest = max(max(texelFetch(hiZ, low, level).r, texelFetch(hiZ, ivec2(high.x, low.y), level).r),
+                         max(texelFetch(hiZ, ivec2(low.x, high.y), level).r, texelFetch(hiZ, high, level).r));
+    return minDepth > farthest;
+}
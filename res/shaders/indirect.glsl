@@ -0,0 +1,34 @@
+// Storage buffers of the indirect renderer, the std430 layout must match headers/indirectRenderer.h
+
+#define MAX_MESH_LODS 4
+
+// One mesh in a geometry arena (binding 1)
+struct IndirectMesh {
+    vec4 boundsMin;
+    vec4 boundsMax;
+    vec4 positionScale;
+    vec4 positionOffset;
+    // Per level of detail, firstIndex already includes the mesh's offset in the index buffer
+    uint firstIndex[MAX_MESH_LODS];
+    uint count[MAX_MESH_LODS];
+    float error[MAX_MESH_LODS];
+    int baseVertex;
+    uint lodCount;
+};
+
+// One submitted draw (binding 0)
+struct IndirectObject {
+    mat4 model;
+    vec4 albedoRoughness;
+    // x metallic, y ao, z 1 when levels of detail may be used
+    vec4 metallicAoLod;
+    uint mesh;
+};
+
+layout (std430, binding = 0) readonly buffer IndirectObjects {
+    IndirectObject objects[];
+};
+
+layout (std430, binding = 1) readonly buffer IndirectMeshes {
+    IndirectMesh meshes[];
+};
@@ -0,0 +1,37 @@
+#version 430 core
+
+#include "uniforms.glsl"
+#include "vertex.glsl"
+#include "indirect.glsl"
+
+// Index into 'objects', read from an identity buffer at the command's baseInstance
+layout (location = 11) in uint aDrawID;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out vec4 FragPosLightSpace; // Position in light space
+// Per object material, the MaterialData block is left neutral
+flat out vec3 InstanceAlbedo;
+flat out vec3 InstanceRMA;
+
+uniform mat4 lightProjection; // Light's view-projection matrix
+
+// Must match indirect_prepass.vert bit for bit, for the GL_EQUAL depth test after a depth pre-pass
+invariant gl_Position;
+
+void main()
+{
+    IndirectObject object = objects[aDrawID];
+    IndirectMesh mesh = meshes[object.mesh];
+
+    FragPos = vec3(object.model * vec4(MeshPosition(mesh.positionScale.xyz, mesh.positionOffset.xyz), 1.0));
+    Normal = -normalize(mat3(transpose(inverse(object.model))) * MeshNormal());
+    TexCoords = mat2(0.0, -1.0, 1.0, 0.0) * aTex;
+
+    InstanceAlbedo = object.albedoRoughness.rgb;
+    InstanceRMA = vec3(object.albedoRoughness.a, object.metallicAoLod.xy);
+
+    FragPosLightSpace = lightProjection * vec4(FragPos, 1.0);
+    gl_Position = camMatrix * vec4(FragPos, 1.0);
+}
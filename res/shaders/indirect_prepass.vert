@@ -0,0 +1,20 @@
+#version 430 core
+
+#include "uniforms.glsl"
+#include "vertex.glsl"
+#include "indirect.glsl"
+
+// Index into 'objects', read from an identity buffer at the command's baseInstance
+layout (location = 11) in uint aDrawID;
+
+// Computed exactly like indirect.vert, the shading pass tests against this depth with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    IndirectObject object = objects[aDrawID];
+    IndirectMesh mesh = meshes[object.mesh];
+
+    vec3 FragPos = vec3(object.model * vec4(MeshPosition(mesh.positionScale.xyz, mesh.positionOffset.xyz), 1.0));
+    gl_Position = camMatrix * vec4(FragPos, 1.0);
+}
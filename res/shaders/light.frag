@@ -1,16 +1,8 @@
 #version 330 core
 
-out vec4 FragColor;
-
-struct Material {
-    vec3 albedo;
-    float roughness;
-    float metallic;
-    float ao;
-}; 
+#include "uniforms.glsl"
 
-
-uniform Material material;
+out vec4 FragColor;
 
 void main()
 {
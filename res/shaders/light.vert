@@ -1,17 +1,15 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 3) in vec2 aTex;
+#include "uniforms.glsl"
+#include "vertex.glsl"
 
 out vec3 crntPos;
 out vec3 Normal;
 out vec2 texCoord;
 
 uniform mat4 model;
-uniform mat4 camMatrix;
 
 void main()
 {
-	gl_Position = camMatrix * model * vec4(aPos, 1.0f);
+	gl_Position = camMatrix * model * vec4(MeshPosition(), 1.0f);
 }
\ No newline at end of file
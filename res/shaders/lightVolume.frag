@@ -0,0 +1,28 @@
+#version 330 core
+
+#include "uniforms.glsl"
+
+// Adds one point light to the HDR lighting buffer for the pixels inside its volume
+out vec4 FragColor;
+
+flat in uint LightIndex;
+
+vec3 FragPos;
+
+#include "pbr.glsl"
+#include "deferred.glsl"
+
+void main()
+{
+    Surface surface = ReadGBuffer(ivec2(gl_FragCoord.xy));
+    PointLight light = FetchPointLight(LightIndex);
+    FragPos = surface.position;
+    // The volume's back faces also cover surfaces in front of the light
+    if (distance(light.position, FragPos) > light.range)
+        discard;
+
+    vec3 N = surface.normal;
+    vec3 V = normalize(viewPos - FragPos);
+    vec3 F0 = mix(vec3(0.04), surface.albedo, surface.metallic);
+    FragColor = vec4(CalcPointLight(light, N, V, F0, surface.albedo, surface.roughness, surface.metallic), 1.0);
+}
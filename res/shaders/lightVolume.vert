@@ -0,0 +1,16 @@
+#version 330 core
+
+#include "uniforms.glsl"
+
+// Unit icosahedron, one instance per point light
+layout (location = 0) in vec3 aPos;
+
+flat out uint LightIndex;
+
+void main()
+{
+    PointLight light = FetchPointLight(uint(gl_InstanceID));
+    LightIndex = uint(gl_InstanceID);
+    // The faces of the icosahedron are 0.795 from its centre, scaled up it encloses the light's sphere
+    gl_Position = camMatrix * vec4(light.position + aPos * (light.range * 1.26), 1.0);
+}
@@ -0,0 +1,28 @@
+// Texture inputs of a mesh, bound by Mesh::BindTextures.
+// The including shader declares the TexCoords, FragPos and Normal inputs.
+
+uniform sampler2D albedoMap;
+uniform sampler2D normalMap;
+uniform sampler2D armMap;
+
+uniform bool textured;
+
+vec3 getNormalFromMap()
+{
+    // Z is rebuilt from XY so two channel (BC5) normal maps work as well as RGB ones
+    vec3 tangentNormal;
+    tangentNormal.xy = texture(normalMap, TexCoords).xy * 2.0 - 1.0;
+    tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
+
+    vec3 Q1  = dFdx(FragPos);
+    vec3 Q2  = dFdy(FragPos);
+    vec2 st1 = dFdx(TexCoords);
+    vec2 st2 = dFdy(TexCoords);
+
+    vec3 N   = normalize(Normal);
+    vec3 T  = normalize(Q1*st2.t - Q2*st1.t);
+    vec3 B  = -normalize(cross(N, T));
+    mat3 TBN = mat3(T, B, N);
+
+    return normalize(TBN * tangentNormal);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+
+// One band of the overdraw heat map, the stencil test picks the pixels shaded that many times
+out vec4 FragColor;
+
+uniform vec3 color;
+
+void main()
+{
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+#include "uniforms.glsl"
+#include "vertex.glsl"
+
+// Per instance when drawn instanced, otherwise the constant value Mesh::Draw sets
+layout (location = 3) in mat4 aModel;
+
+// Computed exactly like default.vert, the shading pass tests against this depth with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    vec3 FragPos = vec3(aModel * vec4(MeshPosition(), 1.0));
+    gl_Position = camMatrix * vec4(FragPos, 1.0);
+}
@@ -1,5 +1,6 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+
+#include "vertex.glsl"
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -8,7 +9,7 @@ out vec3 localPos;
 
 void main()
 {
-    localPos = aPos;
+    localPos = MeshPosition();
 
     mat4 rotView = mat4(mat3(view)); 
     vec4 clipPos = projection * rotView * vec4(localPos, 1.0);
@@ -0,0 +1,100 @@
+// Uniform blocks shared by every program, the std140 layout must match headers/uniformBlocks.h
+
+struct DirLight {
+    vec3 direction;
+    vec3 color;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 color;
+    float linear;
+    float quadratic;
+    float range;
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 color;
+    float quadratic;
+    float cutOff;
+    float outerCutOff;
+};
+
+// Updated once per frame (binding 0)
+layout (std140) uniform FrameData {
+    mat4 camMatrix;
+    vec3 viewPos;
+    int pointLightCount;
+    DirLight dLight;
+    SpotLight sLight;
+    // Light cluster grid, see LightClusters::Build: tiles per pixel, slice = log(depth) * z + w
+    vec4 clusterScale;
+    // Near and far plane
+    vec4 clusterDepth;
+    ivec4 clusterGrid;
+};
+
+// Point lights, three texels each, and the (offset, count) of every cluster into the light indices
+uniform samplerBuffer pointLights;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+
+// Updated when a model's material changes (binding 1)
+layout (std140) uniform MaterialData {
+    vec3 albedo;
+    float roughness;
+    float metallic;
+    float ao;
+} material;
+
+// Set by the skybox when its environment changes (binding 2)
+layout (std140) uniform IrradianceData {
+    vec4 irradianceSH[9];
+};
+
+// Diffuse irradiance (already divided by PI) arriving around the normal n
+vec3 IrradianceSH(vec3 n)
+{
+    vec3 result = irradianceSH[0].rgb * 0.282095
+                + irradianceSH[1].rgb * (0.488603 * n.y)
+                + irradianceSH[2].rgb * (0.488603 * n.z)
+                + irradianceSH[3].rgb * (0.488603 * n.x)
+                + irradianceSH[4].rgb * (1.092548 * n.x * n.y)
+                + irradianceSH[5].rgb * (1.092548 * n.y * n.z)
+                + irradianceSH[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+                + irradianceSH[7].rgb * (1.092548 * n.x * n.z)
+                + irradianceSH[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+    return max(result, vec3(0.0));
+}
+
+PointLight FetchPointLight(uint index)
+{
+    int texel = int(index) * 3;
+    vec4 a = texelFetch(pointLights, texel);
+    vec4 b = texelFetch(pointLights, texel + 1);
+    vec4 c = texelFetch(pointLights, texel + 2);
+    return PointLight(a.xyz, a.w, b.xyz, b.w, c.x, c.y);
+}
+
+// (offset, count) of the cluster holding the fragment at fragCoord
+uvec2 LightCluster(vec4 fragCoord)
+{
+    // Linear view depth back from the window depth
+    float ndc = fragCoord.z * 2.0 - 1.0;
+    float n = clusterDepth.x, f = clusterDepth.y;
+    float depth = 2.0 * n * f / (f + n - ndc * (f - n));
+    ivec3 cell = ivec3(ivec2(fragCoord.xy * clusterScale.xy), int(floor(log(depth) * clusterScale.z + clusterScale.w)));
+    cell = clamp(cell, ivec3(0), clusterGrid.xyz - 1);
+    return texelFetch(lightClusters, cell.x + clusterGrid.x * (cell.y + clusterGrid.y * cell.z)).xy;
+}
+
+// The i-th light of a cluster returned by LightCluster
+PointLight ClusterLight(uvec2 cluster, uint i)
+{
+    return FetchPointLight(texelFetch(lightIndices, int(cluster.x + i)).r);
+}
@@ -0,0 +1,30 @@
+// Mesh vertex inputs, stored as described by VertexLayout
+layout (location = 0) in vec3 aPos;
+// Octahedral encoded normal
+layout (location = 1) in vec2 aNormal;
+layout (location = 2) in vec2 aTex;
+// Constant per draw, undoes the position quantization (scale 1 and offset 0 for float positions)
+layout (location = 9) in vec3 aPositionScale;
+layout (location = 10) in vec3 aPositionOffset;
+
+// Object space position of this vertex, with the dequantization given explicitly
+vec3 MeshPosition(vec3 scale, vec3 offset)
+{
+    return aPos * scale + offset;
+}
+
+// Object space position of this vertex
+vec3 MeshPosition()
+{
+    return MeshPosition(aPositionScale, aPositionOffset);
+}
+
+// Object space normal of this vertex
+vec3 MeshNormal()
+{
+    vec3 n = vec3(aNormal, 1.0 - abs(aNormal.x) - abs(aNormal.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
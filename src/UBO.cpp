@@ -0,0 +1,44 @@
+#include "UBO.h"
+#include "renderStats.h"
+
+// Constructor that generates a Uniform Buffer Object with room for 'size' bytes
+UBO::UBO(GLsizeiptr size)
+{
+    glGenBuffers(1, &ID);
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Overwrites 'size' bytes starting at 'offset'
+void UBO::Update(const void *data, GLsizeiptr size, GLintptr offset)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Attaches the UBO to a uniform block binding point
+void UBO::BindBase(GLuint binding)
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    RenderStats::frame.bufferBinds++;
+}
+
+// Binds the UBO
+void UBO::Bind()
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+}
+
+// Unbinds the UBO
+void UBO::Unbind()
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Deletes the UBO
+void UBO::Delete()
+{
+    glDeleteBuffers(1, &ID);
+}
@@ -1,4 +1,5 @@
 #include "VAO.h"
+#include "renderStats.h"
 
 // Constructor that generates a VAO ID
 VAO::VAO()
@@ -7,10 +8,10 @@ VAO::VAO()
 }
 
 // Links a VBO Attribute such as a position or color to the VAO
-void VAO::LinkAttrib(VBO &VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void *offset)
+void VAO::LinkAttrib(VBO &VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void *offset, GLboolean normalized)
 {
     VBO.Bind();
-    glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
+    glVertexAttribPointer(layout, numComponents, type, normalized, stride, offset);
     glEnableVertexAttribArray(layout);
     VBO.Unbind();
 }
@@ -19,6 +20,7 @@ void VAO::LinkAttrib(VBO &VBO, GLuint layout, GLuint numComponents, GLenum type,
 void VAO::Bind()
 {
     glBindVertexArray(ID);
+    RenderStats::frame.bufferBinds++;
 }
 
 // Unbinds the VAO
@@ -0,0 +1,184 @@
+#include "accessor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static unsigned int componentsForType(const std::string &type)
+{
+    if (type == "SCALAR")
+        return 1;
+    if (type == "VEC2")
+        return 2;
+    if (type == "VEC3")
+        return 3;
+    if (type == "VEC4")
+        return 4;
+    throw std::invalid_argument("Type is invalid (not SCALAR, VEC2, VEC3, or VEC4)");
+}
+
+static unsigned int sizeOfComponent(unsigned int componentType)
+{
+    switch (componentType)
+    {
+    case COMPONENT_BYTE:
+    case COMPONENT_UNSIGNED_BYTE:
+        return 1;
+    case COMPONENT_SHORT:
+    case COMPONENT_UNSIGNED_SHORT:
+        return 2;
+    case COMPONENT_UNSIGNED_INT:
+    case COMPONENT_FLOAT:
+        return 4;
+    }
+    throw std::invalid_argument("Unsupported accessor componentType");
+}
+
+AccessorView::AccessorView(const json &gltf, const json &accessor, const unsigned char *data, size_t dataSize)
+{
+    count = accessor["count"];
+    numComponents = componentsForType(accessor["type"]);
+    componentType = accessor.value("componentType", (unsigned int)COMPONENT_FLOAT);
+    componentSize = sizeOfComponent(componentType);
+    normalized = accessor.value("normalized", false);
+    stride = numComponents * componentSize;
+
+    // Accessors without a bufferView are defined to be all zeros
+    if (accessor.find("bufferView") == accessor.end())
+        return;
+
+    const json &bufferView = gltf["bufferViews"][(unsigned int)accessor["bufferView"]];
+    size_t byteOffset = bufferView.value("byteOffset", (size_t)0) + accessor.value("byteOffset", (size_t)0);
+    stride = bufferView.value("byteStride", stride);
+
+    size_t elementSize = numComponents * componentSize;
+    if (count > 0 && byteOffset + (count - 1) * stride + elementSize > dataSize)
+        throw std::out_of_range("Accessor reads past the end of the binary buffer");
+
+    base = data + byteOffset;
+}
+
+float AccessorView::ReadFloat(size_t element, unsigned int component) const
+{
+    if (base == nullptr || component >= numComponents)
+        return 0.0f;
+
+    const unsigned char *src = base + element * stride + component * componentSize;
+    switch (componentType)
+    {
+    case COMPONENT_FLOAT:
+    {
+        float value;
+        std::memcpy(&value, src, sizeof(float));
+        return value;
+    }
+    case COMPONENT_BYTE:
+    {
+        signed char value = (signed char)*src;
+        return normalized ? std::max(value / 127.0f, -1.0f) : (float)value;
+    }
+    case COMPONENT_UNSIGNED_BYTE:
+        return normalized ? *src / 255.0f : (float)*src;
+    case COMPONENT_SHORT:
+    {
+        short value;
+        std::memcpy(&value, src, sizeof(short));
+        return normalized ? std::max(value / 32767.0f, -1.0f) : (float)value;
+    }
+    case COMPONENT_UNSIGNED_SHORT:
+    {
+        unsigned short value;
+        std::memcpy(&value, src, sizeof(unsigned short));
+        return normalized ? value / 65535.0f : (float)value;
+    }
+    case COMPONENT_UNSIGNED_INT:
+    {
+        unsigned int value;
+        std::memcpy(&value, src, sizeof(unsigned int));
+        return (float)value;
+    }
+    }
+    return 0.0f;
+}
+
+GLuint AccessorView::ReadIndex(size_t element) const
+{
+    if (base == nullptr)
+        return 0;
+
+    const unsigned char *src = base + element * stride;
+    switch (componentType)
+    {
+    case COMPONENT_UNSIGNED_BYTE:
+        return *src;
+    case COMPONENT_UNSIGNED_SHORT:
+    {
+        unsigned short value;
+        std::memcpy(&value, src, sizeof(unsigned short));
+        return value;
+    }
+    case COMPONENT_SHORT:
+    {
+        short value;
+        std::memcpy(&value, src, sizeof(short));
+        return (GLuint)value;
+    }
+    case COMPONENT_UNSIGNED_INT:
+    {
+        unsigned int value;
+        std::memcpy(&value, src, sizeof(unsigned int));
+        return value;
+    }
+    }
+    throw std::invalid_argument("Index accessor must be an integer type");
+}
+
+void AccessorView::CopyFloats(float *out, unsigned int outComponents, size_t outStride) const
+{
+    unsigned char *dst = (unsigned char *)out;
+    unsigned int n = std::min(numComponents, outComponents);
+
+    if (base == nullptr)
+    {
+        for (size_t i = 0; i < count; i++)
+            std::memset(dst + i * outStride, 0, outComponents * sizeof(float));
+        return;
+    }
+
+    if (componentType == COMPONENT_FLOAT)
+    {
+        // Whole accessor in one go when both sides are tightly packed
+        if (outComponents == numComponents && isPacked(outStride))
+        {
+            std::memcpy(dst, base, count * stride);
+            return;
+        }
+        for (size_t i = 0; i < count; i++)
+            std::memcpy(dst + i * outStride, base + i * stride, n * sizeof(float));
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float *element = (float *)(dst + i * outStride);
+        for (unsigned int c = 0; c < n; c++)
+            element[c] = ReadFloat(i, c);
+    }
+}
+
+void AccessorView::CopyIndices(GLuint *out) const
+{
+    if (componentType == COMPONENT_UNSIGNED_INT && base != nullptr && isPacked(sizeof(GLuint)))
+    {
+        std::memcpy(out, base, count * sizeof(GLuint));
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+        out[i] = ReadIndex(i);
+}
+
+bool AccessorView::isPacked(size_t outStride) const
+{
+    size_t elementSize = numComponents * componentSize;
+    return stride == elementSize && outStride == elementSize;
+}
@@ -0,0 +1,122 @@
+#include "bounds.h"
+
+#include <cmath>
+
+void AABB::Expand(const glm::vec3 &point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::Expand(const AABB &other)
+{
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+AABB AABB::Transform(const glm::mat4 &matrix) const
+{
+    // Transform the center, then project the extents onto the new axes (Arvo)
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(Center(), 1.0f));
+    glm::vec3 extents = Extents();
+    glm::vec3 newExtents = glm::vec3(0.0f);
+    for (int column = 0; column < 3; column++)
+    {
+        for (int row = 0; row < 3; row++)
+            newExtents[row] += std::abs(matrix[column][row]) * extents[column];
+    }
+
+    AABB result;
+    result.min = center - newExtents;
+    result.max = center + newExtents;
+    return result;
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4 &m)
+{
+    // Gribb/Hartmann: each plane is the last row plus or minus one of the others
+    glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+
+    for (glm::vec4 &plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+bool Frustum::Intersects(const AABB &box) const
+{
+    glm::vec3 center = box.Center();
+    glm::vec3 extents = box.Extents();
+    for (const glm::vec4 &plane : planes)
+    {
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+        if (distance + radius < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void BoundsSoA::Clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+void BoundsSoA::Push(const AABB &box)
+{
+    glm::vec3 center = box.Center();
+    glm::vec3 extents = box.Extents();
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    extentX.push_back(extents.x);
+    extentY.push_back(extents.y);
+    extentZ.push_back(extents.z);
+}
+
+size_t CullBoxes(const Frustum &frustum, const BoundsSoA &boxes, unsigned char *visible)
+{
+    size_t count = boxes.Size();
+    const float *cx = boxes.centerX.data();
+    const float *cy = boxes.centerY.data();
+    const float *cz = boxes.centerZ.data();
+    const float *ex = boxes.extentX.data();
+    const float *ey = boxes.extentY.data();
+    const float *ez = boxes.extentZ.data();
+
+    for (size_t i = 0; i < count; i++)
+        visible[i] = 1;
+
+    // One pass per plane keeps the inner loop a straight run of multiply-adds over the arrays
+    for (const glm::vec4 &plane : frustum.planes)
+    {
+        const float px = plane.x, py = plane.y, pz = plane.z, pw = plane.w;
+        const float ax = std::abs(px), ay = std::abs(py), az = std::abs(pz);
+        for (size_t i = 0; i < count; i++)
+        {
+            float distance = px * cx[i] + py * cy[i] + pz * cz[i] + pw;
+            float radius = ax * ex[i] + ay * ey[i] + az * ez[i];
+            visible[i] &= (unsigned char)(distance + radius >= 0.0f);
+        }
+    }
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < count; i++)
+        visibleCount += visible[i];
+    return visibleCount;
+}
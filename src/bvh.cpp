@@ -0,0 +1,420 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    AABB merge(const AABB &a, const AABB &b)
+    {
+        AABB result = a;
+        result.Expand(b);
+        return result;
+    }
+
+    // Slab test, returns the entry distance or -1 if the ray misses the box before 'maxDistance'
+    float rayBox(const AABB &box, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance)
+    {
+        glm::vec3 t0 = (box.min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.max - origin) * inverseDirection;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+        return enter <= exit ? enter : -1.0f;
+    }
+
+    bool sphereBox(const AABB &box, const glm::vec3 &center, float radius)
+    {
+        glm::vec3 offset = center - glm::clamp(center, box.min, box.max);
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+}
+
+int BVH::Insert(const AABB &box, void *userData)
+{
+    int leaf = allocateNode();
+    nodes[leaf].box.min = box.min - glm::vec3(margin);
+    nodes[leaf].box.max = box.max + glm::vec3(margin);
+    nodes[leaf].userData = userData;
+    nodes[leaf].height = 0;
+    insertLeaf(leaf);
+    leafCount++;
+
+    changesSinceCheck++;
+    checkQuality();
+    return leaf;
+}
+
+void BVH::Remove(int proxy)
+{
+    removeLeaf(proxy);
+    freeNode(proxy);
+    leafCount--;
+}
+
+bool BVH::Move(int proxy, const AABB &box)
+{
+    if (nodes[proxy].box.Contains(box))
+        return false;
+
+    // Refit in place, the tree gets rebuilt once the stretched boxes make it too loose
+    nodes[proxy].box.min = box.min - glm::vec3(margin);
+    nodes[proxy].box.max = box.max + glm::vec3(margin);
+    refit(nodes[proxy].parent);
+
+    changesSinceCheck++;
+    checkQuality();
+    return true;
+}
+
+void BVH::Rebuild()
+{
+    // Keep the leaves (they are the proxies), throw away every internal node
+    std::vector<BuildEntry> entries;
+    entries.reserve(leafCount);
+    for (int i = 0; i < (int)nodes.size(); i++)
+    {
+        if (nodes[i].height < 0)
+            continue;
+        if (nodes[i].IsLeaf())
+            entries.push_back({nodes[i].box, nodes[i].box.Center(), i});
+        else
+            freeNode(i);
+    }
+
+    root = entries.empty() ? -1 : build(entries, 0, entries.size());
+    if (root != -1)
+        nodes[root].parent = -1;
+
+    rebuiltCost = Cost();
+    changesSinceCheck = 0;
+}
+
+void BVH::QueryFrustum(const Frustum &frustum, const std::function<void(void *)> &callback) const
+{
+    if (root == -1)
+        return;
+
+    std::vector<int> stack;
+    stack.reserve(64);
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        if (!frustum.Intersects(node.box))
+            continue;
+
+        if (node.IsLeaf())
+        {
+            callback(node.userData);
+        }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+void BVH::QuerySphere(const glm::vec3 &center, float radius, const std::function<void(void *)> &callback) const
+{
+    if (root == -1)
+        return;
+
+    std::vector<int> stack;
+    stack.reserve(64);
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        if (!sphereBox(node.box, center, radius))
+            continue;
+
+        if (node.IsLeaf())
+        {
+            callback(node.userData);
+        }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+void *BVH::Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &distance) const
+{
+    void *hit = nullptr;
+    distance = std::numeric_limits<float>::max();
+    if (root == -1)
+        return hit;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    std::vector<int> stack;
+    stack.reserve(64);
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        // Closer hits shrink 'distance', which prunes everything behind them
+        float t = rayBox(node.box, origin, inverseDirection, distance);
+        if (t < 0.0f)
+            continue;
+
+        if (node.IsLeaf())
+        {
+            distance = t;
+            hit = node.userData;
+        }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+    return hit;
+}
+
+float BVH::Cost() const
+{
+    if (root == -1)
+        return 0.0f;
+
+    float internalArea = 0.0f;
+    for (const Node &node : nodes)
+    {
+        if (node.height > 0)
+            internalArea += node.box.SurfaceArea();
+    }
+    float rootArea = nodes[root].box.SurfaceArea();
+    return rootArea > 0.0f ? internalArea / rootArea : 0.0f;
+}
+
+int BVH::allocateNode()
+{
+    if (freeList == -1)
+    {
+        nodes.emplace_back();
+        return (int)nodes.size() - 1;
+    }
+
+    // Free nodes are chained through 'parent'
+    int node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node();
+    return node;
+}
+
+void BVH::freeNode(int node)
+{
+    nodes[node] = Node();
+    nodes[node].parent = freeList;
+    freeList = node;
+}
+
+void BVH::insertLeaf(int leaf)
+{
+    if (root == -1)
+    {
+        root = leaf;
+        nodes[root].parent = -1;
+        return;
+    }
+
+    // Walk down to the sibling that adds the least surface area (Box2D's descent)
+    AABB leafBox = nodes[leaf].box;
+    int index = root;
+    while (!nodes[index].IsLeaf())
+    {
+        float area = nodes[index].box.SurfaceArea();
+        float combinedArea = merge(nodes[index].box, leafBox).SurfaceArea();
+
+        // Cost of pairing the leaf with this node, and the growth every deeper choice inherits
+        float cost = 2.0f * combinedArea;
+        float inheritance = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int child)
+        {
+            float grown = merge(nodes[child].box, leafBox).SurfaceArea();
+            if (nodes[child].IsLeaf())
+                return grown + inheritance;
+            return grown - nodes[child].box.SurfaceArea() + inheritance;
+        };
+        float cost1 = descendCost(nodes[index].child1);
+        float cost2 = descendCost(nodes[index].child2);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+        index = cost1 < cost2 ? nodes[index].child1 : nodes[index].child2;
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == -1)
+        root = newParent;
+    else if (nodes[oldParent].child1 == sibling)
+        nodes[oldParent].child1 = newParent;
+    else
+        nodes[oldParent].child2 = newParent;
+
+    refit(newParent);
+}
+
+void BVH::removeLeaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = -1;
+        return;
+    }
+
+    // The sibling takes the parent's place
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    nodes[sibling].parent = grandParent;
+    if (grandParent == -1)
+        root = sibling;
+    else if (nodes[grandParent].child1 == parent)
+        nodes[grandParent].child1 = sibling;
+    else
+        nodes[grandParent].child2 = sibling;
+
+    freeNode(parent);
+    nodes[leaf].parent = -1;
+    refit(grandParent);
+}
+
+void BVH::refit(int node)
+{
+    while (node != -1)
+    {
+        Node &current = nodes[node];
+        current.box = merge(nodes[current.child1].box, nodes[current.child2].box);
+        current.height = 1 + std::max(nodes[current.child1].height, nodes[current.child2].height);
+        node = current.parent;
+    }
+}
+
+void BVH::checkQuality()
+{
+    // Measuring the cost walks every node, so only do it after a fraction of the tree changed
+    if (changesSinceCheck < 16 || (size_t)changesSinceCheck * 8 < leafCount)
+        return;
+    changesSinceCheck = 0;
+
+    if (rebuiltCost == 0.0f || Cost() > rebuiltCost * rebuildThreshold)
+        Rebuild();
+}
+
+int BVH::build(std::vector<BuildEntry> &entries, size_t begin, size_t end)
+{
+    if (end - begin == 1)
+        return entries[begin].leaf;
+
+    AABB bounds = entries[begin].box;
+    AABB centroids;
+    centroids.min = centroids.max = entries[begin].center;
+    for (size_t i = begin + 1; i < end; i++)
+    {
+        bounds.Expand(entries[i].box);
+        centroids.Expand(entries[i].center);
+    }
+
+    // Binned SAH: sort the centroids into buckets along each axis and try every bucket boundary
+    const int binCount = 12;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroids.max[axis] - centroids.min[axis];
+        if (extent <= 0.0f)
+            continue;
+        float binScale = binCount / extent;
+
+        AABB binBoxes[binCount];
+        int binCounts[binCount] = {};
+        for (size_t i = begin; i < end; i++)
+        {
+            int bin = std::min(binCount - 1, (int)((entries[i].center[axis] - centroids.min[axis]) * binScale));
+            binBoxes[bin] = binCounts[bin]++ == 0 ? entries[i].box : merge(binBoxes[bin], entries[i].box);
+        }
+
+        // Sweep from the right to know the area and count right of every boundary
+        float rightArea[binCount];
+        int rightCount[binCount];
+        AABB accumulated;
+        int count = 0;
+        for (int bin = binCount - 1; bin > 0; bin--)
+        {
+            if (binCounts[bin] > 0)
+            {
+                accumulated = count == 0 ? binBoxes[bin] : merge(accumulated, binBoxes[bin]);
+                count += binCounts[bin];
+            }
+            rightArea[bin] = count > 0 ? accumulated.SurfaceArea() : 0.0f;
+            rightCount[bin] = count;
+        }
+
+        // Then sweep from the left, splitting after 'bin'
+        count = 0;
+        for (int bin = 0; bin < binCount - 1; bin++)
+        {
+            if (binCounts[bin] > 0)
+            {
+                accumulated = count == 0 ? binBoxes[bin] : merge(accumulated, binBoxes[bin]);
+                count += binCounts[bin];
+            }
+            if (count == 0 || rightCount[bin + 1] == 0)
+                continue;
+
+            float cost = count * accumulated.SurfaceArea() + rightCount[bin + 1] * rightArea[bin + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = bin;
+            }
+        }
+    }
+
+    size_t middle = (begin + end) / 2;
+    if (bestAxis != -1)
+    {
+        float binScale = binCount / (centroids.max[bestAxis] - centroids.min[bestAxis]);
+        auto left = [&](const BuildEntry &entry)
+        {
+            int bin = std::min(binCount - 1, (int)((entry.center[bestAxis] - centroids.min[bestAxis]) * binScale));
+            return bin <= bestSplit;
+        };
+        middle = std::partition(entries.begin() + begin, entries.begin() + end, left) - entries.begin();
+    }
+    // Every centroid in one spot: split the range in half
+    if (middle == begin || middle == end)
+        middle = (begin + end) / 2;
+
+    int child1 = build(entries, begin, middle);
+    int child2 = build(entries, middle, end);
+
+    int node = allocateNode();
+    nodes[node].box = bounds;
+    nodes[node].child1 = child1;
+    nodes[node].child2 = child2;
+    nodes[node].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+    nodes[child1].parent = node;
+    nodes[child2].parent = node;
+    return node;
+}
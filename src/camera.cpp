@@ -16,11 +16,23 @@ void Camera::updateMatrix(float FOVdeg, float nearPlane, float farPlane)
     cameraMatrix = projection * view;
 }
 
-void Camera::Matrix(Shader &shader, const char *uniform)
+void Camera::Matrix(Shader &shader)
 {
+    shader.SetMat4(shader.uniforms.camMatrix, cameraMatrix);
+    shader.SetVec3(shader.uniforms.viewPos, Position);
+}
 
-    glUniformMatrix4fv(glGetUniformLocation(shader.ID, uniform), 1, GL_FALSE, glm::value_ptr(cameraMatrix));
-    glUniform3f(glGetUniformLocation(shader.ID, "viewPos"), Position.x, Position.y, Position.z);
+void Camera::CursorRay(double cursorX, double cursorY)
+{
+    // Cursor to NDC (y points down in window space), then back through the inverse camera matrix
+    float x = 2.0f * (float)cursorX / width - 1.0f;
+    float y = 1.0f - 2.0f * (float)cursorY / height;
+    glm::mat4 inverseCamera = glm::inverse(cameraMatrix);
+
+    glm::vec4 nearPoint = inverseCamera * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseCamera * glm::vec4(x, y, 1.0f, 1.0f);
+    pickOrigin = glm::vec3(nearPoint) / nearPoint.w;
+    pickDirection = glm::normalize(glm::vec3(farPoint) / farPoint.w - pickOrigin);
 }
 
 void Camera::Inputs(GLFWwindow *window)
@@ -98,6 +110,16 @@ void Camera::Inputs(GLFWwindow *window)
 
         if (firstClick)
         {
+            // Pick where the user clicked, before the cursor gets recentred for rotating
+            if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+            {
+                double clickX;
+                double clickY;
+                glfwGetCursorPos(window, &clickX, &clickY);
+                CursorRay(clickX, clickY);
+                pickRequested = true;
+            }
+
             glfwSetCursorPos(window, (width / 2), (height / 2));
             firstClick = false;
         }
@@ -0,0 +1,518 @@
+#include "compressedTexture.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+    uint32_t fourCC(const char code[4])
+    {
+        return (uint32_t)(unsigned char)code[0] | ((uint32_t)(unsigned char)code[1] << 8) |
+               ((uint32_t)(unsigned char)code[2] << 16) | ((uint32_t)(unsigned char)code[3] << 24);
+    }
+
+    struct DDSPixelFormat
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t masks[4];
+    };
+
+    struct DDSHeader
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DDSPixelFormat pixelFormat;
+        uint32_t caps[4];
+        uint32_t reserved2;
+    };
+
+    struct DDSHeaderDX10
+    {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    struct KTX2Header
+    {
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct KTX2Level
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    // UNORM format of a DXGI code, sRGB codes included. TextureCache picks the sRGB twin itself for albedo
+    // textures, so the file's own tag doesn't decide how the data is sampled.
+    GLenum formatFromDXGI(uint32_t dxgi)
+    {
+        switch (dxgi)
+        {
+        case 71:
+        case 72: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        case 77:
+        case 78: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case 80: return GL_COMPRESSED_RED_RGTC1;
+        case 83: return GL_COMPRESSED_RG_RGTC2;
+        case 98:
+        case 99: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        default: return 0;
+        }
+    }
+
+    GLenum formatFromVulkan(uint32_t vkFormat)
+    {
+        switch (vkFormat)
+        {
+        case 131: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case 133: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        case 137: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case 139: return GL_COMPRESSED_RED_RGTC1;
+        case 141: return GL_COMPRESSED_RG_RGTC2;
+        case 145: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        default: return 0;
+        }
+    }
+
+    uint32_t vulkanFromFormat(GLenum format)
+    {
+        switch (format)
+        {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return 131;
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return 133;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return 137;
+        case GL_COMPRESSED_RED_RGTC1: return 139;
+        case GL_COMPRESSED_RG_RGTC2: return 141;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM: return 145;
+        default: return 0;
+        }
+    }
+
+    // One sample of a KTX2 data format descriptor: which channel sits at which bits of the block
+    struct DFDSample
+    {
+        uint32_t bitOffset;
+        uint32_t bitLength;
+        uint32_t channel;
+    };
+
+    // Basic data format descriptor of a linear block compressed format, with its total size word in front
+    std::vector<uint32_t> formatDescriptor(GLenum format)
+    {
+        // Color models and channel ids from the Khronos Data Format specification
+        const uint32_t BC1A = 128, BC3 = 130, BC4 = 131, BC5 = 132, BC7 = 134;
+        const uint32_t COLOR = 0, GREEN = 1, ALPHA = 15;
+        uint32_t model = 0;
+        std::vector<DFDSample> samples;
+        switch (format)
+        {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: model = BC1A; samples = {{0, 64, COLOR}}; break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: model = BC1A; samples = {{0, 64, ALPHA}}; break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: model = BC3; samples = {{0, 64, ALPHA}, {64, 64, COLOR}}; break;
+        case GL_COMPRESSED_RED_RGTC1: model = BC4; samples = {{0, 64, COLOR}}; break;
+        case GL_COMPRESSED_RG_RGTC2: model = BC5; samples = {{0, 64, COLOR}, {64, 64, GREEN}}; break;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM: model = BC7; samples = {{0, 128, COLOR}}; break;
+        default: return {};
+        }
+
+        uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+        std::vector<uint32_t> words = {
+            4 + blockSize,
+            0,                                            // Khronos vendor, basic descriptor
+            (blockSize << 16) | 2,                        // version 2
+            model | (1u << 8) | (1u << 16),               // BT.709 primaries, linear transfer, straight alpha
+            3 | (3u << 8),                                // 4x4x1x1 texels, stored minus one
+            (uint32_t)CompressedTexture::BlockBytes(format),
+            0};
+        for (const DFDSample &sample : samples)
+        {
+            words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+            words.push_back(0);
+            words.push_back(0);
+            words.push_back(0xFFFFFFFFu);
+        }
+        return words;
+    }
+
+    // Whether the "KTXorientation" value in the key/value data says rows go up (bottom row first)
+    bool bottomRowFirst(const unsigned char *data, size_t size, const KTX2Header &header)
+    {
+        const char key[] = "KTXorientation";
+        size_t offset = header.kvdByteOffset;
+        size_t end = (size_t)header.kvdByteOffset + header.kvdByteLength;
+        if (end > size)
+            return false;
+        while (offset + 4 <= end)
+        {
+            uint32_t length;
+            std::memcpy(&length, data + offset, 4);
+            offset += 4;
+            if (length > end - offset)
+                return false;
+            const char *entry = (const char *)data + offset;
+            if (length > sizeof(key) + 1 && std::memcmp(entry, key, sizeof(key)) == 0)
+                return entry[sizeof(key) + 1] == 'u';
+            offset += (length + 3) & ~3u;
+        }
+        return false;
+    }
+
+    // Reverses the first 'rows' rows of 4 two bit indices of a BC1 color block
+    void flipColorRows(unsigned char *block, int rows)
+    {
+        std::reverse(block + 4, block + 4 + rows);
+    }
+
+    // Same for the 4 three bit indices per row after the two endpoints of a BC4 block (BC3 alpha, each BC5 half)
+    void flipAlphaRows(unsigned char *block, int rows)
+    {
+        uint64_t bits = 0, flippedBits = 0;
+        std::memcpy(&bits, block + 2, 6);
+        for (int row = 0; row < 4; row++)
+        {
+            int target = row < rows ? rows - 1 - row : row;
+            flippedBits |= ((bits >> (12 * row)) & 0xFFF) << (12 * target);
+        }
+        std::memcpy(block + 2, &flippedBits, 6);
+    }
+
+    bool endsWith(const std::string &text, const std::string &suffix)
+    {
+        if (text.size() < suffix.size())
+            return false;
+        return std::equal(suffix.rbegin(), suffix.rend(), text.rbegin(), [](char a, char b)
+                          { return std::tolower((unsigned char)a) == b; });
+    }
+}
+
+size_t CompressedImage::Bytes() const
+{
+    size_t bytes = 0;
+    for (const CompressedLevel &level : levels)
+        bytes += level.size;
+    return bytes;
+}
+
+bool CompressedTexture::Load(const std::string &path, CompressedImage &image)
+{
+    try
+    {
+        image.file = MappedFile(path);
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+
+    const unsigned char *data = image.file.Data();
+    size_t size = image.file.Size();
+    image.flipped.clear();
+    bool parsed = false;
+    if (endsWith(path, ".dds"))
+        parsed = ParseDDS(data, size, image);
+    else if (endsWith(path, ".ktx2"))
+        parsed = ParseKTX2(data, size, image);
+    if (!parsed || !image.topRowFirst)
+        return parsed;
+
+    if (!FlipRows(image))
+    {
+        std::cerr << path << ": " << FormatName(image.internalFormat) << " stored top row first can't be flipped, re-encode it with bcEncoder" << std::endl;
+        return false;
+    }
+    // Everything lives in 'flipped' now
+    image.file = MappedFile();
+    return true;
+}
+
+bool CompressedTexture::ParseDDS(const unsigned char *data, size_t size, CompressedImage &image)
+{
+    DDSHeader header;
+    if (size < 4 + sizeof(header) || std::memcmp(data, "DDS ", 4) != 0)
+        return false;
+    std::memcpy(&header, data + 4, sizeof(header));
+    size_t offset = 4 + sizeof(header);
+
+    GLenum format = 0;
+    uint32_t code = header.pixelFormat.fourCC;
+    if (code == fourCC("DX10"))
+    {
+        DDSHeaderDX10 dx10;
+        if (size < offset + sizeof(dx10))
+            return false;
+        std::memcpy(&dx10, data + offset, sizeof(dx10));
+        offset += sizeof(dx10);
+        // Plain 2D textures only
+        if (dx10.resourceDimension != 3 || dx10.arraySize > 1)
+            return false;
+        format = formatFromDXGI(dx10.dxgiFormat);
+    }
+    else if (code == fourCC("DXT1"))
+        format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    else if (code == fourCC("DXT5"))
+        format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    else if (code == fourCC("ATI1") || code == fourCC("BC4U"))
+        format = GL_COMPRESSED_RED_RGTC1;
+    else if (code == fourCC("ATI2") || code == fourCC("BC5U"))
+        format = GL_COMPRESSED_RG_RGTC2;
+    if (format == 0 || header.width == 0 || header.height == 0)
+        return false;
+
+    image.internalFormat = format;
+    image.width = (int)header.width;
+    image.height = (int)header.height;
+    // DDS rows always start at the top
+    image.topRowFirst = true;
+    image.levels.clear();
+    uint32_t levelCount = std::max(1u, header.mipMapCount);
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        int width = std::max(1, image.width >> i);
+        int height = std::max(1, image.height >> i);
+        size_t bytes = LevelBytes(format, width, height);
+        if (offset + bytes > size)
+            return false;
+        image.levels.push_back({offset, bytes, width, height});
+        offset += bytes;
+    }
+    return true;
+}
+
+bool CompressedTexture::ParseKTX2(const unsigned char *data, size_t size, CompressedImage &image)
+{
+    KTX2Header header;
+    if (size < sizeof(KTX2_IDENTIFIER) + sizeof(header) || std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        return false;
+    std::memcpy(&header, data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+
+    GLenum format = formatFromVulkan(header.vkFormat);
+    // Plain, uncompressed at the container level, 2D textures only
+    if (format == 0 || header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1 ||
+        header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0)
+        return false;
+
+    image.internalFormat = format;
+    image.width = (int)header.pixelWidth;
+    image.height = (int)header.pixelHeight;
+    // Without an orientation KTX2 rows start at the top ("rd")
+    image.topRowFirst = !bottomRowFirst(data, size, header);
+    image.levels.clear();
+    uint32_t levelCount = std::max(1u, header.levelCount);
+    size_t indexOffset = sizeof(KTX2_IDENTIFIER) + sizeof(header);
+    if (size < indexOffset + levelCount * sizeof(KTX2Level))
+        return false;
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        KTX2Level level;
+        std::memcpy(&level, data + indexOffset + i * sizeof(KTX2Level), sizeof(level));
+        int width = std::max(1, image.width >> i);
+        int height = std::max(1, image.height >> i);
+        if (level.byteOffset + level.byteLength > size || level.byteLength < LevelBytes(format, width, height))
+            return false;
+        image.levels.push_back({(size_t)level.byteOffset, LevelBytes(format, width, height), width, height});
+    }
+    return true;
+}
+
+bool CompressedTexture::FlipRows(CompressedImage &image)
+{
+    GLenum format = image.internalFormat;
+    size_t blockBytes = BlockBytes(format);
+    if (blockBytes == 0 || format == GL_COMPRESSED_RGBA_BPTC_UNORM || format == GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM)
+        return false;
+    for (const CompressedLevel &level : image.levels)
+    {
+        if (level.height > 4 && level.height % 4 != 0)
+            return false;
+    }
+
+    std::vector<unsigned char> flipped(image.Bytes());
+    size_t offset = 0;
+    for (CompressedLevel &level : image.levels)
+    {
+        const unsigned char *source = image.Data(level);
+        size_t rowBytes = (size_t)((level.width + 3) / 4) * blockBytes;
+        int blockRows = (level.height + 3) / 4;
+        // A level shorter than a block only has its first rows flipped
+        int rows = std::min(level.height, 4);
+        for (int row = 0; row < blockRows; row++)
+        {
+            unsigned char *target = flipped.data() + offset + (size_t)(blockRows - 1 - row) * rowBytes;
+            std::memcpy(target, source + (size_t)row * rowBytes, rowBytes);
+            for (unsigned char *block = target; block < target + rowBytes; block += blockBytes)
+            {
+                switch (format)
+                {
+                case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+                case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+                    flipColorRows(block, rows);
+                    break;
+                case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+                    flipAlphaRows(block, rows);
+                    flipColorRows(block + 8, rows);
+                    break;
+                case GL_COMPRESSED_RED_RGTC1:
+                    flipAlphaRows(block, rows);
+                    break;
+                case GL_COMPRESSED_RG_RGTC2:
+                    flipAlphaRows(block, rows);
+                    flipAlphaRows(block + 8, rows);
+                    break;
+                }
+            }
+        }
+        level.offset = offset;
+        offset += level.size;
+    }
+    image.flipped.swap(flipped);
+    image.topRowFirst = false;
+    return true;
+}
+
+bool CompressedTexture::WriteKTX2(const std::string &path, GLenum internalFormat, int width, int height, const std::vector<std::vector<unsigned char>> &levels)
+{
+    uint32_t vkFormat = vulkanFromFormat(internalFormat);
+    if (vkFormat == 0 || levels.empty())
+        return false;
+
+    // "KTXorientation" = "ru": x goes right, y goes up, so the first row is the bottom one
+    const char orientation[] = "KTXorientation\0ru";
+    uint32_t keyValueLength = sizeof(orientation);
+    std::vector<unsigned char> keyValues(4 + ((keyValueLength + 3) & ~3u), 0);
+    std::memcpy(keyValues.data(), &keyValueLength, 4);
+    std::memcpy(keyValues.data() + 4, orientation, sizeof(orientation));
+    std::vector<uint32_t> descriptor = formatDescriptor(internalFormat);
+
+    KTX2Header header = {};
+    header.vkFormat = vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = (uint32_t)width;
+    header.pixelHeight = (uint32_t)height;
+    header.faceCount = 1;
+    header.levelCount = (uint32_t)levels.size();
+    size_t indexOffset = sizeof(KTX2_IDENTIFIER) + sizeof(header);
+    header.dfdByteOffset = (uint32_t)(indexOffset + levels.size() * sizeof(KTX2Level));
+    header.dfdByteLength = (uint32_t)(descriptor.size() * 4);
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = (uint32_t)keyValues.size();
+
+    // Smallest level first in the file, each starting on a block boundary
+    size_t blockBytes = BlockBytes(internalFormat);
+    size_t offset = header.kvdByteOffset + header.kvdByteLength;
+    std::vector<KTX2Level> index(levels.size());
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+        offset = (offset + blockBytes - 1) / blockBytes * blockBytes;
+        index[i] = {offset, levels[i].size(), levels[i].size()};
+        offset += levels[i].size();
+    }
+
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER), 1, file) == 1 &&
+              std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(index.data(), sizeof(KTX2Level), index.size(), file) == index.size() &&
+              std::fwrite(descriptor.data(), 4, descriptor.size(), file) == descriptor.size() &&
+              std::fwrite(keyValues.data(), 1, keyValues.size(), file) == keyValues.size();
+    size_t written = header.kvdByteOffset + header.kvdByteLength;
+    const unsigned char padding[16] = {};
+    for (size_t i = levels.size(); ok && i-- > 0;)
+    {
+        ok = std::fwrite(padding, 1, index[i].byteOffset - written, file) == index[i].byteOffset - written &&
+             std::fwrite(levels[i].data(), 1, levels[i].size(), file) == levels[i].size();
+        written = index[i].byteOffset + levels[i].size();
+    }
+    return std::fclose(file) == 0 && ok;
+}
+
+size_t CompressedTexture::BlockBytes(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+size_t CompressedTexture::LevelBytes(GLenum internalFormat, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * BlockBytes(internalFormat);
+}
+
+GLenum CompressedTexture::SRGBFormat(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    default: return 0;
+    }
+}
+
+const char *CompressedTexture::FormatName(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return "BC1";
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT: return "BC1 sRGB";
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: return "BC3 sRGB";
+    case GL_COMPRESSED_RED_RGTC1: return "BC4";
+    case GL_COMPRESSED_RG_RGTC2: return "BC5";
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: return "BC7";
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM: return "BC7 sRGB";
+    default: return "unknown";
+    }
+}
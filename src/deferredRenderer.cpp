@@ -0,0 +1,211 @@
+#include "deferredRenderer.h"
+#include "light.h"
+#include "renderStats.h"
+
+#include <cmath>
+
+namespace
+{
+    GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, glm::ivec2 size)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.x, size.y, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+}
+
+DeferredRenderer::DeferredRenderer()
+    : geometryShader("res/shaders/default.vert", "res/shaders/gbuffer.frag"),
+      lightingShader("res/shaders/deferred.vert", "res/shaders/deferred.frag"),
+      volumeShader("res/shaders/lightVolume.vert", "res/shaders/lightVolume.frag"),
+      resolveShader("res/shaders/deferred.vert", "res/shaders/deferred_resolve.frag")
+{
+    // Samplers stay on their units, only the textures behind them change
+    for (Shader *shader : {&lightingShader, &volumeShader, &resolveShader})
+    {
+        shader->Activate();
+        shader->SetInt(shader->Uniform("gAlbedoAo"), GBUFFER_ALBEDO_TEXTURE_UNIT);
+        shader->SetInt(shader->Uniform("gNormalRM"), GBUFFER_NORMAL_TEXTURE_UNIT);
+        shader->SetInt(shader->Uniform("gDepth"), GBUFFER_DEPTH_TEXTURE_UNIT);
+        shader->SetInt(shader->Uniform("lighting"), LIGHTING_TEXTURE_UNIT);
+    }
+    glUseProgram(0);
+
+    // Icosahedron on the unit sphere
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    const float s = 1.0f / std::sqrt(1.0f + t * t);
+    GLfloat vertices[] = {
+        -s, t * s, 0, s, t * s, 0, -s, -t * s, 0, s, -t * s, 0,
+        0, -s, t * s, 0, s, t * s, 0, -s, -t * s, 0, s, -t * s,
+        t * s, 0, -s, t * s, 0, s, -t * s, 0, -s, -t * s, 0, s};
+    GLuint indices[] = {
+        0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+        1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+        3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+        4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1};
+    volumeIndices = sizeof(indices) / sizeof(GLuint);
+
+    volumeVAO.Bind();
+    VBO volumeVBO(vertices, sizeof(vertices));
+    EBO volumeEBO(indices, sizeof(indices));
+    volumeVAO.LinkAttrib(volumeVBO, 0, 3, GL_FLOAT, 3 * sizeof(float), (void *)0);
+    volumeVAO.Unbind();
+    volumeVBO.Unbind();
+    volumeEBO.Unbind();
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+    glDeleteFramebuffers(1, &gBuffer);
+    glDeleteFramebuffers(1, &lightBuffer);
+    GLuint textures[] = {albedoAo, normalRM, depth, lighting};
+    glDeleteTextures(4, textures);
+    glDeleteRenderbuffers(1, &lightingDepth);
+    emptyVAO.Delete();
+    volumeVAO.Delete();
+}
+
+size_t DeferredRenderer::BytesPerPixel()
+{
+    // RGBA8 + RGBA16 + depth, then RGBA16F + its depth copy
+    return 4 + 8 + 4 + 8 + 4;
+}
+
+void DeferredRenderer::resize(glm::ivec2 newSize)
+{
+    glDeleteFramebuffers(1, &gBuffer);
+    glDeleteFramebuffers(1, &lightBuffer);
+    GLuint textures[] = {albedoAo, normalRM, depth, lighting};
+    glDeleteTextures(4, textures);
+    glDeleteRenderbuffers(1, &lightingDepth);
+    size = newSize;
+
+    albedoAo = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, size);
+    normalRM = createTarget(GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT, size);
+    depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, size);
+    lighting = createTarget(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, size);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &gBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoAo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalRM, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    GLenum attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, attachments);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "G-buffer incomplete" << std::endl;
+
+    // Sampling 'depth' while it is also the attachment tested against would be a feedback loop
+    glGenRenderbuffers(1, &lightingDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, lightingDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x, size.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &lightBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lighting, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, lightingDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Lighting buffer incomplete" << std::endl;
+}
+
+void DeferredRenderer::Begin()
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, targetViewport);
+    glm::ivec2 viewportSize(targetViewport[2], targetViewport[3]);
+    if (viewportSize != size)
+        resize(viewportSize);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glViewport(0, 0, size.x, size.y);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::End(Camera &camera)
+{
+    glm::mat4 inverseCamMatrix = glm::inverse(camera.cameraMatrix);
+    GLuint textures[] = {albedoAo, normalRM, depth};
+    GLuint units[] = {GBUFFER_ALBEDO_TEXTURE_UNIT, GBUFFER_NORMAL_TEXTURE_UNIT, GBUFFER_DEPTH_TEXTURE_UNIT};
+    for (int i = 0; i < 3; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0 + LIGHTING_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, lighting);
+    glActiveTexture(GL_TEXTURE0);
+    RenderStats::frame.textureBinds += 4;
+
+    // Depth copy for the light volumes' test, then the fullscreen pass over every pixel with geometry
+    GLsizei lights = (GLsizei)Light::clusters.Lights();
+    bool drawVolumes = lightVolumes && lights > 0;
+    if (drawVolumes)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lightBuffer);
+        glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_DEPTH_TEST);
+    lightingShader.Activate();
+    lightingShader.SetMat4(lightingShader.Uniform("inverseCamMatrix"), inverseCamMatrix);
+    lightingShader.SetInt(lightingShader.Uniform("clusteredLights"), !lightVolumes);
+    emptyVAO.Bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    RenderStats::frame.drawCalls++;
+
+    // Back faces of the volumes behind the scene surface, clamped instead of clipped at the far plane
+    if (drawVolumes)
+    {
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GEQUAL);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        volumeShader.Activate();
+        volumeShader.SetMat4(volumeShader.Uniform("inverseCamMatrix"), inverseCamMatrix);
+        volumeVAO.Bind();
+        glDrawElementsInstanced(GL_TRIANGLES, volumeIndices, GL_UNSIGNED_INT, 0, lights);
+        RenderStats::frame.drawCalls++;
+        RenderStats::frame.instances += lights;
+
+        glDisable(GL_BLEND);
+        glCullFace(GL_BACK);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_CLAMP);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+
+    // Tone map into the target, the depth goes with it so later passes (the skybox) test against the scene
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    glViewport(targetViewport[0], targetViewport[1], targetViewport[2], targetViewport[3]);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    resolveShader.Activate();
+    emptyVAO.Bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    RenderStats::frame.drawCalls++;
+    glDepthFunc(GL_LESS);
+    emptyVAO.Unbind();
+}
+
+void DeferredRenderer::UI()
+{
+    ImGui::Checkbox("Light volumes", &lightVolumes);
+    ImGui::Text("G-buffer: %d x %d, %.1f MB", size.x, size.y, (float)size.x * size.y * BytesPerPixel() / (1024.0f * 1024.0f));
+}
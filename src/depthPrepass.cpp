@@ -0,0 +1,155 @@
+#include "depthPrepass.h"
+
+namespace
+{
+    // Heat map colors for pixels shaded once, twice... the last one also covers everything above
+    const glm::vec3 heatMap[] = {
+        glm::vec3(0.0f, 0.0f, 0.5f),
+        glm::vec3(0.0f, 0.4f, 1.0f),
+        glm::vec3(0.0f, 0.8f, 0.6f),
+        glm::vec3(0.3f, 0.9f, 0.0f),
+        glm::vec3(1.0f, 0.9f, 0.0f),
+        glm::vec3(1.0f, 0.5f, 0.0f),
+        glm::vec3(1.0f, 0.0f, 0.0f),
+        glm::vec3(1.0f, 1.0f, 1.0f)};
+    const GLint heatMapLevels = sizeof(heatMap) / sizeof(heatMap[0]);
+}
+
+DepthPrepass::DepthPrepass()
+    : depthShader("res/shaders/prepass.vert", "res/shaders/depth.frag"),
+      heatMapShader("res/shaders/deferred.vert", "res/shaders/overdraw.frag")
+{
+    glGenQueries(1, &depthQuery);
+    glGenQueries(1, &shadeQuery);
+    // The first frame measures
+    framesSinceMeasure = probeInterval;
+}
+
+DepthPrepass::~DepthPrepass()
+{
+    glDeleteQueries(1, &depthQuery);
+    glDeleteQueries(1, &shadeQuery);
+    emptyVAO.Delete();
+}
+
+void DepthPrepass::Begin()
+{
+    start = RenderStats::frame;
+    depthDrawCalls = 0;
+    depthTriangles = 0;
+
+    // Read only once the GPU has the results, a frame or two late, so the CPU never waits on them
+    if (pending)
+    {
+        GLuint available = 0;
+        glGetQueryObjectuiv(shadeQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            glGetQueryObjectui64v(depthQuery, GL_QUERY_RESULT, &fragments);
+            glGetQueryObjectui64v(shadeQuery, GL_QUERY_RESULT, &pixels);
+            overdraw = pixels == 0 ? 0.0f : (float)fragments / (float)pixels;
+            pending = false;
+        }
+    }
+    framesSinceMeasure++;
+
+    switch (mode)
+    {
+    case PrepassMode::Off:
+        active = false;
+        break;
+    case PrepassMode::On:
+        active = true;
+        break;
+    case PrepassMode::Auto:
+        active = overdraw > threshold || (!pending && framesSinceMeasure >= probeInterval);
+        break;
+    }
+    measuring = active && !pending;
+    if (!active)
+        return;
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    if (measuring)
+        glBeginQuery(GL_SAMPLES_PASSED, depthQuery);
+}
+
+void DepthPrepass::Shade()
+{
+    if (active)
+    {
+        if (measuring)
+            glEndQuery(GL_SAMPLES_PASSED);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+
+        // The depth pass culled and counted the same meshes, only its draws are its own
+        depthDrawCalls = RenderStats::frame.drawCalls - start.drawCalls;
+        depthTriangles = RenderStats::frame.triangles - start.triangles;
+        RenderStats::frame = start;
+    }
+
+    // Every fragment that passes the depth test adds one to its pixel
+    if (showOverdraw)
+    {
+        glClearStencil(0);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        glEnable(GL_STENCIL_TEST);
+        glStencilMask(0xFF);
+        glStencilFunc(GL_ALWAYS, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+    }
+
+    if (measuring)
+        glBeginQuery(GL_SAMPLES_PASSED, shadeQuery);
+}
+
+void DepthPrepass::End()
+{
+    if (measuring)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        measuring = false;
+        pending = true;
+        framesSinceMeasure = 0;
+    }
+    if (active)
+    {
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+    if (!showOverdraw)
+        return;
+
+    // One fullscreen draw per count, the background (count 0) is left alone
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glDepthFunc(GL_ALWAYS);
+    glDepthMask(GL_FALSE);
+    heatMapShader.Activate();
+    emptyVAO.Bind();
+    for (GLint level = 1; level <= heatMapLevels; level++)
+    {
+        glStencilFunc(level == heatMapLevels ? GL_LEQUAL : GL_EQUAL, level, 0xFF);
+        heatMapShader.SetVec3(heatMapShader.Uniform("color"), heatMap[level - 1]);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    emptyVAO.Unbind();
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glDisable(GL_STENCIL_TEST);
+}
+
+void DepthPrepass::UI()
+{
+    const char *modes[] = {"Off", "On", "Auto"};
+    int current = (int)mode;
+    if (ImGui::Combo("Depth pre-pass", &current, modes, 3))
+        mode = (PrepassMode)current;
+    if (mode == PrepassMode::Auto)
+        ImGui::SliderFloat("Overdraw threshold", &threshold, 1.0f, 4.0f);
+    ImGui::Checkbox("Show overdraw", &showOverdraw);
+    ImGui::Text("Overdraw: %.2fx (%.2f M fragments over %.2f M pixels)", overdraw, fragments / 1e6f, pixels / 1e6f);
+    if (active)
+        ImGui::Text("Pre-pass: %u draw calls, %u triangles", depthDrawCalls, depthTriangles);
+}
@@ -0,0 +1,280 @@
+#include "geometryArena.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Index ranges are kept 4 byte aligned so 32 bit index offsets stay valid
+    size_t alignIndexBytes(size_t bytes)
+    {
+        return (bytes + 3) & ~(size_t)3;
+    }
+
+    // Copies 'bytes' from the start of one buffer to another without touching the VAO bindings
+    void copyBuffer(GLuint source, GLuint destination, size_t bytes)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, source);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void uploadBuffer(GLuint buffer, size_t offset, const void *data, size_t bytes)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+RangeAllocator::RangeAllocator(size_t capacity)
+{
+    Grow(capacity);
+}
+
+size_t RangeAllocator::Allocate(size_t size)
+{
+    if (size == 0)
+        return 0;
+    // Smallest free block that fits
+    auto fit = freeBySize.lower_bound(size);
+    if (fit == freeBySize.end())
+        return INVALID;
+
+    size_t offset = fit->second;
+    size_t blockSize = fit->first;
+    eraseFree(freeByOffset.find(offset));
+    if (blockSize > size)
+        insertFree(offset + size, blockSize - size);
+    used += size;
+    return offset;
+}
+
+void RangeAllocator::Free(size_t offset, size_t size)
+{
+    if (size == 0)
+        return;
+    used -= size;
+
+    // Merge with the free blocks right before and after
+    auto next = freeByOffset.lower_bound(offset);
+    if (next != freeByOffset.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size += previous->second;
+            eraseFree(previous);
+        }
+    }
+    if (next != freeByOffset.end() && offset + size == next->first)
+    {
+        size += next->second;
+        eraseFree(next);
+    }
+    insertFree(offset, size);
+}
+
+void RangeAllocator::Grow(size_t extra)
+{
+    if (extra == 0)
+        return;
+    size_t offset = capacity;
+    capacity += extra;
+    // Free() merges the new space into a free block at the end, if there is one
+    used += extra;
+    Free(offset, extra);
+}
+
+size_t RangeAllocator::LargestFree() const
+{
+    return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+}
+
+float RangeAllocator::Fragmentation() const
+{
+    size_t free = capacity - used;
+    return free == 0 ? 0.0f : 1.0f - (float)LargestFree() / (float)free;
+}
+
+void RangeAllocator::insertFree(size_t offset, size_t size)
+{
+    freeByOffset[offset] = size;
+    freeBySize.emplace(size, offset);
+}
+
+void RangeAllocator::eraseFree(std::map<size_t, size_t>::iterator block)
+{
+    auto range = freeBySize.equal_range(block->second);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == block->first)
+        {
+            freeBySize.erase(it);
+            break;
+        }
+    }
+    freeByOffset.erase(block);
+}
+
+GeometryArena::GeometryArena(const VertexLayout &layout)
+    : layout(layout),
+      vertexBuffer(nullptr, INITIAL_VERTICES * layout.Stride()),
+      positionBuffer(nullptr, INITIAL_VERTICES * layout.PositionStride()),
+      indexBuffer(nullptr, INITIAL_INDEX_BYTES),
+      vertexRanges(INITIAL_VERTICES),
+      indexRanges(INITIAL_INDEX_BYTES)
+{
+    linkBuffers();
+}
+
+GeometryAllocation GeometryArena::Allocate(const std::vector<unsigned char> &vertices, const void *indices, size_t indexBytes)
+{
+    size_t stride = (size_t)layout.Stride();
+    GeometryAllocation allocation;
+    allocation.vertexCount = vertices.size() / stride;
+    allocation.indexBytes = alignIndexBytes(indexBytes);
+
+    size_t vertexOffset = vertexRanges.Allocate(allocation.vertexCount);
+    if (vertexOffset == RangeAllocator::INVALID)
+    {
+        growVertices(allocation.vertexCount);
+        vertexOffset = vertexRanges.Allocate(allocation.vertexCount);
+    }
+    allocation.indexOffset = indexRanges.Allocate(allocation.indexBytes);
+    if (allocation.indexOffset == RangeAllocator::INVALID)
+    {
+        growIndices(allocation.indexBytes);
+        allocation.indexOffset = indexRanges.Allocate(allocation.indexBytes);
+    }
+    allocation.baseVertex = (GLint)vertexOffset;
+    static uint64_t nextID = 1;
+    allocation.id = nextID++;
+
+    uploadBuffer(vertexBuffer.ID, vertexOffset * stride, vertices.data(), vertices.size());
+
+    // Positions lead every packed vertex
+    size_t positionStride = (size_t)layout.PositionStride();
+    std::vector<unsigned char> positions(allocation.vertexCount * positionStride);
+    for (size_t i = 0; i < allocation.vertexCount; i++)
+        std::copy_n(&vertices[i * stride], positionStride, &positions[i * positionStride]);
+    uploadBuffer(positionBuffer.ID, vertexOffset * positionStride, positions.data(), positions.size());
+    uploadBuffer(indexBuffer.ID, allocation.indexOffset, indices, indexBytes);
+    return allocation;
+}
+
+void GeometryArena::Free(const GeometryAllocation &allocation)
+{
+    vertexRanges.Free((size_t)allocation.baseVertex, allocation.vertexCount);
+    indexRanges.Free(allocation.indexOffset, allocation.indexBytes);
+    for (const auto &listener : freeListeners())
+        listener.second(allocation.id);
+}
+
+void GeometryArena::growVertices(size_t needed)
+{
+    size_t stride = (size_t)layout.Stride();
+    size_t capacity = vertexRanges.Capacity();
+    size_t grown = std::max(capacity * 2, capacity + needed);
+
+    VBO buffer(nullptr, grown * stride);
+    copyBuffer(vertexBuffer.ID, buffer.ID, capacity * stride);
+    vertexBuffer.Delete();
+    vertexBuffer = buffer;
+
+    size_t positionStride = (size_t)layout.PositionStride();
+    VBO positions(nullptr, grown * positionStride);
+    copyBuffer(positionBuffer.ID, positions.ID, capacity * positionStride);
+    positionBuffer.Delete();
+    positionBuffer = positions;
+    vertexRanges.Grow(grown - capacity);
+    linkBuffers();
+}
+
+void GeometryArena::growIndices(size_t needed)
+{
+    size_t capacity = indexRanges.Capacity();
+    size_t grown = std::max(capacity * 2, capacity + needed);
+
+    // Created with no VAO bound, so the old buffer stays attached to ours until linkBuffers
+    glBindVertexArray(0);
+    EBO buffer(nullptr, grown);
+    copyBuffer(indexBuffer.ID, buffer.ID, capacity);
+    indexBuffer.Delete();
+    indexBuffer = buffer;
+    indexRanges.Grow(grown - capacity);
+    linkBuffers();
+}
+
+void GeometryArena::linkBuffers()
+{
+    vao.Bind();
+    for (const VertexAttribute &attribute : layout.Attributes())
+        vao.LinkAttrib(vertexBuffer, attribute.location, attribute.components, attribute.type, layout.Stride(), (void *)attribute.offset, attribute.normalized);
+    indexBuffer.Bind();
+    vao.Unbind();
+
+    VertexAttribute position = layout.Attributes()[0];
+    positionVAO.Bind();
+    positionVAO.LinkAttrib(positionBuffer, position.location, position.components, position.type, layout.PositionStride(), (void *)0, position.normalized);
+    indexBuffer.Bind();
+    positionVAO.Unbind();
+    vertexBuffer.Unbind();
+    // Same as EBO::Unbind, after the VAO so it keeps its element buffer
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+GeometryArena &GeometryArena::For(const VertexLayout &layout)
+{
+    for (const std::unique_ptr<GeometryArena> &arena : arenas())
+        if (arena->layout == layout)
+            return *arena;
+    // Nothing may be bound while the arena creates its buffers, see growIndices
+    glBindVertexArray(0);
+    arenas().push_back(std::make_unique<GeometryArena>(layout));
+    return *arenas().back();
+}
+
+void GeometryArena::UI()
+{
+    for (const std::unique_ptr<GeometryArena> &arena : arenas())
+    {
+        const RangeAllocator &vertices = arena->vertexRanges;
+        const RangeAllocator &indices = arena->indexRanges;
+        // The position-only copy is counted with the vertices
+        size_t stride = (size_t)(arena->layout.Stride() + arena->layout.PositionStride());
+        ImGui::Text("Geometry arena (%d + %d B vertices): %.1f / %.1f MB vertices, %.1f / %.1f MB indices",
+                    arena->layout.Stride(), arena->layout.PositionStride(),
+                    vertices.Used() * stride / (1024.0f * 1024.0f), vertices.Capacity() * stride / (1024.0f * 1024.0f),
+                    indices.Used() / (1024.0f * 1024.0f), indices.Capacity() / (1024.0f * 1024.0f));
+        ImGui::Text("  fragmentation %.0f%% / %.0f%% (%zu / %zu free blocks)",
+                    vertices.Fragmentation() * 100.0f, indices.Fragmentation() * 100.0f, vertices.FreeBlocks(), indices.FreeBlocks());
+    }
+}
+
+std::vector<std::unique_ptr<GeometryArena>> &GeometryArena::arenas()
+{
+    static std::vector<std::unique_ptr<GeometryArena>> list;
+    return list;
+}
+
+void GeometryArena::AddFreeListener(const void *owner, std::function<void(uint64_t)> listener)
+{
+    freeListeners().emplace_back(owner, std::move(listener));
+}
+
+void GeometryArena::RemoveFreeListener(const void *owner)
+{
+    std::vector<std::pair<const void *, std::function<void(uint64_t)>>> &list = freeListeners();
+    list.erase(std::remove_if(list.begin(), list.end(), [owner](const std::pair<const void *, std::function<void(uint64_t)>> &listener)
+                              { return listener.first == owner; }),
+               list.end());
+}
+
+std::vector<std::pair<const void *, std::function<void(uint64_t)>>> &GeometryArena::freeListeners()
+{
+    static std::vector<std::pair<const void *, std::function<void(uint64_t)>>> list;
+    return list;
+}
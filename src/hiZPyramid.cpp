@@ -0,0 +1,105 @@
+#include "hiZPyramid.h"
+
+#include <algorithm>
+
+HiZPyramid::HiZPyramid()
+{
+#ifdef GL_VERSION_4_3
+    if (GLAD_GL_VERSION_4_3)
+        program = std::make_unique<Shader>("res/shaders/hiz.comp");
+#endif
+}
+
+HiZPyramid::~HiZPyramid()
+{
+    glDeleteTextures(1, &depthCopy);
+    glDeleteTextures(1, &pyramid);
+}
+
+void HiZPyramid::resize(glm::ivec2 newSize)
+{
+#ifdef GL_VERSION_4_3
+    glDeleteTextures(1, &depthCopy);
+    glDeleteTextures(1, &pyramid);
+    size = newSize;
+    levels = 1;
+    while ((std::max(size.x, size.y) >> levels) > 0)
+        levels++;
+
+    // Immutable storage, image units can only bind those
+    glGenTextures(1, &depthCopy);
+    glBindTexture(GL_TEXTURE_2D, depthCopy);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, size.x, size.y);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &pyramid);
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, size.x, size.y);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+#endif
+}
+
+void HiZPyramid::Build()
+{
+#ifdef GL_VERSION_4_3
+    if (!Available())
+        return;
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (viewport[2] <= 0 || viewport[3] <= 0)
+        return;
+    if (glm::ivec2(viewport[2], viewport[3]) != size)
+        resize(glm::ivec2(viewport[2], viewport[3]));
+
+    glActiveTexture(GL_TEXTURE0 + HI_Z_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, depthCopy);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], size.x, size.y);
+
+    program->Activate();
+    program->SetInt(program->Uniform("depth"), HI_Z_TEXTURE_UNIT);
+    GLint levelLocation = program->Uniform("level");
+    GLint sourceSizeLocation = program->Uniform("sourceSize");
+    glm::ivec2 sourceSize = size;
+    glm::ivec2 levelSize = size;
+    for (int level = 0; level < levels; level++)
+    {
+        if (level > 0)
+        {
+            sourceSize = levelSize;
+            levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+        }
+        glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        if (level > 0)
+            glBindImageTexture(1, pyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        program->SetInt(levelLocation, level);
+        glUniform2i(sourceSizeLocation, sourceSize.x, sourceSize.y);
+        glDispatchCompute((GLuint)(levelSize.x + 7) / 8, (GLuint)(levelSize.y + 7) / 8, 1);
+        // The next level reads this one
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+#endif
+}
+
+void HiZPyramid::Bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + HI_Z_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void HiZPyramid::Bind(Shader &program) const
+{
+    program.SetInt(program.Uniform("hiZ"), HI_Z_TEXTURE_UNIT);
+    glUniform2f(program.Uniform("hiZSize"), (float)size.x, (float)size.y);
+    program.SetInt(program.Uniform("hiZMaxLevel"), MaxLevel());
+    Bind();
+}
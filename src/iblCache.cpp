@@ -0,0 +1,244 @@
+#include "iblCache.h"
+#include "mappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+    const char IBL_CACHE_MAGIC[4] = {'I', 'B', 'L', 'C'};
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t textureCount;
+        uint32_t reserved;
+    };
+
+    struct TextureHeader
+    {
+        uint32_t cubemap;
+        uint32_t internalFormat;
+        uint32_t format;
+        uint32_t size;
+        uint32_t levels;
+        uint32_t reserved;
+    };
+
+    size_t levelBytes(const CachedTexture &texture, GLint level)
+    {
+        size_t components = texture.format == GL_RG ? 2 : 3;
+        size_t side = std::max(1, texture.size >> level);
+        return side * side * components * 2;
+    }
+
+    // Face targets of a cubemap, or the texture's own target
+    std::vector<GLenum> faces(const CachedTexture &texture)
+    {
+        if (texture.target != GL_TEXTURE_CUBE_MAP)
+            return {texture.target};
+        std::vector<GLenum> result;
+        for (GLenum i = 0; i < 6; i++)
+            result.push_back(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+        return result;
+    }
+}
+
+uint64_t IBLCache::Hash(const void *data, size_t size, uint64_t hash)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t IBLCache::HashFile(const std::string &path)
+{
+    try
+    {
+        MappedFile file(path);
+        return Hash(file.Data(), file.Size());
+    }
+    catch (const std::runtime_error &)
+    {
+        return 0;
+    }
+}
+
+uint64_t IBLCache::EnvironmentKey(const std::string &hdrPath)
+{
+    const uint32_t parameters[] = {IBL_CACHE_VERSION, IBL_ENVIRONMENT_SIZE, IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS};
+    return Hash(parameters, sizeof(parameters), HashFile(hdrPath));
+}
+
+std::string IBLCache::EnvironmentFile(uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "ibl_%016llx.cache", (unsigned long long)key);
+    return name;
+}
+
+size_t IBLCache::TextureBytes(const CachedTexture &texture)
+{
+    size_t bytes = 0;
+    for (GLint level = 0; level < texture.levels; level++)
+        bytes += levelBytes(texture, level) * faces(texture).size();
+    return bytes;
+}
+
+bool IBLCache::Write(const std::string &path, uint64_t key, const std::vector<CachedTexture> &textures)
+{
+    // Read everything back first, then hand it to the GL free writer
+    std::vector<std::vector<unsigned char>> storage(textures.size());
+    std::vector<const void *> pixels;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        const CachedTexture &texture = textures[i];
+        storage[i].resize(TextureBytes(texture));
+        unsigned char *cursor = storage[i].data();
+
+        glBindTexture(texture.target, texture.ID);
+        for (GLint level = 0; level < texture.levels; level++)
+        {
+            for (GLenum face : faces(texture))
+            {
+                glGetTexImage(face, level, texture.format, GL_HALF_FLOAT, cursor);
+                cursor += levelBytes(texture, level);
+            }
+        }
+        glBindTexture(texture.target, 0);
+        pixels.push_back(storage[i].data());
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    return WritePixels(path, key, textures, pixels);
+}
+
+bool IBLCache::WritePixels(const std::string &path, uint64_t key, const std::vector<CachedTexture> &textures, const std::vector<const void *> &pixels)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open())
+    {
+        std::cerr << "Unable to write IBL cache " << path << std::endl;
+        return false;
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, IBL_CACHE_MAGIC, sizeof(header.magic));
+    header.version = IBL_CACHE_VERSION;
+    header.key = key;
+    header.textureCount = (uint32_t)textures.size();
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        const CachedTexture &texture = textures[i];
+        TextureHeader info = {};
+        info.cubemap = texture.target == GL_TEXTURE_CUBE_MAP;
+        info.internalFormat = texture.internalFormat;
+        info.format = texture.format;
+        info.size = texture.size;
+        info.levels = texture.levels;
+        out.write(reinterpret_cast<const char *>(&info), sizeof(info));
+        out.write(static_cast<const char *>(pixels[i]), TextureBytes(texture));
+    }
+
+    return out.good();
+}
+
+bool IBLCache::Read(const std::string &path, uint64_t key, std::vector<CachedTexture> &textures)
+{
+    MappedFile file;
+    try
+    {
+        file = MappedFile(path);
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+
+    uint64_t storedKey;
+    std::vector<CachedTexture> found;
+    std::vector<const unsigned char *> pixels;
+    if (!Parse(file.Data(), file.Size(), storedKey, found, pixels) || storedKey != key)
+        return false;
+
+    // Upload straight out of the mapping
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < found.size(); i++)
+    {
+        CachedTexture &texture = found[i];
+        const unsigned char *data = pixels[i];
+        glGenTextures(1, &texture.ID);
+        glBindTexture(texture.target, texture.ID);
+        glTexParameteri(texture.target, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+        for (GLint level = 0; level < texture.levels; level++)
+        {
+            GLsizei side = std::max(1, texture.size >> level);
+            for (GLenum face : faces(texture))
+            {
+                glTexImage2D(face, level, texture.internalFormat, side, side, 0, texture.format, GL_HALF_FLOAT, data);
+                data += levelBytes(texture, level);
+            }
+        }
+        glBindTexture(texture.target, 0);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    textures = found;
+    return true;
+}
+
+bool IBLCache::Parse(const unsigned char *data, size_t size, uint64_t &key, std::vector<CachedTexture> &textures, std::vector<const unsigned char *> &pixels)
+{
+    // Validate the whole layout before anything is created, so a truncated file is just a miss
+    const unsigned char *cursor = data;
+    const unsigned char *end = data + size;
+    FileHeader header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, cursor, sizeof(header));
+    cursor += sizeof(header);
+    if (std::memcmp(header.magic, IBL_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != IBL_CACHE_VERSION)
+        return false;
+
+    textures.clear();
+    pixels.clear();
+    for (uint32_t i = 0; i < header.textureCount; i++)
+    {
+        TextureHeader info;
+        if ((size_t)(end - cursor) < sizeof(info))
+            return false;
+        std::memcpy(&info, cursor, sizeof(info));
+        cursor += sizeof(info);
+
+        CachedTexture texture;
+        texture.target = info.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+        texture.internalFormat = info.internalFormat;
+        texture.format = info.format;
+        texture.size = info.size;
+        texture.levels = info.levels;
+
+        size_t bytes = TextureBytes(texture);
+        if ((size_t)(end - cursor) < bytes)
+            return false;
+
+        textures.push_back(texture);
+        pixels.push_back(cursor);
+        cursor += bytes;
+    }
+
+    key = header.key;
+    return true;
+}
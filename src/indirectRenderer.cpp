@@ -0,0 +1,485 @@
+#include "indirectRenderer.h"
+#include "model.h"
+
+#include <algorithm>
+#include <numeric>
+
+IndirectRenderer::IndirectRenderer()
+{
+    GeometryArena::AddFreeListener(this, [this](uint64_t id)
+                                   { forgetMesh(id); });
+
+    // Neutral block, pbr.frag multiplies it with the per object material
+    MaterialBlock block{};
+    block.albedo = glm::vec3(1.0f);
+    block.roughness = 1.0f;
+    block.metallic = 1.0f;
+    block.ao = 1.0f;
+    neutralMaterial.Update(&block, sizeof(block));
+
+    if (!Supported())
+        return;
+    drawProgram = std::make_unique<Shader>("res/shaders/indirect.vert", "res/shaders/pbr.frag");
+    geometryProgram = std::make_unique<Shader>("res/shaders/indirect.vert", "res/shaders/gbuffer.frag");
+    depthProgram = std::make_unique<Shader>("res/shaders/indirect_prepass.vert", "res/shaders/depth.frag");
+    cullProgram = std::make_unique<Shader>("res/shaders/cull.comp");
+    computeAvailable = cullProgram->Linked();
+    if (!computeAvailable)
+        std::cout << "Indirect renderer: no compute culling, commands are built on the CPU" << std::endl;
+
+    glGenBuffers(1, &objectBuffer);
+    glGenBuffers(1, &meshBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &drawIDBuffer);
+    glGenBuffers(1, &visibilityBuffer);
+    glGenBuffers(STATS_BUFFERS, statsBuffers);
+    if (computeAvailable)
+        hiZ = std::make_unique<HiZPyramid>();
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+    GeometryArena::RemoveFreeListener(this);
+}
+
+bool IndirectRenderer::Supported()
+{
+#ifdef GL_VERSION_4_3
+    return GLAD_GL_VERSION_4_3;
+#else
+    return false;
+#endif
+}
+
+void IndirectRenderer::Submit(Mesh &mesh, const glm::mat4 &model, const Material &material, bool levelOfDetail)
+{
+    Submission submission;
+    submission.mesh = &mesh;
+    submission.object.model = model;
+    submission.object.albedoRoughness = glm::vec4(material.albedo, material.roughness);
+    submission.object.metallicAoLod = glm::vec4(material.metallic, material.ao, levelOfDetail ? 1.0f : 0.0f, 0.0f);
+    submission.object.mesh = meshIndex(mesh);
+    submissions.push_back(submission);
+}
+
+GLuint IndirectRenderer::meshIndex(const Mesh &mesh)
+{
+    auto found = meshIndices.find(mesh.geometry.id);
+    if (found != meshIndices.end())
+    {
+        // Copies of a Mesh share its allocation, point at the one submitted last
+        meshList[found->second] = &mesh;
+        return found->second;
+    }
+
+    IndirectMeshBlock block = {};
+    block.boundsMin = glm::vec4(mesh.bounds.min, 0.0f);
+    block.boundsMax = glm::vec4(mesh.bounds.max, 0.0f);
+    block.positionScale = glm::vec4(mesh.positionScale, 0.0f);
+    block.positionOffset = glm::vec4(mesh.positionOffset, 0.0f);
+    // Commands count in indices from the start of the arena's index buffer
+    size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    GLuint base = (GLuint)(mesh.geometry.indexOffset / indexSize);
+    block.lodCount = (GLuint)std::min(mesh.lods.size(), (size_t)MAX_MESH_LODS);
+    for (GLuint lod = 0; lod < block.lodCount; lod++)
+    {
+        block.firstIndex[lod] = base + mesh.lods[lod].firstIndex;
+        block.count[lod] = (GLuint)mesh.lods[lod].count;
+        block.error[lod] = mesh.lods[lod].error;
+    }
+    block.baseVertex = mesh.geometry.baseVertex;
+
+    GLuint index;
+    if (!freeMeshSlots.empty())
+    {
+        index = freeMeshSlots.back();
+        freeMeshSlots.pop_back();
+        meshBlocks[index] = block;
+        meshList[index] = &mesh;
+    }
+    else
+    {
+        index = (GLuint)meshBlocks.size();
+        meshBlocks.push_back(block);
+        meshList.push_back(&mesh);
+    }
+    meshIndices[mesh.geometry.id] = index;
+    meshesDirty = true;
+    return index;
+}
+
+void IndirectRenderer::forgetMesh(uint64_t id)
+{
+    auto found = meshIndices.find(id);
+    if (found == meshIndices.end())
+        return;
+    // The block stays in the buffer until the slot is reused, nothing submitted points at it any more
+    meshList[found->second] = nullptr;
+    freeMeshSlots.push_back(found->second);
+    meshIndices.erase(found);
+}
+
+void IndirectRenderer::buildBatches()
+{
+    // Group by VAO and index type, every group becomes one multi-draw
+    std::stable_sort(submissions.begin(), submissions.end(), [](const Submission &a, const Submission &b)
+                     {
+                         if (a.mesh->arena != b.mesh->arena)
+                             return std::less<GeometryArena *>()(a.mesh->arena, b.mesh->arena);
+                         return a.mesh->indexType < b.mesh->indexType; });
+
+    objects.clear();
+    batches.clear();
+    for (const Submission &submission : submissions)
+    {
+        if (batches.empty() || batches.back().arena != submission.mesh->arena || batches.back().indexType != submission.mesh->indexType)
+            batches.push_back({submission.mesh->arena, submission.mesh->indexType, objects.size(), 0});
+        batches.back().count++;
+        objects.push_back(submission.object);
+    }
+}
+
+void IndirectRenderer::Flush(Camera &camera, bool depthOnly)
+{
+    buildBatches();
+    submissions.clear();
+    lastObjects = objects.size();
+    lastBatches = batches.size();
+    if (!Supported())
+        return;
+
+#ifdef GL_VERSION_4_3
+    // Shading pass after a depth pre-pass of the same objects: the commands in the buffer are still valid
+    if (!depthOnly && prepassPhases != 0 && objects.size() == prepassObjects)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_OBJECT_BINDING, objectBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_MESH_BINDING, meshBuffer);
+        for (GLuint phase = 0; phase < prepassPhases; phase++)
+            draw(camera, phase, shadingProgram());
+        prepassPhases = 0;
+        // DepthPrepass::Shade dropped what the depth flush counted, these draws are the same objects
+        addStats(lastStats);
+        return;
+    }
+    prepassPhases = 0;
+    Shader &program = depthOnly ? *depthProgram : shadingProgram();
+
+    lastStats = {};
+    readStats();
+    if (objects.empty())
+        return;
+    if (meshesDirty)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, meshBlocks.size() * sizeof(IndirectMeshBlock), meshBlocks.data(), GL_STATIC_DRAW);
+        meshesDirty = false;
+    }
+    // Orphaned every frame, the previous frame's draws may still be reading the old storage
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(IndirectObjectBlock), objects.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_OBJECT_BINDING, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_MESH_BINDING, meshBuffer);
+
+    if (objects.size() > drawIDCapacity)
+    {
+        drawIDCapacity = std::max(objects.size(), drawIDCapacity * 2);
+        std::vector<GLuint> drawIDs(drawIDCapacity);
+        std::iota(drawIDs.begin(), drawIDs.end(), 0u);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+        glBufferData(GL_ARRAY_BUFFER, drawIDs.size() * sizeof(GLuint), drawIDs.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    if (computeCulling && computeAvailable)
+    {
+        bool occlusion = occlusionCulling && hiZ->Available();
+        if (objects.size() != visibilityObjects)
+        {
+            // Everything counts as visible last frame, the first phase 1 sorts it out
+            std::vector<GLuint> visible(objects.size(), 1u);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibilityBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, visible.size() * sizeof(GLuint), visible.data(), GL_DYNAMIC_COPY);
+            visibilityObjects = objects.size();
+        }
+        // A buffer still in flight after a full ring is given up on rather than waited for
+        GLuint statsBuffer = statsBuffers[statsSlot];
+        if (statsFences[statsSlot])
+        {
+            glDeleteSync(statsFences[statsSlot]);
+            statsFences[statsSlot] = nullptr;
+        }
+        IndirectCullStats zero = {};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), &zero, GL_STREAM_READ);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * objects.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_COMMAND_BINDING, commandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_VISIBILITY_BINDING, visibilityBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_STATS_BINDING, statsBuffer);
+
+        if (verify)
+        {
+            // The CPU build starts from the same history as the compute pass
+            std::vector<GLuint> history(objects.size());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibilityBuffer);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, history.size() * sizeof(GLuint), history.data());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            cpuVisibility.assign(history.begin(), history.end());
+            cullOnCPU(camera, occlusion, false);
+        }
+
+        cullOnGPU(camera, 0, occlusion);
+        if (verify)
+            verifyPhase(camera, 0);
+        draw(camera, 0, program);
+
+        if (occlusion)
+        {
+            hiZ->Build();
+            cullOnGPU(camera, 1, true);
+            if (verify)
+                verifyPhase(camera, 1);
+            draw(camera, 1, program);
+        }
+        statsFences[statsSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        statsSlot = (statsSlot + 1) % STATS_BUFFERS;
+        lastStats = gpuStats;
+        addStats(lastStats);
+        if (depthOnly)
+            prepassPhases = occlusion ? 2 : 1;
+    }
+    else
+    {
+        cullOnCPU(camera, occlusionCulling, true);
+        addStats(lastStats);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        draw(camera, 0, program);
+        if (occlusionCulling)
+            draw(camera, 1, program);
+        if (depthOnly)
+            prepassPhases = occlusionCulling ? 2 : 1;
+    }
+    prepassObjects = objects.size();
+#endif
+}
+
+void IndirectRenderer::readStats()
+{
+#ifdef GL_VERSION_4_3
+    // The slot written next is the oldest, culls finish in order so the first unfinished one ends the scan
+    for (int i = 0; i < STATS_BUFFERS; i++)
+    {
+        int slot = (statsSlot + i) % STATS_BUFFERS;
+        if (!statsFences[slot])
+            continue;
+        GLenum status = glClientWaitSync(statsFences[slot], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(statsFences[slot]);
+        statsFences[slot] = nullptr;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffers[slot]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(gpuStats), &gpuStats);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+#endif
+}
+
+void IndirectRenderer::verifyPhase(const Camera &camera, GLuint phase)
+{
+#ifdef GL_VERSION_4_3
+    size_t count = objects.size();
+    std::vector<DrawElementsIndirectCommand> written(count);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, phase * count * sizeof(DrawElementsIndirectCommand), count * sizeof(DrawElementsIndirectCommand), written.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    Frustum frustum = Frustum::FromMatrix(camera.cameraMatrix);
+    for (size_t i = 0; i < count; i++)
+    {
+        const DrawElementsIndirectCommand &a = written[i];
+        const DrawElementsIndirectCommand &b = commands[phase * count + i];
+        bool same = a.count == b.count && a.firstIndex == b.firstIndex && a.baseVertex == b.baseVertex && a.baseInstance == b.baseInstance;
+        if (phase == 0)
+            same = same && a.instanceCount == b.instanceCount;
+        else if (a.instanceCount != 0)
+            same = same && commands[i].instanceCount == 0 && frustum.Intersects(meshList[objects[i].mesh]->bounds.Transform(objects[i].model));
+        if (!same)
+            mismatches++;
+    }
+#endif
+}
+
+void IndirectRenderer::addStats(const IndirectCullStats &stats)
+{
+    RenderStats::frame.meshesDrawn += stats.drawn;
+    RenderStats::frame.meshesCulled += stats.frustumCulled;
+    RenderStats::frame.meshesOccluded += stats.occluded;
+    RenderStats::frame.instances += stats.drawn;
+    RenderStats::frame.triangles += stats.triangles;
+    for (unsigned int lod = 0; lod < MAX_MESH_LODS; lod++)
+        RenderStats::frame.lodDraws[lod] += stats.lodDraws[lod];
+}
+
+void IndirectRenderer::cullOnCPU(const Camera &camera, bool occlusion, bool countStats)
+{
+    Frustum frustum = Frustum::FromMatrix(camera.cameraMatrix);
+    float pixelsPerUnit = camera.projection[1][1] * camera.height * 0.5f;
+
+    size_t count = objects.size();
+    commands.resize(2 * count);
+    if (cpuVisibility.size() != count)
+        cpuVisibility.assign(count, 1);
+    if (occlusion)
+        occlusionBuffer.Clear();
+    // Frustum result and level of detail per object, for phase 1
+    std::vector<unsigned char> inFrustum(count), lods(count);
+
+    if (countStats)
+        lastStats = {};
+    auto countDraw = [&](unsigned int lod, const IndirectMeshBlock &block)
+    {
+        lastStats.drawn++;
+        lastStats.triangles += block.count[lod] / 3;
+        lastStats.lodDraws[lod]++;
+    };
+
+    // Phase 0: what was visible last frame, which also becomes the occluders
+    for (size_t i = 0; i < count; i++)
+    {
+        const IndirectObjectBlock &object = objects[i];
+        const Mesh &mesh = *meshList[object.mesh];
+        const IndirectMeshBlock &block = meshBlocks[object.mesh];
+
+        AABB box = mesh.bounds.Transform(object.model);
+        bool visible = frustum.Intersects(box);
+
+        // Same selection as Model::selectLOD
+        unsigned int lod = 0;
+        if (object.metallicAoLod.z != 0.0f && Model::lodPixelError > 0.0f && block.lodCount > 1)
+        {
+            float distance = glm::length(box.Center() - camera.Position) - glm::length(box.Extents());
+            if (distance > 0.0f)
+            {
+                const glm::mat4 &world = object.model;
+                float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+                lod = std::min(mesh.SelectLOD(Model::lodPixelError / (pixelsPerUnit / distance * scale)), block.lodCount - 1);
+            }
+        }
+
+        bool draw = visible && (cpuVisibility[i] || !occlusion);
+        commands[i] = {block.count[lod], draw ? 1u : 0u, block.firstIndex[lod], block.baseVertex, (GLuint)i};
+        // Phase 1 keeps instanceCount 0 for whatever it doesn't draw
+        commands[count + i] = {block.count[lod], 0u, block.firstIndex[lod], block.baseVertex, (GLuint)i};
+        inFrustum[i] = visible;
+        lods[i] = (unsigned char)lod;
+
+        if (draw && occlusion)
+            occlusionBuffer.Rasterize(mesh.vertices, mesh.indices, (GLuint)mesh.lods[lod].firstIndex, mesh.lods[lod].count, camera.cameraMatrix * object.model);
+
+        if (!countStats)
+            continue;
+        if (draw)
+            countDraw(lod, block);
+        else if (!visible)
+            lastStats.frustumCulled++;
+    }
+    if (!occlusion)
+        return;
+
+    // Phase 1: everything in the frustum against the phase 0 depth
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!inFrustum[i])
+        {
+            cpuVisibility[i] = 0;
+            continue;
+        }
+        const IndirectObjectBlock &object = objects[i];
+        const Mesh &mesh = *meshList[object.mesh];
+        bool wasVisible = cpuVisibility[i] != 0;
+        bool visibleNow = occlusionBuffer.Visible(mesh.bounds.Transform(object.model), camera.cameraMatrix);
+        commands[count + i].instanceCount = visibleNow && !wasVisible ? 1u : 0u;
+        cpuVisibility[i] = visibleNow;
+
+        if (!countStats || wasVisible)
+            continue;
+        if (visibleNow)
+            countDraw(lods[i], meshBlocks[object.mesh]);
+        else
+            lastStats.occluded++;
+    }
+}
+
+void IndirectRenderer::cullOnGPU(const Camera &camera, GLuint phase, bool occlusion)
+{
+#ifdef GL_VERSION_4_3
+    Frustum frustum = Frustum::FromMatrix(camera.cameraMatrix);
+
+    cullProgram->Activate();
+    glUniform1ui(cullProgram->Uniform("objectCount"), (GLuint)objects.size());
+    glUniform4fv(cullProgram->Uniform("frustumPlanes"), 6, &frustum.planes[0][0]);
+    cullProgram->SetVec3(cullProgram->Uniform("cameraPosition"), camera.Position);
+    cullProgram->SetFloat(cullProgram->Uniform("pixelsPerUnit"), camera.projection[1][1] * camera.height * 0.5f);
+    cullProgram->SetFloat(cullProgram->Uniform("lodPixelError"), Model::lodPixelError);
+    glUniform1ui(cullProgram->Uniform("phase"), phase);
+    cullProgram->SetInt(cullProgram->Uniform("occlusionCulling"), occlusion ? 1 : 0);
+    cullProgram->SetMat4(cullProgram->Uniform("viewProjection"), camera.cameraMatrix);
+    if (phase == 1)
+        hiZ->Bind(*cullProgram);
+
+    glDispatchCompute((GLuint)((objects.size() + 63) / 64), 1, 1);
+    // The draws read the commands as indirect arguments and the objects through storage buffers
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+#endif
+}
+
+void IndirectRenderer::draw(Camera &camera, GLuint phase, Shader &program)
+{
+#ifdef GL_VERSION_4_3
+    program.Activate();
+    program.SetVec3(program.uniforms.camPos, camera.Position);
+    program.SetInt(program.uniforms.textured, 0);
+    camera.Matrix(program);
+    neutralMaterial.BindBase(MATERIAL_DATA_BINDING);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    for (const Batch &batch : batches)
+    {
+        batch.arena->VertexArray(program.PositionOnly()).Bind();
+        // Attached for these draws only, like the instance arrays of Mesh::DrawInstanced
+        glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+        glVertexAttribIPointer(DRAW_ID_ATTRIB_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)0);
+        glEnableVertexAttribArray(DRAW_ID_ATTRIB_LOCATION);
+        glVertexAttribDivisor(DRAW_ID_ATTRIB_LOCATION, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        size_t first = phase * objects.size() + batch.first;
+        glMultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType, (void *)(first * sizeof(DrawElementsIndirectCommand)), (GLsizei)batch.count, 0);
+
+        glVertexAttribDivisor(DRAW_ID_ATTRIB_LOCATION, 0);
+        glDisableVertexAttribArray(DRAW_ID_ATTRIB_LOCATION);
+        RenderStats::frame.drawCalls++;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#endif
+}
+
+void IndirectRenderer::UI()
+{
+    bool gpu = computeCulling && computeAvailable;
+    if (computeAvailable)
+        ImGui::Checkbox("GPU culling", &computeCulling);
+    ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+    ImGui::Text("Indirect: %zu objects in %zu multi-draws (%s culling)", lastObjects, lastBatches, gpu ? "GPU" : "CPU");
+    if (occlusionCulling && gpu && hiZ->Available())
+        ImGui::Text("Occlusion: Hi-Z %d x %d, %d levels", hiZ->Size().x, hiZ->Size().y, hiZ->MaxLevel() + 1);
+    else if (occlusionCulling)
+        ImGui::Text("Occlusion: software %d x %d, %zu occluder triangles", occlusionBuffer.Width(), occlusionBuffer.Height(), occlusionBuffer.TrianglesRasterized());
+    if (verify)
+        ImGui::Text("GPU / CPU command mismatches: %zu", mismatches);
+}
@@ -0,0 +1,66 @@
+#include "instancedModel.h"
+
+void InstancedModel::Add(const Instance &instance)
+{
+    instances.push_back(instance);
+    dirty = true;
+}
+
+void InstancedModel::Draw(Shader &shader, Camera &camera)
+{
+    if (!display || instances.empty())
+        return;
+
+    glm::mat4 groupMatrix = glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+    if (dirty || groupMatrix != uploadedGroupMatrix)
+        upload(groupMatrix);
+
+    bool textured = texFolder == "" ? false : true;
+    bindMaterial();
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        meshes[i].DrawInstanced(shader, camera, instanceVBOs[i], (GLsizei)instances.size(), textured);
+    }
+}
+
+void InstancedModel::upload(const glm::mat4 &groupMatrix)
+{
+    if (instanceVBOs.size() != meshes.size())
+    {
+        instanceVBOs.resize(meshes.size());
+        glGenBuffers((GLsizei)instanceVBOs.size(), instanceVBOs.data());
+        capacity = 0;
+    }
+
+    std::vector<glm::mat4> instanceMatrices(instances.size());
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const Instance &instance = instances[i];
+        instanceMatrices[i] = groupMatrix * glm::translate(glm::mat4(1.0f), instance.translation) * glm::mat4_cast(instance.rotation) * glm::scale(glm::mat4(1.0f), instance.scale);
+    }
+
+    std::vector<InstanceData> data(instances.size());
+    for (unsigned int mesh = 0; mesh < meshes.size(); mesh++)
+    {
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            const Material &material = instances[i].material;
+            // Node transform first, like Model::Draw, so both paths place the meshes the same way
+            data[i].model = matricesMeshes[mesh] * instanceMatrices[i];
+            data[i].albedoRoughness = glm::vec4(material.albedo, material.roughness);
+            data[i].metallicAo = glm::vec4(material.metallic, material.ao, 0.0f, 0.0f);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBOs[mesh]);
+        // Grow geometrically, otherwise overwrite in place
+        if (instances.size() > capacity)
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * 2 * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, data.size() * sizeof(InstanceData), data.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (instances.size() > capacity)
+        capacity = instances.size() * 2;
+    uploadedGroupMatrix = groupMatrix;
+    dirty = false;
+}
@@ -1,25 +1,68 @@
 #include "light.h"
+#include "UBO.h"
 
-void Light::Draw(Shader &objectShader, Shader &lightShader, Camera &camera, bool onlySetShader)
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+void Light::UpdateFrameData(Camera &camera)
 {
-    if (!onlySetShader)
-        Model::Draw(objectShader, camera); // Draw the model as usual
+    static FrameBlock frame;
+    static UBO frameUBO(sizeof(FrameBlock));
+    static std::vector<PointLightBlock> pointLights;
 
-    lightShader.Activate();
-    glUniform1f(glGetUniformLocation(lightShader.ID, "pointLightCount"), pointLightCount);
+    frame.camMatrix = camera.cameraMatrix;
+    frame.viewPos = camera.Position;
 
-    if (type == "Directional")
-    {
-        Light::Directional(lightShader);
-    }
-    else if (type == "Point")
-    {
-        Light::Point(lightShader, lightNum);
-    }
-    else
+    pointLights.clear();
+    for (Light *light : lights)
     {
-        Light::Spot(lightShader);
+        if (light->type == "Directional")
+            light->Directional(frame);
+        else if (light->type == "Point")
+        {
+            // Hidden point lights are switched off
+            if (light->display)
+                light->Point(pointLights);
+        }
+        else
+            light->Spot(frame);
     }
+    frame.pointLightCount = (int)pointLights.size();
+
+    clusters.Build(camera, pointLights, frame);
+    frameUBO.Update(&frame, sizeof(FrameBlock));
+    frameUBO.BindBase(FRAME_DATA_BINDING);
+    clusters.Bind();
+}
+
+Light::~Light()
+{
+    lights.erase(std::remove(lights.begin(), lights.end(), this), lights.end());
+}
+
+float Light::Range() const
+{
+    // Solve constant + linear * d + quadratic * d^2 = 256 * brightest channel
+    float brightness = std::max(std::max(material.albedo.r, material.albedo.g), material.albedo.b);
+    float target = 256.0f * brightness - constant;
+    if (target <= 0.0f)
+        return 0.0f;
+    if (quadratic <= 0.0f)
+        return linear > 0.0f ? target / linear : std::numeric_limits<float>::max();
+    return (-linear + std::sqrt(linear * linear + 4.0f * quadratic * target)) / (2.0f * quadratic);
+}
+
+std::vector<Model *> Light::InfluencedModels() const
+{
+    std::vector<Model *> influenced;
+    if (type == "Directional")
+        return models;
+
+    sceneBVH.QuerySphere(translation, Range(), [&](void *model)
+                         { influenced.push_back(static_cast<Model *>(model)); });
+    return influenced;
 }
 
 void Light::UI()
@@ -44,6 +87,7 @@ void Light::UI()
             ImGui::SliderFloat("Constant", &constant, 0.0f, 1.0f);
             ImGui::SliderFloat("Linear", &linear, 0.0f, 2.0f);
             ImGui::SliderFloat("Quadratic", &quadratic, 0.0f, 2.0f);
+            ImGui::Text("Range: %.1f, models lit: %zu", Range(), InfluencedModels().size());
         }
         else
         {
@@ -55,37 +99,40 @@ void Light::UI()
             ImGui::Text("Cutoff Angles");
             ImGui::SliderFloat("Cutoff", &cutoff, 0.0f, 90.0f);
             ImGui::SliderFloat("Outer Cutoff", &outerCutoff, cutoff, 90.0f);
+            ImGui::Text("Range: %.1f, models lit: %zu", Range(), InfluencedModels().size());
         }
     }
 }
 
-void Light::Directional(Shader &shader)
+void Light::Directional(FrameBlock &frame)
 {
-    glUniform3f(glGetUniformLocation(shader.ID, "dLight.color"), material.albedo.x, material.albedo.y, material.albedo.z);
-    glUniform3f(glGetUniformLocation(shader.ID, "dLight.direction"), direction.x, direction.y, direction.z);
+    frame.dLight.color = material.albedo;
+    frame.dLight.direction = direction;
 }
 
-void Light::Point(Shader &shader, int index)
+void Light::Point(std::vector<PointLightBlock> &pointLights)
 {
-    std::string baseName = "pLight[" + std::to_string(index) + "].";
+    PointLightBlock light = {};
+    light.color = material.albedo;
 
-    glUniform3f(glGetUniformLocation(shader.ID, (baseName + "color").c_str()), material.albedo.x, material.albedo.y, material.albedo.z);
-
-    glUniform3f(glGetUniformLocation(shader.ID, (baseName + "position").c_str()), translation.x, translation.y, translation.z);
-    glUniform1f(glGetUniformLocation(shader.ID, (baseName + "constant").c_str()), constant);
-    glUniform1f(glGetUniformLocation(shader.ID, (baseName + "linear").c_str()), linear);
-    glUniform1f(glGetUniformLocation(shader.ID, (baseName + "quadratic").c_str()), quadratic);
+    light.position = translation;
+    light.constant = constant;
+    light.linear = linear;
+    light.quadratic = quadratic;
+    light.range = Range();
+    pointLights.push_back(light);
 }
 
-void Light::Spot(Shader &shader)
+void Light::Spot(FrameBlock &frame)
 {
-    glUniform3f(glGetUniformLocation(shader.ID, "sLight.ambient"), material.albedo.x, material.albedo.y, material.albedo.z);
-
-    glUniform3f(glGetUniformLocation(shader.ID, "sLight.position"), translation.x, translation.y, translation.z);
-    glUniform3f(glGetUniformLocation(shader.ID, "sLight.direction"), direction.x, direction.y, direction.z);
-    glUniform1f(glGetUniformLocation(shader.ID, "sLight.constant"), constant);
-    glUniform1f(glGetUniformLocation(shader.ID, "sLight.linear"), linear);
-    glUniform1f(glGetUniformLocation(shader.ID, "sLight.quadratic"), quadratic);
-    glUniform1f(glGetUniformLocation(shader.ID, "sLight.cutOff"), glm::cos(glm::radians(cutoff)));
-    glUniform1f(glGetUniformLocation(shader.ID, "sLight.outerCutOff"), glm::cos(glm::radians(outerCutoff)));
+    SpotLightBlock &light = frame.sLight;
+    light.color = material.albedo;
+
+    light.position = translation;
+    light.direction = direction;
+    light.constant = constant;
+    light.linear = linear;
+    light.quadratic = quadratic;
+    light.cutOff = glm::cos(glm::radians(cutoff));
+    light.outerCutOff = glm::cos(glm::radians(outerCutoff));
 }
@@ -0,0 +1,180 @@
+#include "lightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Replaces the contents of a texture buffer's storage
+    void uploadTextureBuffer(GLuint buffer, const void *data, size_t bytes)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    GLuint createTextureBuffer(GLuint buffer, GLenum format)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        return texture;
+    }
+}
+
+void LightClusters::createBuffers()
+{
+    glGenBuffers(1, &lightBuffer);
+    glGenBuffers(1, &clusterBuffer);
+    glGenBuffers(1, &indexBuffer);
+    // Empty buffers can't back a texture, every one holds at least one element
+    GLuint zero[4] = {};
+    uploadTextureBuffer(lightBuffer, zero, sizeof(zero));
+    uploadTextureBuffer(clusterBuffer, zero, sizeof(zero));
+    uploadTextureBuffer(indexBuffer, zero, sizeof(zero));
+    // Three texels per light, laid out like PointLightBlock
+    lightTexture = createTextureBuffer(lightBuffer, GL_RGBA32F);
+    clusterTexture = createTextureBuffer(clusterBuffer, GL_RG32UI);
+    indexTexture = createTextureBuffer(indexBuffer, GL_R32UI);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+}
+
+void LightClusters::Build(const Camera &camera, const std::vector<PointLightBlock> &lights, FrameBlock &frame)
+{
+    if (lightBuffer == 0)
+        createBuffers();
+
+    // Planes of the perspective projection, see glm::perspective
+    const glm::mat4 &projection = camera.projection;
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+    float logRatio = std::log(farPlane / nearPlane);
+    float sliceScale = CLUSTER_GRID_Z / logRatio;
+    float sliceBias = -CLUSTER_GRID_Z * std::log(nearPlane) / logRatio;
+
+    frame.clusterScale = glm::vec4((float)CLUSTER_GRID_X / camera.width, (float)CLUSTER_GRID_Y / camera.height, sliceScale, sliceBias);
+    frame.clusterDepth = glm::vec4(nearPlane, farPlane, 0.0f, 0.0f);
+    frame.clusterGrid = glm::ivec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0);
+
+    // View depth where every slice starts, and the view space x / depth and y / depth of every tile edge
+    float sliceDepth[CLUSTER_GRID_Z + 1];
+    for (int z = 0; z <= CLUSTER_GRID_Z; z++)
+        sliceDepth[z] = nearPlane * std::pow(farPlane / nearPlane, (float)z / CLUSTER_GRID_Z);
+    float edgeX[CLUSTER_GRID_X + 1], edgeY[CLUSTER_GRID_Y + 1];
+    for (int x = 0; x <= CLUSTER_GRID_X; x++)
+        edgeX[x] = (2.0f * x / CLUSTER_GRID_X - 1.0f) / projection[0][0];
+    for (int y = 0; y <= CLUSTER_GRID_Y; y++)
+        edgeY[y] = (2.0f * y / CLUSTER_GRID_Y - 1.0f) / projection[1][1];
+    auto slice = [&](float depth)
+    { return std::min(std::max((int)std::floor(std::log(depth) * sliceScale + sliceBias), 0), CLUSTER_GRID_Z - 1); };
+    auto tile = [](float tangent, float scale, int count)
+    { return std::min(std::max((int)std::floor((tangent * scale * 0.5f + 0.5f) * count), 0), count - 1); };
+
+    pairs.clear();
+    for (GLuint light = 0; light < (GLuint)lights.size(); light++)
+    {
+        glm::vec3 center = glm::vec3(camera.view * glm::vec4(lights[light].position, 1.0f));
+        float depth = -center.z;
+        float radius = lights[light].range;
+        float nearest = depth - radius, farthest = depth + radius;
+        if (farthest < nearPlane || nearest > farPlane)
+            continue;
+
+        // Tiles the sphere's view space box covers, all of them when it reaches behind the camera
+        int x0 = 0, x1 = CLUSTER_GRID_X - 1, y0 = 0, y1 = CLUSTER_GRID_Y - 1;
+        if (nearest > nearPlane)
+        {
+            x0 = tile(std::min((center.x - radius) / nearest, (center.x - radius) / farthest), projection[0][0], CLUSTER_GRID_X);
+            x1 = tile(std::max((center.x + radius) / nearest, (center.x + radius) / farthest), projection[0][0], CLUSTER_GRID_X);
+            y0 = tile(std::min((center.y - radius) / nearest, (center.y - radius) / farthest), projection[1][1], CLUSTER_GRID_Y);
+            y1 = tile(std::max((center.y + radius) / nearest, (center.y + radius) / farthest), projection[1][1], CLUSTER_GRID_Y);
+        }
+
+        // Sphere against each candidate cluster's view space box
+        float radiusSquared = radius * radius;
+        for (int z = slice(std::max(nearest, nearPlane)); z <= slice(std::min(farthest, farPlane)); z++)
+        {
+            float zNear = sliceDepth[z], zFar = sliceDepth[z + 1];
+            float dz = std::max(0.0f, std::max(zNear - depth, depth - zFar));
+            for (int y = y0; y <= y1; y++)
+            {
+                float minY = std::min(edgeY[y] * zNear, edgeY[y] * zFar);
+                float maxY = std::max(edgeY[y + 1] * zNear, edgeY[y + 1] * zFar);
+                float dy = std::max(0.0f, std::max(minY - center.y, center.y - maxY));
+                float rest = radiusSquared - dy * dy - dz * dz;
+                if (rest < 0.0f)
+                    continue;
+                // Branch free over the row, so it vectorizes like CullBoxes
+                bool inside[CLUSTER_GRID_X];
+                for (int x = x0; x <= x1; x++)
+                {
+                    float minX = std::min(edgeX[x] * zNear, edgeX[x] * zFar);
+                    float maxX = std::max(edgeX[x + 1] * zNear, edgeX[x + 1] * zFar);
+                    float dx = std::max(0.0f, std::max(minX - center.x, center.x - maxX));
+                    inside[x] = dx * dx <= rest;
+                }
+                GLuint row = (GLuint)(CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * z));
+                for (int x = x0; x <= x1; x++)
+                    if (inside[x])
+                        pairs.push_back({row + x, light});
+            }
+        }
+    }
+
+    // Counting sort by cluster into one index list
+    clusters.assign(2 * CLUSTER_COUNT, 0);
+    for (const std::pair<GLuint, GLuint> &pair : pairs)
+        clusters[2 * pair.first + 1]++;
+    GLuint offset = 0;
+    occupied = 0;
+    maxPerCluster = 0;
+    for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+    {
+        GLuint count = clusters[2 * cluster + 1];
+        clusters[2 * cluster] = offset;
+        offset += count;
+        occupied += count > 0 ? 1 : 0;
+        maxPerCluster = std::max(maxPerCluster, count);
+    }
+    indices.resize(pairs.size());
+    std::vector<GLuint> cursor(CLUSTER_COUNT);
+    for (const std::pair<GLuint, GLuint> &pair : pairs)
+        indices[clusters[2 * pair.first] + cursor[pair.first]++] = pair.second;
+    // Beyond what a buffer texture can address, the clusters at the far end lose lights
+    if (maxTexels > 0 && indices.size() > (size_t)maxTexels)
+    {
+        indices.resize(maxTexels);
+        for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            GLuint first = std::min(clusters[2 * cluster], (GLuint)maxTexels);
+            clusters[2 * cluster + 1] = std::min(clusters[2 * cluster + 1], (GLuint)maxTexels - first);
+        }
+    }
+    lightCount = lights.size();
+
+    if (!lights.empty())
+        uploadTextureBuffer(lightBuffer, lights.data(), lights.size() * sizeof(PointLightBlock));
+    uploadTextureBuffer(clusterBuffer, clusters.data(), clusters.size() * sizeof(GLuint));
+    if (!indices.empty())
+        uploadTextureBuffer(indexBuffer, indices.data(), indices.size() * sizeof(GLuint));
+}
+
+void LightClusters::Bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + POINT_LIGHT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    glActiveTexture(GL_TEXTURE0 + LIGHT_CLUSTER_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, clusterTexture);
+    glActiveTexture(GL_TEXTURE0 + LIGHT_INDEX_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void LightClusters::UI() const
+{
+    ImGui::Text("Point lights: %zu, %zu light / cluster pairs", lightCount, indices.size());
+    ImGui::Text("Clusters lit: %zu / %d, max %u lights, %.1f average", occupied, CLUSTER_COUNT, maxPerCluster,
+                occupied == 0 ? 0.0f : (float)indices.size() / occupied);
+}
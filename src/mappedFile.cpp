@@ -0,0 +1,157 @@
+#include "mappedFile.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path)
+{
+    if (!mapFile(path))
+        readFile(path);
+}
+
+MappedFile::~MappedFile()
+{
+    release();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+    moveFrom(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        moveFrom(other);
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+bool MappedFile::mapFile(const std::string &path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = (const unsigned char *)view;
+    size = (size_t)fileSize.QuadPart;
+    mapped = true;
+    return true;
+}
+#else
+bool MappedFile::mapFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    data = (const unsigned char *)view;
+    size = (size_t)info.st_size;
+    mapped = true;
+    return true;
+}
+#endif
+
+void MappedFile::readFile(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Unable to open file: " + path);
+
+    in.seekg(0, std::ios::end);
+    fallback.resize((size_t)in.tellg());
+    in.seekg(0, std::ios::beg);
+    in.read((char *)fallback.data(), fallback.size());
+
+    data = fallback.data();
+    size = fallback.size();
+    mapped = false;
+}
+
+void MappedFile::release()
+{
+    if (mapped)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        munmap((void *)data, size);
+#endif
+    }
+    fallback.clear();
+    data = nullptr;
+    size = 0;
+    mapped = false;
+}
+
+void MappedFile::moveFrom(MappedFile &other)
+{
+    fallback = std::move(other.fallback);
+    mapped = other.mapped;
+    size = other.size;
+    data = mapped ? other.data : fallback.data();
+#ifdef _WIN32
+    fileHandle = other.fileHandle;
+    mappingHandle = other.mappingHandle;
+    other.fileHandle = nullptr;
+    other.mappingHandle = nullptr;
+#endif
+    other.data = nullptr;
+    other.size = 0;
+    other.mapped = false;
+}
@@ -1,20 +1,57 @@
 #include "Mesh.h"
 
-Mesh::Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices, std::vector<Texture> &textures)
+#include <cstddef>
+
+Mesh::Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices, std::vector<Texture> &textures, const std::vector<MeshLOD> &lods, const VertexLayout &layout)
 {
     Mesh::vertices = vertices;
     Mesh::indices = indices;
     Mesh::textures = textures;
+    Mesh::lods = lods;
+    Mesh::layout = layout;
+    if (Mesh::lods.empty())
+        Mesh::lods.push_back({0, (GLsizei)indices.size(), 0.0f});
+
+    // Quantize against the vertices themselves, bounds from the file may be rounded
+    AABB vertexBounds;
+    if (!vertices.empty())
+    {
+        vertexBounds.min = vertexBounds.max = vertices[0].position;
+        for (const Vertex &vertex : vertices)
+            vertexBounds.Expand(vertex.position);
+    }
+    layout.Dequantization(vertexBounds, positionScale, positionOffset);
+    std::vector<unsigned char> packed = layout.Pack(vertices, vertexBounds);
+
+    arena = &GeometryArena::For(layout);
+    if (vertices.size() <= 65536)
+    {
+        std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+        geometry = arena->Allocate(packed, shortIndices.data(), shortIndices.size() * sizeof(GLushort));
+        indexType = GL_UNSIGNED_SHORT;
+        indexBytes += shortIndices.size() * sizeof(GLushort);
+    }
+    else
+    {
+        geometry = arena->Allocate(packed, indices.data(), indices.size() * sizeof(GLuint));
+        indexType = GL_UNSIGNED_INT;
+        indexBytes += indices.size() * sizeof(GLuint);
+    }
+    vertexBytes += packed.size() + vertices.size() * layout.PositionStride();
+}
 
-    VAO.Bind();
-    VBO VBO(vertices);
-    EBO EBO(indices);
-    VAO.LinkAttrib(VBO, 0, 3, GL_FLOAT, sizeof(Vertex), (void *)0);
-    VAO.LinkAttrib(VBO, 1, 3, GL_FLOAT, sizeof(Vertex), (void *)(3 * sizeof(float)));
-    VAO.LinkAttrib(VBO, 2, 2, GL_FLOAT, sizeof(Vertex), (void *)(6 * sizeof(float)));
-    VAO.Unbind();
-    VBO.Unbind();
-    EBO.Unbind();
+void Mesh::Delete()
+{
+    if (arena == nullptr)
+        return;
+    arena->Free(geometry);
+    vertexBytes -= geometry.vertexCount * (layout.Stride() + layout.PositionStride());
+    indexBytes -= indices.size() * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+    arena = nullptr;
+    // Model::getTextures acquired these once for this mesh
+    for (Texture &texture : textures)
+        texture.Delete();
+    textures.clear();
 }
 
 void Mesh::Draw(
@@ -23,53 +60,148 @@ void Mesh::Draw(
     glm::vec3 &translation,
     glm::quat &rotation,
     glm::vec3 &scale,
-    Material &material,
     bool textured,
-    glm::mat4 matrix) // Pass by reference to allow modification
+    glm::mat4 matrix, // Pass by reference to allow modification
+    unsigned int lod,
+    const IndirectDraw &indirect)
+{
+    bindState(shader, camera, textured);
+
+    // Create transformation matrices
+    matrix = glm::translate(matrix, translation);
+    matrix *= glm::mat4_cast(rotation);
+    matrix = glm::scale(matrix, scale);
+
+    DrawElements(shader, matrix, lod, indirect);
+}
+
+void Mesh::DrawElements(Shader &shader, const glm::mat4 &model, unsigned int lod, const IndirectDraw &indirect)
+{
+    shader.SetMat4(shader.uniforms.model, model);
+
+    // Without instance arrays the per-instance attributes read these constant values
+    for (GLuint column = 0; column < 4; column++)
+        glVertexAttrib4fv(INSTANCE_ATTRIB_LOCATION + column, glm::value_ptr(model[column]));
+    glVertexAttrib4f(INSTANCE_ATTRIB_LOCATION + 4, 1.0f, 1.0f, 1.0f, 1.0f);
+    glVertexAttrib4f(INSTANCE_ATTRIB_LOCATION + 5, 1.0f, 1.0f, 0.0f, 0.0f);
+    setDequantization();
+
+    // Draw the mesh
+    const MeshLOD &level = lods[lod];
+#ifdef GL_VERSION_4_3
+    if (indirect.buffer != 0)
+    {
+        // Whether it draws is up to the GPU, OcclusionCuller counts the rest once it reads the result back
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect.buffer);
+        glDrawElementsIndirect(GL_TRIANGLES, indexType, (void *)indirect.offset);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        RenderStats::frame.drawCalls++;
+        return;
+    }
+#endif
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    glDrawElementsBaseVertex(GL_TRIANGLES, level.count, indexType, (void *)(geometry.indexOffset + level.firstIndex * indexSize), geometry.baseVertex);
+
+    RenderStats::frame.drawCalls++;
+    RenderStats::frame.instances++;
+    RenderStats::frame.triangles += level.count / 3;
+    RenderStats::frame.lodDraws[lod]++;
+}
+
+unsigned int Mesh::SelectLOD(float maxError) const
+{
+    unsigned int lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error <= maxError)
+        lod++;
+    return lod;
+}
+
+void Mesh::DrawInstanced(
+    Shader &shader,
+    Camera &camera,
+    GLuint instanceVBO,
+    GLsizei count,
+    bool textured)
+{
+    bindState(shader, camera, textured);
+
+    // Attach the instance buffer for this draw only, so plain draws keep using the constant values
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        GLuint location = INSTANCE_ATTRIB_LOCATION + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    glVertexAttribPointer(INSTANCE_ATTRIB_LOCATION + 4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, albedoRoughness));
+    glVertexAttribPointer(INSTANCE_ATTRIB_LOCATION + 5, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, metallicAo));
+    for (GLuint location = INSTANCE_ATTRIB_LOCATION + 4; location <= INSTANCE_ATTRIB_LOCATION + 5; location++)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    setDequantization();
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lods[0].count, indexType, (void *)geometry.indexOffset, count, geometry.baseVertex);
+
+    for (GLuint location = INSTANCE_ATTRIB_LOCATION; location <= INSTANCE_ATTRIB_LOCATION + 5; location++)
+    {
+        glVertexAttribDivisor(location, 0);
+        glDisableVertexAttribArray(location);
+    }
+
+    RenderStats::frame.drawCalls++;
+    RenderStats::frame.instances += count;
+    RenderStats::frame.triangles += count * (lods[0].count / 3);
+    RenderStats::frame.lodDraws[0]++;
+}
+
+void Mesh::setDequantization()
+{
+    glVertexAttrib3fv(POSITION_SCALE_ATTRIB_LOCATION, glm::value_ptr(positionScale));
+    glVertexAttrib3fv(POSITION_OFFSET_ATTRIB_LOCATION, glm::value_ptr(positionOffset));
+}
+
+void Mesh::bindState(Shader &shader, Camera &camera, bool textured)
 {
     shader.Activate();
-    VAO.Bind();
-    glUniform1i(glGetUniformLocation(shader.ID, "textured"), textured);
+    arena->VertexArray(shader.PositionOnly()).Bind();
+    shader.SetInt(shader.uniforms.textured, textured);
+    // A depth-only program samples nothing
+    if (!shader.PositionOnly())
+        BindTextures(shader);
+
+    // Set camera position and view matrix
+    shader.SetVec3(shader.uniforms.camPos, camera.Position);
+    camera.Matrix(shader);
+}
 
+void Mesh::BindTextures(Shader &shader)
+{
+    const ShaderUniforms &uniforms = shader.uniforms;
     unsigned int numDiffuse = 0;
     unsigned int numSpecular = 0;
 
     // Bind textures
     for (unsigned int i = 0; i < textures.size(); i++)
     {
-        std::string num;
         std::string type = textures[i].type;
-        if (type == "diffuse")
-        {
-            num = std::to_string(numDiffuse++);
-        }
+        GLint location;
+        if (type == "albedo")
+            location = uniforms.albedoMap;
+        else if (type == "normal")
+            location = uniforms.normalMap;
+        else if (type == "arm")
+            location = uniforms.armMap;
+        else if (type == "diffuse")
+            location = shader.Uniform(type + std::to_string(numDiffuse++));
         else if (type == "specular")
-        {
-            num = std::to_string(numSpecular++);
-        }
+            location = shader.Uniform(type + std::to_string(numSpecular++));
         else
-        {
-            num = "Map";
-        }
-        textures[i].texUnit(shader, (type + num).c_str(), i + 3);
+            location = shader.Uniform(type + "Map");
+        shader.SetInt(location, i + 3);
         textures[i].Bind();
     }
-
-    // Set camera position and view matrix
-    glUniform3f(glGetUniformLocation(shader.ID, "camPos"), camera.Position.x, camera.Position.y, camera.Position.z);
-    camera.Matrix(shader, "camMatrix");
-
-    // Create transformation matrices
-    matrix = glm::translate(matrix, translation);
-    matrix *= glm::mat4_cast(rotation);
-    matrix = glm::scale(matrix, scale);
-
-    glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, glm::value_ptr(matrix));
-    glUniform3f(glGetUniformLocation(shader.ID, "material.albedo"), material.albedo.x, material.albedo.y, material.albedo.z);
-    glUniform1f(glGetUniformLocation(shader.ID, "material.metallic"), material.metallic);
-    glUniform1f(glGetUniformLocation(shader.ID, "material.roughness"), material.roughness);
-    glUniform1f(glGetUniformLocation(shader.ID, "material.ao"), material.ao);
-
-    // Draw the mesh
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 }
@@ -0,0 +1,633 @@
+#include "meshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    // Cache the Forsyth scores are tuned for, larger than the statistics cache on purpose
+    const int FORSYTH_CACHE_SIZE = 32;
+    const int FORSYTH_MAX_VALENCE = 32;
+
+    // Hashes and compares vertices by their bytes, so only exact duplicates are merged
+    struct VertexHash
+    {
+        size_t operator()(const Vertex &vertex) const
+        {
+            // FNV-1a over the raw bytes
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&vertex);
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return (size_t)hash;
+        }
+    };
+    struct VertexEqual
+    {
+        bool operator()(const Vertex &a, const Vertex &b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+    };
+
+    // Score tables from "Linear-Speed Vertex Cache Optimisation" (Forsyth 2006)
+    struct ForsythScores
+    {
+        float cache[FORSYTH_CACHE_SIZE];
+        float valence[FORSYTH_MAX_VALENCE + 1];
+
+        ForsythScores()
+        {
+            for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+            {
+                // The last triangle's vertices get a fixed score so it isn't favoured over its neighbours
+                if (i < 3)
+                    cache[i] = 0.75f;
+                else
+                    cache[i] = std::pow(1.0f - (float)(i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+            }
+            valence[0] = 0.0f;
+            for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+                valence[i] = 2.0f / std::sqrt((float)i);
+        }
+
+        float Vertex(int cachePosition, unsigned int remaining) const
+        {
+            if (remaining == 0)
+                return -1.0f;
+            float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+            return score + valence[std::min<unsigned int>(remaining, FORSYTH_MAX_VALENCE)];
+        }
+    };
+
+    const ForsythScores &forsythScores()
+    {
+        static const ForsythScores scores;
+        return scores;
+    }
+
+    // Sum of squared distances to a set of planes, weighted by the area of the triangles they came from
+    struct Quadric
+    {
+        // Upper triangle of the symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww
+        double m[10] = {};
+        double weight = 0.0;
+
+        void AddPlane(const glm::vec3 &normal, float distance, double area)
+        {
+            double p[4] = {normal.x, normal.y, normal.z, distance};
+            int k = 0;
+            for (int i = 0; i < 4; i++)
+                for (int j = i; j < 4; j++)
+                    m[k++] += p[i] * p[j] * area;
+            weight += area;
+        }
+
+        void Add(const Quadric &other)
+        {
+            for (int i = 0; i < 10; i++)
+                m[i] += other.m[i];
+            weight += other.weight;
+        }
+
+        // Mean squared distance of 'point' to the planes
+        double Evaluate(const glm::vec3 &point) const
+        {
+            double x = point.x, y = point.y, z = point.z;
+            double sum = m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x +
+                         m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y +
+                         m[7] * z * z + 2.0 * m[8] * z + m[9];
+            return weight > 0.0 ? std::max(0.0, sum / weight) : 0.0;
+        }
+    };
+
+    // How far apart two vertices at the same position are in their other attributes
+    float attributeDistance(const Vertex &a, const Vertex &b)
+    {
+        glm::vec3 normal = a.normal - b.normal;
+        glm::vec2 uv = a.texUV - b.texUV;
+        return glm::dot(normal, normal) + glm::dot(uv, uv);
+    }
+
+    uint64_t edgeKey(GLuint a, GLuint b)
+    {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    // Flat per key lists, rebuilt each pass: items of key k are items[offsets[k]..offsets[k + 1])
+    struct Buckets
+    {
+        std::vector<size_t> offsets;
+        std::vector<unsigned int> items;
+    };
+}
+
+size_t MeshOptimizer::WeldVertices(std::vector<Vertex> &vertices, std::vector<GLuint> &indices)
+{
+    std::unordered_map<Vertex, GLuint, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    std::vector<GLuint> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        auto inserted = unique.emplace(vertices[i], (GLuint)welded.size());
+        if (inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    for (GLuint &index : indices)
+        index = remap[index];
+
+    size_t removed = vertices.size() - welded.size();
+    vertices.swap(welded);
+    return removed;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<GLuint> &indices, size_t vertexCount)
+{
+    const ForsythScores &scores = forsythScores();
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles using each vertex, as one flat array with per vertex offsets
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (GLuint index : indices)
+        remaining[index]++;
+    std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = scores.Vertex(-1, remaining[v]);
+    std::vector<unsigned char> emitted(triangleCount, 0);
+
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    std::vector<GLuint> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+    size_t scanCursor = 0;
+    long long best = -1;
+
+    while (result.size() < indices.size())
+    {
+        // Nothing in the cache has triangles left, continue with the next unused triangle in input order
+        if (best < 0)
+        {
+            while (emitted[scanCursor])
+                scanCursor++;
+            best = (long long)scanCursor;
+        }
+
+        size_t triangle = (size_t)best;
+        emitted[triangle] = 1;
+        nextCache.clear();
+        for (int k = 0; k < 3; k++)
+        {
+            GLuint v = indices[triangle * 3 + k];
+            result.push_back(v);
+            nextCache.push_back(v);
+            // Take the triangle out of the vertex's list so scores only count what is left
+            size_t begin = adjacencyOffset[v];
+            size_t end = begin + remaining[v];
+            std::remove(adjacency.begin() + begin, adjacency.begin() + end, (unsigned int)triangle);
+            remaining[v]--;
+        }
+        for (GLuint v : cache)
+            if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2])
+                nextCache.push_back(v);
+
+        // Vertices pushed out of the modelled cache lose their cache score
+        for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++)
+        {
+            cachePosition[nextCache[i]] = -1;
+            vertexScore[nextCache[i]] = scores.Vertex(-1, remaining[nextCache[i]]);
+        }
+        if (nextCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            cachePosition[nextCache[i]] = (int)i;
+            vertexScore[nextCache[i]] = scores.Vertex((int)i, remaining[nextCache[i]]);
+        }
+        cache.swap(nextCache);
+
+        // Only triangles touching the cache changed score, the best of them goes next
+        best = -1;
+        float bestScore = -1.0f;
+        for (GLuint v : cache)
+        {
+            size_t begin = adjacencyOffset[v];
+            for (size_t i = begin; i < begin + remaining[v]; i++)
+            {
+                unsigned int t = adjacency[i];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+    indices.swap(result);
+}
+
+bool MeshOptimizer::OptimizeOverdraw(std::vector<GLuint> &indices, const std::vector<Vertex> &vertices, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return false;
+    VertexCacheStats before = AnalyzeVertexCache(indices, vertices.size());
+
+    // Split where the cache mostly restarts: a triangle missing two or more vertices can start a new cluster
+    // once the current one is big enough, so moving clusters around costs little reuse
+    const size_t minClusterTriangles = 64;
+    std::vector<size_t> clusterStart;
+    {
+        std::vector<unsigned int> timestamp(vertices.size(), 0);
+        unsigned int time = STATS_CACHE_SIZE + 1;
+        size_t lastStart = 0;
+        clusterStart.push_back(0);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                GLuint v = indices[t * 3 + k];
+                if (time - timestamp[v] > STATS_CACHE_SIZE)
+                {
+                    timestamp[v] = time++;
+                    misses++;
+                }
+            }
+            if (misses >= 2 && t - lastStart >= minClusterTriangles)
+            {
+                clusterStart.push_back(t);
+                lastStart = t;
+            }
+        }
+        clusterStart.push_back(triangleCount);
+    }
+    size_t clusterCount = clusterStart.size() - 1;
+    if (clusterCount < 2)
+        return false;
+
+    // Clusters facing away from the mesh centre are likely in front of the rest, so they go first
+    glm::vec3 meshCentre(0.0f);
+    for (const Vertex &vertex : vertices)
+        meshCentre += vertex.position;
+    meshCentre /= (float)std::max<size_t>(1, vertices.size());
+
+    std::vector<std::pair<float, size_t>> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3 &p = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 cross = glm::cross(b - a, p - a);
+            float triangleArea = glm::length(cross);
+            centroid += (a + b + p) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        centroid = area > 0.0f ? centroid / area : vertices[indices[clusterStart[c] * 3]].position;
+        float length = glm::length(normal);
+        float key = length > 0.0f ? glm::dot(centroid - meshCentre, normal / length) : 0.0f;
+        order[c] = {-key, c};
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    std::vector<GLuint> result;
+    result.reserve(indices.size());
+    for (const std::pair<float, size_t> &cluster : order)
+        result.insert(result.end(), indices.begin() + clusterStart[cluster.second] * 3, indices.begin() + clusterStart[cluster.second + 1] * 3);
+
+    VertexCacheStats after = AnalyzeVertexCache(result, vertices.size());
+    if (after.acmr > before.acmr * threshold)
+        return false;
+    indices.swap(result);
+    return true;
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<GLuint> &indices)
+{
+    const GLuint unused = ~0u;
+    std::vector<GLuint> remap(vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (GLuint &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = (GLuint)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+std::vector<GLuint> MeshOptimizer::Simplify(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices, size_t targetIndexCount, float &error)
+{
+    error = 0.0f;
+    std::vector<GLuint> result = indices;
+    size_t vertexCount = vertices.size();
+    if (vertexCount == 0 || indices.size() <= targetIndexCount)
+        return result;
+
+    // Vertices split by normal or UV seams share a position, collapses work on positions so seams move together
+    std::vector<GLuint> position(vertexCount);
+    std::vector<GLuint> positionVertices;
+    Buckets group;
+    {
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+                return (size_t)((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u));
+            }
+        };
+        std::unordered_map<glm::vec3, GLuint, PositionHash> unique;
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            auto inserted = unique.emplace(vertices[v].position, (GLuint)positionVertices.size());
+            if (inserted.second)
+                positionVertices.push_back((GLuint)v);
+            position[v] = inserted.first->second;
+        }
+        group.offsets.assign(positionVertices.size() + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            group.offsets[position[v] + 1]++;
+        for (size_t p = 0; p < positionVertices.size(); p++)
+            group.offsets[p + 1] += group.offsets[p];
+        group.items.resize(vertexCount);
+        std::vector<size_t> fill(group.offsets.begin(), group.offsets.end() - 1);
+        for (size_t v = 0; v < vertexCount; v++)
+            group.items[fill[position[v]]++] = (unsigned int)v;
+    }
+    size_t positionCount = positionVertices.size();
+    auto point = [&](GLuint p) -> const glm::vec3 &
+    { return vertices[positionVertices[p]].position; };
+
+    // Edges on an open border or shared by more than two triangles pin their ends
+    std::vector<unsigned char> locked(positionCount, 0);
+    {
+        std::unordered_map<uint64_t, int> edges;
+        for (size_t t = 0; t < result.size(); t += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                GLuint a = position[result[t + k]], b = position[result[t + (k + 1) % 3]];
+                if (a != b)
+                    edges[edgeKey(a, b)]++;
+            }
+        for (const auto &edge : edges)
+            if (edge.second != 2)
+            {
+                locked[edge.first >> 32] = 1;
+                locked[edge.first & 0xFFFFFFFFu] = 1;
+            }
+    }
+
+    std::vector<Quadric> quadrics(positionCount);
+    glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+        const glm::vec3 &a = point(position[result[t]]);
+        const glm::vec3 &b = point(position[result[t + 1]]);
+        const glm::vec3 &c = point(position[result[t + 2]]);
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        boundsMin = glm::min(boundsMin, glm::min(a, glm::min(b, c)));
+        boundsMax = glm::max(boundsMax, glm::max(a, glm::max(b, c)));
+        if (length <= 0.0f)
+            continue;
+        normal /= length;
+        for (int k = 0; k < 3; k++)
+            quadrics[position[result[t + k]]].AddPlane(normal, -glm::dot(normal, a), length * 0.5);
+    }
+    // Attribute seams cost like a geometric error of 1% of the mesh size, so collapses across them go last
+    float attributeScale = glm::dot(boundsMax - boundsMin, boundsMax - boundsMin) * 1e-4f;
+
+    struct Collapse
+    {
+        float cost;
+        float error;
+        GLuint from;
+        GLuint to;
+        bool operator<(const Collapse &other) const { return cost < other.cost; }
+    };
+    std::vector<Collapse> collapses;
+    std::vector<GLuint> collapseTo(positionCount);
+    std::vector<unsigned char> touched(positionCount);
+    Buckets around;
+    double maxError = 0.0;
+
+    while (result.size() > targetIndexCount)
+    {
+        // Triangles around every position
+        around.offsets.assign(positionCount + 1, 0);
+        for (GLuint index : result)
+            around.offsets[position[index] + 1]++;
+        for (size_t p = 0; p < positionCount; p++)
+            around.offsets[p + 1] += around.offsets[p];
+        around.items.resize(result.size());
+        {
+            std::vector<size_t> fill(around.offsets.begin(), around.offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+                around.items[fill[position[result[i]]]++] = (unsigned int)(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t t = 0; t < result.size(); t += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                GLuint from = position[result[t + k]], to = position[result[t + (k + 1) % 3]];
+                if (locked[from] || from == to)
+                    continue;
+                Quadric combined = quadrics[from];
+                combined.Add(quadrics[to]);
+                float geometric = (float)combined.Evaluate(point(to));
+                // Worst attribute jump of a vertex at 'from' to its closest match at 'to'
+                float attributes = 0.0f;
+                for (size_t i = group.offsets[from]; i < group.offsets[from + 1]; i++)
+                {
+                    float closest = 1e30f;
+                    for (size_t j = group.offsets[to]; j < group.offsets[to + 1]; j++)
+                        closest = std::min(closest, attributeDistance(vertices[group.items[i]], vertices[group.items[j]]));
+                    attributes = std::max(attributes, closest);
+                }
+                collapses.push_back({geometric + attributes * attributeScale, geometric, from, to});
+            }
+        std::sort(collapses.begin(), collapses.end());
+
+        // Apply the cheapest collapses that don't overlap, each touches the triangles around its 'from'
+        for (size_t p = 0; p < positionCount; p++)
+            collapseTo[p] = (GLuint)p;
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t remaining = result.size();
+        size_t applied = 0;
+        for (const Collapse &collapse : collapses)
+        {
+            if (remaining <= targetIndexCount)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // Reject collapses that flip a triangle that survives them
+            bool flips = false;
+            size_t removed = 0;
+            for (size_t i = around.offsets[collapse.from]; i < around.offsets[collapse.from + 1] && !flips; i++)
+            {
+                size_t t = around.items[i] * 3;
+                GLuint corners[3] = {position[result[t]], position[result[t + 1]], position[result[t + 2]]};
+                if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+                {
+                    removed++;
+                    continue;
+                }
+                glm::vec3 before = glm::cross(point(corners[1]) - point(corners[0]), point(corners[2]) - point(corners[0]));
+                for (GLuint &corner : corners)
+                    if (corner == collapse.from)
+                        corner = collapse.to;
+                glm::vec3 after = glm::cross(point(corners[1]) - point(corners[0]), point(corners[2]) - point(corners[0]));
+                // Turning more than about 75 degrees counts as a flip too, those are folds in the making
+                flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+            }
+            if (flips)
+                continue;
+
+            collapseTo[collapse.from] = collapse.to;
+            for (size_t i = around.offsets[collapse.from]; i < around.offsets[collapse.from + 1]; i++)
+            {
+                size_t t = around.items[i] * 3;
+                for (int k = 0; k < 3; k++)
+                    touched[position[result[t + k]]] = 1;
+            }
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            maxError = std::max(maxError, (double)collapse.error);
+            remaining -= removed * 3;
+            applied++;
+        }
+        if (applied == 0)
+            break;
+
+        // Move every corner at a collapsed position to the closest matching vertex at the target, drop degenerates
+        size_t write = 0;
+        for (size_t t = 0; t < result.size(); t += 3)
+        {
+            GLuint corners[3];
+            for (int k = 0; k < 3; k++)
+            {
+                GLuint v = result[t + k];
+                GLuint to = collapseTo[position[v]];
+                if (to != position[v])
+                {
+                    float closest = 1e30f;
+                    for (size_t j = group.offsets[to]; j < group.offsets[to + 1]; j++)
+                    {
+                        float distance = attributeDistance(vertices[v], vertices[group.items[j]]);
+                        if (distance < closest)
+                        {
+                            closest = distance;
+                            corners[k] = group.items[j];
+                        }
+                    }
+                }
+                else
+                {
+                    corners[k] = v;
+                }
+            }
+            if (position[corners[0]] == position[corners[1]] || position[corners[1]] == position[corners[2]] || position[corners[0]] == position[corners[2]])
+                continue;
+            for (int k = 0; k < 3; k++)
+                result[write++] = corners[k];
+        }
+        result.resize(write);
+    }
+
+    error = (float)std::sqrt(maxError);
+    return result;
+}
+
+void MeshOptimizer::GenerateLODs(const std::vector<Vertex> &vertices, std::vector<GLuint> &indices, std::vector<MeshLOD> &lods, unsigned int maxLODs)
+{
+    lods.clear();
+    lods.push_back({0, (GLsizei)indices.size(), 0.0f});
+    std::vector<GLuint> current(indices);
+    while (lods.size() < maxLODs)
+    {
+        size_t target = current.size() / 6 * 3;
+        float error;
+        std::vector<GLuint> next = Simplify(vertices, current, target, error);
+        // Not worth a level if it barely shrank
+        if (next.empty() || next.size() > current.size() * 3 / 4)
+            break;
+        OptimizeVertexCache(next, vertices.size());
+
+        // Errors add up since each level is simplified from the previous one
+        lods.push_back({(GLuint)indices.size(), (GLsizei)next.size(), lods.back().error + error});
+        indices.insert(indices.end(), next.begin(), next.end());
+        current.swap(next);
+    }
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<GLuint> &indices, size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    if (indices.empty() || vertexCount == 0)
+        return stats;
+
+    // FIFO: a vertex is a hit while fewer than 'cacheSize' misses happened since it was loaded
+    std::vector<unsigned int> timestamp(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    size_t misses = 0;
+    for (GLuint index : indices)
+    {
+        if (time - timestamp[index] > cacheSize)
+        {
+            timestamp[index] = time++;
+            misses++;
+        }
+    }
+    stats.acmr = (float)misses / (float)(indices.size() / 3);
+    stats.atvr = (float)misses / (float)vertexCount;
+    return stats;
+}
+
+MeshOptimizerReport MeshOptimizer::Optimize(std::vector<Vertex> &vertices, std::vector<GLuint> &indices)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    MeshOptimizerReport report;
+    report.verticesBefore = vertices.size();
+    report.before = AnalyzeVertexCache(indices, vertices.size());
+
+    WeldVertices(vertices, indices);
+    OptimizeVertexCache(indices, vertices.size());
+    report.overdrawApplied = OptimizeOverdraw(indices, vertices);
+    OptimizeVertexFetch(vertices, indices);
+
+    report.verticesAfter = vertices.size();
+    report.after = AnalyzeVertexCache(indices, vertices.size());
+    report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return report;
+}
@@ -1,51 +1,295 @@
 #include "Model.h"
+#include "threadPool.h"
+
+#include <algorithm>
+#include <cstring>
 
 Model::Model(const char *file, std::string n, bool addToList)
 {
     name = n;
-    std::string text = get_file_contents(file);
-    JSON = json::parse(text);
-
     Model::file = file;
-    data = getData();
-
-    traverseNode(0);
-
-    LoadImGuiData("saveData/transforms.json");
-
-    if (addToList)
-        models.push_back(this);
+    load(addToList);
 }
 
 Model::Model(const char *file, std::string tex, std::string n, bool addToList)
 {
     name = n;
     texFolder = tex;
-    std::string text = get_file_contents(file);
-    JSON = json::parse(text);
-
     Model::file = file;
-    data = getData();
+    load(addToList);
+}
+
+Model::~Model()
+{
+    // The tree and the list must not keep pointing at this model
+    if (bvhProxy != -1)
+    {
+        sceneBVH.Remove(bvhProxy);
+        models.erase(std::remove(models.begin(), models.end(), this), models.end());
+    }
+    // Hands the geometry back to the arenas
+    for (Mesh &mesh : meshes)
+        mesh.Delete();
+}
+
+void Model::load(bool addToList)
+{
+    source = MappedFile(file);
+    if (!parseGLB())
+        JSON = json::parse(source.Data(), source.Data() + source.Size());
+
+    getData();
+
+    // Walk every root node of the default scene, older exports may only have node 0
+    const json &gltf = JSON;
+    if (gltf.contains("scenes"))
+    {
+        unsigned int scene = gltf.value("scene", 0u);
+        for (unsigned int root : gltf["scenes"][scene]["nodes"])
+            traverseNode(root);
+    }
+    else
+    {
+        traverseNode(0);
+    }
 
-    traverseNode(0);
+    loadMeshes();
 
     LoadImGuiData("saveData/transforms.json");
 
     if (addToList)
+    {
         models.push_back(this);
+        bvhProxy = sceneBVH.Insert(WorldBounds(), this);
+    }
+}
+
+void Model::Draw(Shader &shader, Camera &camera, OcclusionCuller *occlusion)
+{
+    if (!display)
+        return;
+
+    cullMeshes(camera);
+    bindMaterial();
+    glm::mat4 modelMatrix = transform();
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (!meshVisible[i])
+        {
+            if (occlusion)
+                occlusion->Culled(meshes[i]);
+            continue;
+        }
+        glm::mat4 world = matricesMeshes[i] * modelMatrix;
+        unsigned int lod = selectLOD(i, world, camera);
+        if (occlusion && !occlusion->Submit(this, i, meshes[i], lod, world))
+            continue;
+        drawMesh(i, shader, camera, nullptr, world, lod);
+    }
 }
 
-void Model::Draw(Shader &shader, Camera &camera)
+void Model::Submit(RenderQueue &queue, Shader &shader, Camera &camera, OcclusionCuller *occlusion)
 {
     if (!display)
         return;
+
+    cullMeshes(camera);
+    uploadMaterial();
+
+    // Same composition as Mesh::Draw: node matrix, then the model's translation, rotation and scale
+    glm::mat4 modelMatrix = transform();
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (!meshVisible[i])
+        {
+            if (occlusion)
+                occlusion->Culled(meshes[i]);
+            continue;
+        }
+        glm::mat4 world = matricesMeshes[i] * modelMatrix;
+        unsigned int lod = selectLOD(i, world, camera);
+        if (occlusion && !occlusion->Submit(this, i, meshes[i], lod, world))
+            continue;
+        drawMesh(i, shader, camera, &queue, world, lod);
+    }
+}
+
+void Model::drawMesh(unsigned int i, Shader &shader, Camera &camera, RenderQueue *queue, const glm::mat4 &world, unsigned int lod, const IndirectDraw &indirect)
+{
     bool textured = texFolder == "" ? false : true;
+    if (queue)
+        queue->Submit(shader, meshes[i], &materialUBO, world, textured, camera, lod, indirect);
+    else
+        meshes[i].Mesh::Draw(shader, camera, translation, rotation, scale, textured, matricesMeshes[i], lod, indirect);
+    // Indirect draws are counted by the OcclusionCuller once it knows whether they drew
+    if (indirect.buffer == 0)
+        RenderStats::frame.meshesDrawn++;
+}
+
+void Model::Submit(IndirectRenderer &renderer, RenderQueue &queue, Shader &shader, Camera &camera)
+{
+    if (!display)
+        return;
+    if (texFolder != "")
+    {
+        Submit(queue, shader, camera);
+        return;
+    }
+
+    glm::mat4 modelMatrix = transform();
+    for (unsigned int i = 0; i < meshes.size(); i++)
+        renderer.Submit(meshes[i], matricesMeshes[i] * modelMatrix, material, levelOfDetail);
+}
+
+unsigned int Model::selectLOD(unsigned int i, const glm::mat4 &world, const Camera &camera) const
+{
+    const Mesh &mesh = meshes[i];
+    if (!levelOfDetail || lodPixelError <= 0.0f || mesh.lods.size() < 2)
+        return 0;
+
+    // Distance to the nearest point of the bounding sphere, a camera inside it gets full detail
+    AABB box = mesh.bounds.Transform(world);
+    float distance = glm::length(box.Center() - camera.Position) - glm::length(box.Extents());
+    if (distance <= 0.0f)
+        return 0;
+
+    // Pixels one world unit covers at that distance, and world units per object unit
+    float pixelsPerUnit = camera.projection[1][1] * camera.height * 0.5f / distance;
+    float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+    return mesh.SelectLOD(lodPixelError / (pixelsPerUnit * scale));
+}
+
+void Model::cullMeshes(Camera &camera)
+{
+    meshVisible.assign(meshes.size(), 1);
+    if (!frustumCulling)
+        return;
+
+    glm::mat4 modelMatrix = transform();
+    worldBounds.Clear();
     for (unsigned int i = 0; i < meshes.size(); i++)
+        worldBounds.Push(meshes[i].bounds.Transform(matricesMeshes[i] * modelMatrix));
+
+    size_t visible = CullBoxes(Frustum::FromMatrix(camera.cameraMatrix), worldBounds, meshVisible.data());
+    RenderStats::frame.meshesCulled += meshes.size() - visible;
+}
+
+void Model::DrawVisible(Shader &shader, Camera &camera, OcclusionCuller *occlusion)
+{
+    if (occlusion && occlusion->enabled)
+    {
+        drawOccluded(nullptr, shader, camera, *occlusion);
+        return;
+    }
+    unsigned int drawn = 0;
+    sceneBVH.QueryFrustum(Frustum::FromMatrix(camera.cameraMatrix), [&](void *model)
+                          {
+                              static_cast<Model *>(model)->Draw(shader, camera);
+                              drawn++; });
+    RenderStats::frame.modelsCulled += (unsigned int)sceneBVH.LeafCount() - drawn;
+}
+
+void Model::SubmitVisible(RenderQueue &queue, Shader &shader, Camera &camera, OcclusionCuller *occlusion)
+{
+    if (occlusion && occlusion->enabled)
+    {
+        drawOccluded(&queue, shader, camera, *occlusion);
+        return;
+    }
+    unsigned int submitted = 0;
+    sceneBVH.QueryFrustum(Frustum::FromMatrix(camera.cameraMatrix), [&](void *model)
+                          {
+                              static_cast<Model *>(model)->Submit(queue, shader, camera);
+                              submitted++; });
+    RenderStats::frame.modelsCulled += (unsigned int)sceneBVH.LeafCount() - submitted;
+}
+
+void Model::drawOccluded(RenderQueue *queue, Shader &shader, Camera &camera, OcclusionCuller &occlusion)
+{
+    // Phase 0: what was visible last frame
+    occlusion.Begin(camera);
+    unsigned int drawn = 0;
+    sceneBVH.QueryFrustum(Frustum::FromMatrix(camera.cameraMatrix), [&](void *owner)
+                          {
+                              Model *model = static_cast<Model *>(owner);
+                              if (queue)
+                                  model->Submit(*queue, shader, camera, &occlusion);
+                              else
+                                  model->Draw(shader, camera, &occlusion);
+                              drawn++; });
+    RenderStats::frame.modelsCulled += (unsigned int)sceneBVH.LeafCount() - drawn;
+
+    // Phase 1: the rest, tested against the depth phase 0 left
+    if (queue)
+        queue->Flush(camera);
+    occlusion.Test();
+    Model *bound = nullptr;
+    for (const OcclusionCandidate &candidate : occlusion.Candidates())
+    {
+        Model *model = static_cast<Model *>(candidate.owner);
+        if (!queue && model != bound)
+        {
+            model->bindMaterial();
+            bound = model;
+        }
+        model->drawMesh(candidate.index, shader, camera, queue, candidate.world, candidate.lod, candidate.indirect);
+    }
+}
+
+Model *Model::Pick(const glm::vec3 &origin, const glm::vec3 &direction)
+{
+    float distance;
+    return static_cast<Model *>(sceneBVH.Raycast(origin, direction, distance));
+}
+
+AABB Model::WorldBounds() const
+{
+    glm::mat4 modelMatrix = transform();
+    AABB bounds;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        AABB meshBounds = meshes[i].bounds.Transform(matricesMeshes[i] * modelMatrix);
+        if (i == 0)
+            bounds = meshBounds;
+        else
+            bounds.Expand(meshBounds);
+    }
+    return bounds;
+}
+
+void Model::UpdateBounds()
+{
+    if (bvhProxy != -1)
+        sceneBVH.Move(bvhProxy, WorldBounds());
+}
+
+glm::mat4 Model::transform() const
+{
+    return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+}
+
+void Model::uploadMaterial()
+{
+    if (!materialUploaded || material != uploadedMaterial)
     {
-        meshes[i].Mesh::Draw(shader, camera, translation, rotation, scale, material, textured, matricesMeshes[i]);
+        // Value-initialized so the std140 padding goes up as zeros
+        MaterialBlock block{};
+        block.albedo = material.albedo;
+        block.roughness = material.roughness;
+        block.metallic = material.metallic;
+        block.ao = material.ao;
+        materialUBO.Update(&block, sizeof(block));
+        uploadedMaterial = material;
+        materialUploaded = true;
     }
 }
 
+void Model::bindMaterial()
+{
+    uploadMaterial();
+    materialUBO.BindBase(MATERIAL_DATA_BINDING);
+}
+
 void Model::UI()
 {
     if (ImGui::CollapsingHeader(name.c_str()))
@@ -54,15 +298,19 @@ void Model::UI()
 
         // Position controls
         ImGui::Text("Transform");
-        ImGui::DragFloat3("Position", &translation[0], 0.1f);
+        bool moved = ImGui::DragFloat3("Position", &translation[0], 0.1f);
 
         // Rotation controls
         glm::vec3 euler = glm::degrees(glm::eulerAngles(rotation)); // Convert quaternion to Euler angles in degrees
         if (ImGui::DragFloat3("Rotation", &euler[0], 1.0f))
         {
             rotation = glm::quat(glm::radians(euler)); // Convert back to radians and quaternion
+            moved = true;
         }
-        ImGui::DragFloat3("Scale", &scale[0], 0.1f);
+        moved |= ImGui::DragFloat3("Scale", &scale[0], 0.1f);
+
+        if (moved)
+            UpdateBounds();
 
         // Color controls
         ImGui::Text("Material");
@@ -188,25 +436,79 @@ void Model::LoadImGuiData(const std::string &filename)
     }
 }
 
-void Model::loadMesh(unsigned int indMesh)
+void Model::loadMeshes()
+{
+    std::vector<MeshData> decoded(meshJobs.size());
+
+    ThreadPool::Shared().ParallelFor(meshJobs.size(), [&](size_t i)
+                                     { decoded[i] = decodePrimitive(meshJobs[i]); });
+
+    // GL objects can only be created on the thread that owns the context
+    for (unsigned int i = 0; i < meshJobs.size(); i++)
+    {
+        if (decoded[i].optimized)
+        {
+            const MeshOptimizerReport &report = decoded[i].report;
+            std::cout << name << " mesh " << i << ": " << report.verticesBefore << " -> " << report.verticesAfter
+                      << " vertices, ACMR " << report.before.acmr << " -> " << report.after.acmr
+                      << ", ATVR " << report.before.atvr << " -> " << report.after.atvr
+                      << (report.overdrawApplied ? ", overdraw order" : "") << ", " << report.milliseconds << " ms" << std::endl;
+        }
+        if (decoded[i].lods.size() > 1)
+        {
+            std::cout << name << " mesh " << i << " LODs:";
+            for (const MeshLOD &lod : decoded[i].lods)
+                std::cout << " " << lod.count / 3 << " (error " << lod.error << ")";
+            std::cout << std::endl;
+        }
+
+        std::vector<Texture> textures = getTextures();
+        meshes.push_back(Mesh(decoded[i].vertices, decoded[i].indices, textures, decoded[i].lods, vertexLayout));
+        meshes.back().bounds = decoded[i].bounds;
+
+        translationsMeshes.push_back(meshJobs[i].translation);
+        rotationsMeshes.push_back(meshJobs[i].rotation);
+        scalesMeshes.push_back(meshJobs[i].scale);
+        matricesMeshes.push_back(meshJobs[i].matrix);
+    }
+
+    meshJobs.clear();
+}
+
+Model::MeshData Model::decodePrimitive(const MeshJob &job) const
 {
-    unsigned int posAccInd = JSON["meshes"][indMesh]["primitives"][0]["attributes"]["POSITION"];
-    unsigned int normalAccInd = JSON["meshes"][indMesh]["primitives"][0]["attributes"]["NORMAL"];
-    unsigned int texAccInd = JSON["meshes"][indMesh]["primitives"][0]["attributes"]["TEXCOORD_0"];
-    unsigned int indAccInd = JSON["meshes"][indMesh]["primitives"][0]["indices"];
+    const json &gltf = JSON;
+    const json &primitive = gltf["meshes"][job.mesh]["primitives"][job.primitive];
 
-    std::vector<float> posVec = getFloats(JSON["accessors"][posAccInd]);
-    std::vector<glm::vec3> positions = groupFloatsVec3(posVec);
-    std::vector<float> normalVec = getFloats(JSON["accessors"][normalAccInd]);
-    std::vector<glm::vec3> normals = groupFloatsVec3(normalVec);
-    std::vector<float> texVec = getFloats(JSON["accessors"][texAccInd]);
-    std::vector<glm::vec2> texUVs = groupFloatsVec2(texVec);
+    AccessorView positions = getAccessor(primitive, "POSITION");
+    AccessorView normals = getAccessor(primitive, "NORMAL");
+    AccessorView texUVs = getAccessor(primitive, "TEXCOORD_0");
 
-    std::vector<Vertex> vertices = assembleVertices(positions, normals, texUVs);
-    std::vector<GLuint> indices = getIndices(JSON["accessors"][indAccInd]);
-    std::vector<Texture> textures = getTextures();
+    MeshData mesh;
+    mesh.vertices = assembleVertices(positions, normals, texUVs);
+    mesh.bounds = getBounds(primitive, mesh.vertices);
+    if (primitive.contains("indices"))
+    {
+        mesh.indices = getIndices(gltf["accessors"][(unsigned int)primitive["indices"]]);
+    }
+    else
+    {
+        // Non-indexed primitives draw their vertices in order
+        mesh.indices.resize(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.indices.size(); i++)
+            mesh.indices[i] = (GLuint)i;
+    }
 
-    meshes.push_back(Mesh(vertices, indices, textures));
+    // Only triangle lists can be reordered (glTF mode 4, the default)
+    bool triangles = !primitive.contains("mode") || (int)primitive["mode"] == 4;
+    if (optimizeMeshes && triangles && mesh.indices.size() % 3 == 0)
+    {
+        mesh.report = MeshOptimizer::Optimize(mesh.vertices, mesh.indices);
+        mesh.optimized = true;
+    }
+    if (triangles && mesh.indices.size() % 3 == 0)
+        MeshOptimizer::GenerateLODs(mesh.vertices, mesh.indices, mesh.lods, MAX_MESH_LODS);
+    return mesh;
 }
 
 void Model::traverseNode(unsigned int nextNode, glm::mat4 matrix)
@@ -261,12 +563,18 @@ void Model::traverseNode(unsigned int nextNode, glm::mat4 matrix)
 
     if (node.find("mesh") != node.end())
     {
-        translationsMeshes.push_back(translation);
-        rotationsMeshes.push_back(rotation);
-        scalesMeshes.push_back(scale);
-        matricesMeshes.push_back(matNextNode);
-
-        loadMesh(node["mesh"]);
+        unsigned int mesh = node["mesh"];
+        const json &primitives = JSON["meshes"][mesh]["primitives"];
+        for (unsigned int i = 0; i < primitives.size(); i++)
+        {
+            // Only triangle lists are supported (mode 4 is the default)
+            if (primitives[i].value("mode", 4) != 4)
+            {
+                std::cerr << name << ": skipping non-triangle primitive " << i << " of mesh " << mesh << std::endl;
+                continue;
+            }
+            meshJobs.push_back(MeshJob{mesh, i, translation, rotation, scale, matNextNode});
+        }
     }
 
     if (node.find("children") != node.end())
@@ -276,100 +584,114 @@ void Model::traverseNode(unsigned int nextNode, glm::mat4 matrix)
     }
 }
 
-std::vector<unsigned char> Model::getData()
+bool Model::parseGLB()
 {
-    std::string bytesText;
-    std::string uri = JSON["buffers"][0]["uri"];
+    const uint32_t glbMagic = 0x46546C67; // "glTF"
+    const uint32_t chunkJSON = 0x4E4F534A;
+    const uint32_t chunkBIN = 0x004E4942;
 
-    std::string fileStr = std::string(file);
-    std::string fileDirectory = fileStr.substr(0, fileStr.find_last_of('/') + 1);
-    bytesText = get_file_contents((fileDirectory + uri).c_str());
+    const unsigned char *bytes = source.Data();
+    size_t size = source.Size();
+
+    uint32_t magic;
+    if (size < 12 || (std::memcpy(&magic, bytes, 4), magic != glbMagic))
+        return false;
+
+    uint32_t length;
+    std::memcpy(&length, bytes + 8, 4);
+    if (length > size)
+        throw std::runtime_error(std::string("Truncated GLB file: ") + file);
 
-    std::vector<unsigned char> data(bytesText.begin(), bytesText.end());
-    return data;
+    bool hasJSON = false;
+    size_t offset = 12;
+    while (offset + 8 <= length)
+    {
+        uint32_t chunkLength, chunkType;
+        std::memcpy(&chunkLength, bytes + offset, 4);
+        std::memcpy(&chunkType, bytes + offset + 4, 4);
+        const unsigned char *chunk = bytes + offset + 8;
+        if (offset + 8 + chunkLength > length)
+            throw std::runtime_error(std::string("Corrupt GLB chunk in: ") + file);
+
+        if (chunkType == chunkJSON)
+        {
+            JSON = json::parse(chunk, chunk + chunkLength);
+            hasJSON = true;
+        }
+        else if (chunkType == chunkBIN && data == nullptr)
+        {
+            data = chunk;
+            dataSize = chunkLength;
+        }
+
+        // Chunks are 4-byte aligned
+        offset += 8 + ((chunkLength + 3) & ~3u);
+    }
+
+    if (!hasJSON)
+        throw std::runtime_error(std::string("GLB file has no JSON chunk: ") + file);
+    return true;
 }
 
-std::vector<float> Model::getFloats(json accessor)
+void Model::getData()
 {
-    std::vector<float> floatVec;
+    const json &buffer = JSON["buffers"][0];
+
+    // A buffer without a uri lives in the GLB BIN chunk, which parseGLB already found
+    if (buffer.find("uri") == buffer.end())
+    {
+        if (data == nullptr)
+            throw std::runtime_error(std::string("Buffer has no uri and no GLB BIN chunk: ") + file);
+        return;
+    }
 
-    unsigned int buffViewInd = accessor.value("bufferView", 1);
-    unsigned int count = accessor["count"];
-    unsigned int accByteOffset = accessor.value("byteOffset", 0);
-    std::string type = accessor["type"];
+    std::string uri = buffer["uri"];
+    if (uri.rfind("data:", 0) == 0)
+        throw std::runtime_error(std::string("Embedded data URIs are not supported: ") + file);
 
-    json bufferView = JSON["bufferViews"][buffViewInd];
-    unsigned int byteOffset = bufferView["byteOffset"];
+    std::string fileStr = std::string(file);
+    std::string fileDirectory = fileStr.substr(0, fileStr.find_last_of('/') + 1);
+    binFile = MappedFile(fileDirectory + uri);
 
-    unsigned int numPerVert;
-    if (type == "SCALAR")
-        numPerVert = 1;
-    else if (type == "VEC2")
-        numPerVert = 2;
-    else if (type == "VEC3")
-        numPerVert = 3;
-    else if (type == "VEC4")
-        numPerVert = 4;
-    else
-        throw std::invalid_argument("Type is invalid (not SCALAR, VEC2, VEC3, or VEC4)");
+    data = binFile.Data();
+    dataSize = binFile.Size();
+}
 
-    unsigned int beginningOfData = byteOffset + accByteOffset;
-    unsigned int lengthOfData = count * 4 * numPerVert;
-    for (unsigned int i = beginningOfData; i < beginningOfData + lengthOfData; i)
+AABB Model::getBounds(const json &primitive, const std::vector<Vertex> &vertices) const
+{
+    AABB bounds;
+    const json &accessor = JSON["accessors"][(unsigned int)primitive["attributes"]["POSITION"]];
+    if (accessor.contains("min") && accessor.contains("max") && accessor["min"].size() == 3 && accessor["max"].size() == 3)
     {
-        unsigned char bytes[] = {data[i++], data[i++], data[i++], data[i++]};
-        float value;
-        std::memcpy(&value, bytes, sizeof(float));
-        floatVec.push_back(value);
+        bounds.min = glm::vec3(accessor["min"][0], accessor["min"][1], accessor["min"][2]);
+        bounds.max = glm::vec3(accessor["max"][0], accessor["max"][1], accessor["max"][2]);
+        return bounds;
     }
 
-    return floatVec;
+    if (vertices.empty())
+        return bounds;
+    bounds.min = bounds.max = vertices[0].position;
+    for (const Vertex &vertex : vertices)
+        bounds.Expand(vertex.position);
+    return bounds;
 }
 
-std::vector<GLuint> Model::getIndices(json accessor)
+AccessorView Model::getAccessor(const json &primitive, const char *attribute) const
 {
-    std::vector<GLuint> indices;
-
-    unsigned int buffViewInd = accessor.value("bufferView", 0);
-    unsigned int count = accessor["count"];
-    unsigned int accByteOffset = accessor.value("byteOffset", 0);
-    unsigned int componentType = accessor["componentType"];
+    const json &attributes = primitive["attributes"];
+    if (attributes.find(attribute) == attributes.end())
+        return AccessorView();
 
-    json bufferView = JSON["bufferViews"][buffViewInd];
-    unsigned int byteOffset = bufferView["byteOffset"];
+    unsigned int accInd = attributes[attribute];
+    return AccessorView(JSON, JSON["accessors"][accInd], data, dataSize);
+}
 
-    unsigned int beginningOfData = byteOffset + accByteOffset;
-    if (componentType == 5125)
-    {
-        for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 4; i)
-        {
-            unsigned char bytes[] = {data[i++], data[i++], data[i++], data[i++]};
-            unsigned int value;
-            std::memcpy(&value, bytes, sizeof(unsigned int));
-            indices.push_back((GLuint)value);
-        }
-    }
-    else if (componentType == 5123)
-    {
-        for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 2; i)
-        {
-            unsigned char bytes[] = {data[i++], data[i++]};
-            unsigned short value;
-            std::memcpy(&value, bytes, sizeof(unsigned short));
-            indices.push_back((GLuint)value);
-        }
-    }
-    else if (componentType == 5122)
-    {
-        for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 2; i)
-        {
-            unsigned char bytes[] = {data[i++], data[i++]};
-            short value;
-            std::memcpy(&value, bytes, sizeof(short));
-            indices.push_back((GLuint)value);
-        }
-    }
+std::vector<GLuint> Model::getIndices(const json &accessor) const
+{
+    AccessorView view(JSON, accessor, data, dataSize);
 
+    std::vector<GLuint> indices(view.count);
+    view.CopyIndices(indices.data());
     return indices;
 }
 
@@ -383,62 +705,28 @@ std::vector<Texture> Model::getTextures()
         std::string normalPath = texFolder + "/normal.png";
         std::string armPath = texFolder + "/arm.png";
 
-        try
-        {
-            textures.push_back(Texture(albedoPath.c_str(), "albedo", 3));
-            textures.push_back(Texture(normalPath.c_str(), "normal", 4));
-            textures.push_back(Texture(armPath.c_str(), "arm", 5));
-        }
-        catch (const std::exception &e)
-        {
-            throw std::runtime_error(std::string("Failed to load texture: ") + e.what());
-        }
+        // Every mesh asks for the same three files, the cache decodes each of them once
+        textures.push_back(Texture(albedoPath.c_str(), "albedo", 3));
+        textures.push_back(Texture(normalPath.c_str(), "normal", 4));
+        textures.push_back(Texture(armPath.c_str(), "arm", 5));
     }
 
     return textures;
 }
 
 std::vector<Vertex> Model::assembleVertices(
-    std::vector<glm::vec3> positions,
-    std::vector<glm::vec3> normals,
-    std::vector<glm::vec2> texUVs)
+    const AccessorView &positions,
+    const AccessorView &normals,
+    const AccessorView &texUVs) const
 {
-    std::vector<Vertex> vertices;
-    for (int i = 0; i < positions.size(); i++)
-    {
-        vertices.push_back(
-            Vertex{
-                positions[i],
-                normals[i],
-                texUVs[i]});
-    }
+    std::vector<Vertex> vertices(positions.count);
+    if (vertices.empty())
+        return vertices;
+
+    positions.CopyFloats(&vertices[0].position.x, 3, sizeof(Vertex));
+    if (normals.count == positions.count)
+        normals.CopyFloats(&vertices[0].normal.x, 3, sizeof(Vertex));
+    if (texUVs.count == positions.count)
+        texUVs.CopyFloats(&vertices[0].texUV.x, 2, sizeof(Vertex));
     return vertices;
 }
-
-std::vector<glm::vec2> Model::groupFloatsVec2(std::vector<float> floatVec)
-{
-    std::vector<glm::vec2> vectors;
-    for (int i = 0; i < floatVec.size(); i)
-    {
-        vectors.push_back(glm::vec2(floatVec[i++], floatVec[i++]));
-    }
-    return vectors;
-}
-std::vector<glm::vec3> Model::groupFloatsVec3(std::vector<float> floatVec)
-{
-    std::vector<glm::vec3> vectors;
-    for (int i = 0; i < floatVec.size(); i)
-    {
-        vectors.push_back(glm::vec3(floatVec[i++], floatVec[i++], floatVec[i++]));
-    }
-    return vectors;
-}
-std::vector<glm::vec4> Model::groupFloatsVec4(std::vector<float> floatVec)
-{
-    std::vector<glm::vec4> vectors;
-    for (int i = 0; i < floatVec.size(); i)
-    {
-        vectors.push_back(glm::vec4(floatVec[i++], floatVec[i++], floatVec[i++], floatVec[i++]));
-    }
-    return vectors;
-}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "occlusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2 1
+#endif
+
+namespace
+{
+    // Edge function coefficients: A * x + B * y + C is positive on the inner side
+    struct Edge
+    {
+        float a, b, c;
+    };
+
+    Edge edge(const glm::vec3 &from, const glm::vec3 &to)
+    {
+        return {from.y - to.y, to.x - from.x, from.x * to.y - from.y * to.x};
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : width(width), height(height), stride((width + 3) & ~3)
+{
+    depth.resize((size_t)stride * height);
+    Clear();
+}
+
+void OcclusionBuffer::Clear()
+{
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    trianglesRasterized = 0;
+}
+
+void OcclusionBuffer::Rasterize(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices, GLuint firstIndex, GLsizei count, const glm::mat4 &objectToClip)
+{
+    for (GLsizei i = 0; i + 2 < count; i += 3)
+    {
+        glm::vec3 screen[3];
+        bool clipped = false;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            glm::vec4 clip = objectToClip * glm::vec4(vertices[indices[firstIndex + i + corner]].position, 1.0f);
+            // The GPU clips these away, so they must not hide anything either
+            if (clip.w <= 1e-5f || clip.z < -clip.w)
+            {
+                clipped = true;
+                break;
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            screen[corner] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+        }
+        if (clipped)
+            continue;
+
+        // Pixels whose centers the triangle may cover
+        int minX = std::max(0, (int)std::floor(std::min(screen[0].x, std::min(screen[1].x, screen[2].x))));
+        int maxX = std::min(width - 1, (int)std::ceil(std::max(screen[0].x, std::max(screen[1].x, screen[2].x))));
+        int minY = std::max(0, (int)std::floor(std::min(screen[0].y, std::min(screen[1].y, screen[2].y))));
+        int maxY = std::min(height - 1, (int)std::ceil(std::max(screen[0].y, std::max(screen[1].y, screen[2].y))));
+        if (minX > maxX || minY > maxY)
+            continue;
+
+        Edge e0 = edge(screen[1], screen[2]);
+        Edge e1 = edge(screen[2], screen[0]);
+        Edge e2 = edge(screen[0], screen[1]);
+        float area = e0.a * screen[0].x + e0.b * screen[0].y + e0.c;
+        if (std::abs(area) < 1e-8f)
+            continue;
+        // Both windings are occluders, flip clockwise ones so inside is positive
+        if (area < 0.0f)
+        {
+            for (Edge *e : {&e0, &e1, &e2})
+                *e = {-e->a, -e->b, -e->c};
+            area = -area;
+        }
+        // Window depth is affine in screen space, as a plane through the three corners
+        float dzdx = (e0.a * screen[0].z + e1.a * screen[1].z + e2.a * screen[2].z) / area;
+        float dzdy = (e0.b * screen[0].z + e1.b * screen[1].z + e2.b * screen[2].z) / area;
+        float z0 = (e0.c * screen[0].z + e1.c * screen[1].z + e2.c * screen[2].z) / area;
+        trianglesRasterized++;
+
+        int startX = minX & ~3;
+        for (int y = minY; y <= maxY; y++)
+        {
+            float py = y + 0.5f;
+            float *row = &depth[(size_t)y * stride];
+#ifdef OCCLUSION_SSE2
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+            for (int x = startX; x <= maxX; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e0.a), px), _mm_set1_ps(e0.b * py + e0.c));
+                __m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e1.a), px), _mm_set1_ps(e1.b * py + e1.c));
+                __m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e2.a), px), _mm_set1_ps(e2.b * py + e2.c));
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(dzdy * py + z0));
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+#else
+            for (int x = startX; x <= maxX; x++)
+            {
+                float px = x + 0.5f;
+                float w0 = e0.a * px + e0.b * py + e0.c;
+                float w1 = e1.a * px + e1.b * py + e1.c;
+                float w2 = e2.a * px + e2.b * py + e2.c;
+                float z = dzdx * px + dzdy * py + z0;
+                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+                    row[x] = std::min(row[x], z);
+            }
+#endif
+        }
+    }
+}
+
+bool OcclusionBuffer::Visible(const AABB &worldBox, const glm::mat4 &viewProjection) const
+{
+    glm::vec3 minScreen(1e30f), maxScreen(-1e30f);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 point((corner & 1) ? worldBox.max.x : worldBox.min.x, (corner & 2) ? worldBox.max.y : worldBox.min.y, (corner & 4) ? worldBox.max.z : worldBox.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+        // Crossing the near plane, nothing to compare against
+        if (clip.w <= 1e-5f)
+            return true;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec3 screen((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+        minScreen = glm::min(minScreen, screen);
+        maxScreen = glm::max(maxScreen, screen);
+    }
+
+    int minX = std::max(0, (int)std::floor(minScreen.x));
+    int maxX = std::min(width - 1, (int)std::floor(maxScreen.x));
+    int minY = std::max(0, (int)std::floor(minScreen.y));
+    int maxY = std::min(height - 1, (int)std::floor(maxScreen.y));
+    if (minX > maxX || minY > maxY)
+        return true;
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        const float *row = &depth[(size_t)y * stride];
+        for (int x = minX; x <= maxX; x++)
+            if (row[x] >= minScreen.z)
+                return true;
+    }
+    return false;
+}
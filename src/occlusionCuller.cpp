@@ -0,0 +1,235 @@
+#include "occlusionCuller.h"
+#include "indirectRenderer.h"
+
+#include <algorithm>
+
+OcclusionCuller::OcclusionCuller()
+{
+#ifdef GL_VERSION_4_3
+    if (!GLAD_GL_VERSION_4_3)
+        return;
+    program = std::make_unique<Shader>("res/shaders/occlusion.comp");
+    hiZ = std::make_unique<HiZPyramid>();
+    glGenBuffers(1, &boxBuffer);
+    glGenBuffers(1, &commandBuffer);
+    for (PendingResult &result : results)
+        glGenBuffers(1, &result.buffer);
+#endif
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    if (!program)
+        return;
+    glDeleteBuffers(1, &boxBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    for (PendingResult &result : results)
+    {
+        glDeleteBuffers(1, &result.buffer);
+        if (result.fence)
+            glDeleteSync(result.fence);
+    }
+}
+
+bool OcclusionCuller::GPUAvailable() const
+{
+    return program && program->Linked() && hiZ->Available();
+}
+
+void OcclusionCuller::Begin(const Camera &camera)
+{
+    readResults();
+    gpu = gpuTest && GPUAvailable();
+    viewProjection = camera.cameraMatrix;
+    occluders.clear();
+    candidates.clear();
+    if (!gpu)
+        software.Clear();
+
+    // Forget meshes not drawn for a while, destroyed ones never come back
+    const unsigned int forgetAfter = 256;
+    if (++passes % forgetAfter == 0)
+    {
+        for (auto entry = history.begin(); entry != history.end();)
+        {
+            if (passes - entry->second.pass > forgetAfter)
+                entry = history.erase(entry);
+            else
+                ++entry;
+        }
+    }
+}
+
+bool OcclusionCuller::Submit(void *owner, unsigned int index, const Mesh &mesh, unsigned int lod, const glm::mat4 &world)
+{
+    // Unknown meshes count as visible, the first frame draws everything in phase 0
+    History &entry = history[mesh.geometry.id];
+    entry.pass = passes;
+    AABB box = mesh.bounds.Transform(world);
+    if (!entry.visible)
+    {
+        candidates.push_back({owner, index, &mesh, lod, world, box, IndirectDraw()});
+        return false;
+    }
+
+    occluders.push_back({mesh.geometry.id, box});
+    if (!gpu)
+    {
+        const MeshLOD &level = mesh.lods[lod];
+        software.Rasterize(mesh.vertices, mesh.indices, level.firstIndex, level.count, viewProjection * world);
+    }
+    return true;
+}
+
+void OcclusionCuller::Culled(const Mesh &mesh)
+{
+    History &entry = history[mesh.geometry.id];
+    entry.visible = false;
+    entry.pass = passes;
+}
+
+void OcclusionCuller::Test()
+{
+    if (gpu)
+        testOnGPU();
+    else
+        testOnCPU();
+}
+
+void OcclusionCuller::testOnCPU()
+{
+    for (const Occluder &occluder : occluders)
+        history[occluder.id].visible = software.Visible(occluder.box, viewProjection);
+
+    size_t kept = 0;
+    for (const OcclusionCandidate &candidate : candidates)
+    {
+        bool visible = software.Visible(candidate.box, viewProjection);
+        history[candidate.mesh->geometry.id].visible = visible;
+        if (visible)
+            candidates[kept++] = candidate;
+        else
+            RenderStats::frame.meshesOccluded++;
+    }
+    candidates.resize(kept);
+}
+
+void OcclusionCuller::testOnGPU()
+{
+#ifdef GL_VERSION_4_3
+    size_t count = candidates.size() + occluders.size();
+    if (count == 0)
+        return;
+    hiZ->Build();
+
+    PendingResult &result = results[resultSlot];
+    result.meshes.clear();
+    result.candidates = candidates.size();
+    std::vector<OcclusionBox> boxes;
+    boxes.reserve(count);
+    std::vector<DrawElementsIndirectCommand> commands;
+    commands.reserve(candidates.size());
+    for (OcclusionCandidate &candidate : candidates)
+    {
+        const Mesh &mesh = *candidate.mesh;
+        const MeshLOD &level = mesh.lods[candidate.lod];
+        // Commands count in indices from the start of the arena's index buffer, instanceCount is the shader's
+        size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        GLuint firstIndex = (GLuint)(mesh.geometry.indexOffset / indexSize) + level.firstIndex;
+        candidate.indirect = {commandBuffer, commands.size() * sizeof(DrawElementsIndirectCommand)};
+        commands.push_back({(GLuint)level.count, 0u, firstIndex, mesh.geometry.baseVertex, 0u});
+        boxes.push_back({glm::vec4(candidate.box.Center(), 0.0f), glm::vec4(candidate.box.Extents(), 0.0f)});
+        result.meshes.push_back({mesh.geometry.id, (unsigned int)level.count / 3, candidate.lod});
+    }
+    for (const Occluder &occluder : occluders)
+    {
+        boxes.push_back({glm::vec4(occluder.box.Center(), 0.0f), glm::vec4(occluder.box.Extents(), 0.0f)});
+        result.meshes.push_back({occluder.id, 0u, 0u});
+    }
+
+    // Orphaned every pass, earlier draws may still be reading the old storage. A result still in flight after
+    // a full ring is given up on rather than waited for.
+    if (result.fence)
+    {
+        glDeleteSync(result.fence);
+        result.fence = nullptr;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boxBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, boxes.size() * sizeof(OcclusionBox), boxes.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(commands.size(), 1) * sizeof(DrawElementsIndirectCommand), commands.empty() ? nullptr : commands.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, result.buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUSION_BOX_BINDING, boxBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUSION_COMMAND_BINDING, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUSION_RESULT_BINDING, result.buffer);
+
+    program->Activate();
+    glUniform1ui(program->Uniform("boxCount"), (GLuint)count);
+    glUniform1ui(program->Uniform("candidateCount"), (GLuint)candidates.size());
+    program->SetMat4(program->Uniform("viewProjection"), viewProjection);
+    hiZ->Bind(*program);
+    glDispatchCompute((GLuint)((count + 63) / 64), 1, 1);
+    // The phase 1 draws read the commands as indirect arguments
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    result.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    resultSlot = (resultSlot + 1) % RESULT_BUFFERS;
+#endif
+}
+
+void OcclusionCuller::readResults()
+{
+#ifdef GL_VERSION_4_3
+    // The slot written next is the oldest, tests finish in order so the first unfinished one ends the scan
+    for (int i = 0; i < RESULT_BUFFERS; i++)
+    {
+        PendingResult &result = results[(resultSlot + i) % RESULT_BUFFERS];
+        if (!result.fence)
+            continue;
+        GLenum status = glClientWaitSync(result.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(result.fence);
+        result.fence = nullptr;
+
+        std::vector<GLuint> visible(result.meshes.size());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, result.buffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, visible.size() * sizeof(GLuint), visible.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        for (size_t mesh = 0; mesh < result.meshes.size(); mesh++)
+        {
+            const TestedMesh &tested = result.meshes[mesh];
+            auto entry = history.find(tested.id);
+            if (entry != history.end())
+                entry->second.visible = visible[mesh] != 0;
+            if (mesh >= result.candidates)
+                continue;
+            // What the phase 1 draws turned out to do, Mesh::DrawElements only counted the calls
+            if (visible[mesh])
+            {
+                RenderStats::frame.meshesDrawn++;
+                RenderStats::frame.instances++;
+                RenderStats::frame.triangles += tested.triangles;
+                RenderStats::frame.lodDraws[tested.lod]++;
+            }
+            else
+            {
+                RenderStats::frame.meshesOccluded++;
+            }
+        }
+    }
+#endif
+}
+
+void OcclusionCuller::UI()
+{
+    ImGui::Checkbox("Occlusion culling (scene)", &enabled);
+    if (GPUAvailable())
+        ImGui::Checkbox("GPU occlusion test", &gpuTest);
+    if (gpu)
+        ImGui::Text("Scene occlusion: Hi-Z %d x %d, %zu candidates", hiZ->Size().x, hiZ->Size().y, candidates.size());
+    else
+        ImGui::Text("Scene occlusion: software %d x %d, %zu occluder triangles", software.Width(), software.Height(), software.TrianglesRasterized());
+}
@@ -0,0 +1,104 @@
+#include "renderQueue.h"
+#include "uniformBlocks.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Keeps the low 'bits' of an id, so ids that share them only cost extra state changes, never wrong state
+    uint64_t field(uint64_t value, int bits, int shift)
+    {
+        return (value & ((1ull << bits) - 1)) << shift;
+    }
+
+    bool sameTextures(const Mesh *a, const Mesh *b)
+    {
+        if (a->textures.size() != b->textures.size())
+            return false;
+        for (size_t i = 0; i < a->textures.size(); i++)
+        {
+            if (a->textures[i].ID != b->textures[i].ID)
+                return false;
+        }
+        return true;
+    }
+}
+
+void RenderQueue::Submit(Shader &shader, Mesh &mesh, UBO *material, const glm::mat4 &model, bool textured, const Camera &camera, unsigned int lod, const IndirectDraw &indirect)
+{
+    // Opaque geometry, so nearer draws go first within a state group to help early depth rejection
+    float distance = glm::length(glm::vec3(model[3]) - camera.Position);
+    uint64_t depth = (uint64_t)(std::min(distance / maxDepth, 1.0f) * 65535.0f);
+    GLuint textureID = mesh.textures.empty() ? 0 : mesh.textures[0].ID;
+
+    DrawPacket packet;
+    packet.key = field(shader.ID, 8, 56) |
+                 field(textureID, 12, 44) |
+                 field(material ? material->ID : 0, 12, 32) |
+                 field(mesh.arena->VertexArray(shader.PositionOnly()).ID, 16, 16) |
+                 depth;
+    packet.shader = &shader;
+    packet.mesh = &mesh;
+    packet.material = material;
+    packet.model = model;
+    packet.textured = textured;
+    packet.lod = lod;
+    packet.indirect = indirect;
+
+    order.emplace_back(packet.key, (uint32_t)packets.size());
+    packets.push_back(packet);
+}
+
+void RenderQueue::Flush(Camera &camera)
+{
+    std::sort(order.begin(), order.end());
+
+    // What is bound right now, anything not set here is reset by the first packet
+    Shader *shader = nullptr;
+    const Mesh *texturedMesh = nullptr;
+    UBO *material = nullptr;
+    GLuint vao = 0;
+    int textured = -1;
+
+    for (const std::pair<uint64_t, uint32_t> &entry : order)
+    {
+        DrawPacket &packet = packets[entry.second];
+
+        if (packet.shader != shader)
+        {
+            shader = packet.shader;
+            shader->Activate();
+            shader->SetVec3(shader->uniforms.camPos, camera.Position);
+            camera.Matrix(*shader);
+            // Uniforms are per program, so the sampler and 'textured' values need setting again
+            texturedMesh = nullptr;
+            textured = -1;
+        }
+        if ((int)packet.textured != textured)
+        {
+            textured = packet.textured;
+            shader->SetInt(shader->uniforms.textured, textured);
+        }
+        if (!shader->PositionOnly() && (texturedMesh == nullptr || !sameTextures(texturedMesh, packet.mesh)))
+        {
+            packet.mesh->BindTextures(*shader);
+            texturedMesh = packet.mesh;
+        }
+        if (packet.material != material && packet.material != nullptr)
+        {
+            material = packet.material;
+            material->BindBase(MATERIAL_DATA_BINDING);
+        }
+        VAO &vertexArray = packet.mesh->arena->VertexArray(shader->PositionOnly());
+        if (vertexArray.ID != vao)
+        {
+            vertexArray.Bind();
+            vao = vertexArray.ID;
+        }
+
+        packet.mesh->DrawElements(*shader, packet.model, packet.lod, packet.indirect);
+    }
+
+    packets.clear();
+    order.clear();
+}
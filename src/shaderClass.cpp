@@ -1,4 +1,9 @@
 #include "shaderClass.h"
+#include "uniformBlocks.h"
+#include "renderStats.h"
+#include "lightClusters.h"
+
+#include <set>
 
 // Reads a text file and outputs a string with everything in the text file
 std::string get_file_contents(const char *filename)
@@ -17,12 +22,43 @@ std::string get_file_contents(const char *filename)
     throw(errno);
 }
 
+static std::string resolveIncludes(const std::string &path, std::set<std::string> &included)
+{
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::istringstream in(get_file_contents(path.c_str()));
+    std::string result;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+        {
+            size_t open = line.find('"', start);
+            size_t close = line.find('"', open + 1);
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            // Each file is pasted once, so headers need no guards
+            if (included.insert(includePath).second)
+                result += resolveIncludes(includePath, included);
+            continue;
+        }
+        result += line + "\n";
+    }
+    return result;
+}
+
+// Reads a shader source file, replacing #include "file" lines with their contents
+std::string get_shader_source(const char *filename)
+{
+    std::set<std::string> included = {filename};
+    return resolveIncludes(filename, included);
+}
+
 // Constructor that build the Shader Program from 2 different shaders
 Shader::Shader(const char *vertexFile, const char *fragmentFile)
 {
     // Read vertexFile and fragmentFile and store the strings
-    std::string vertexCode = get_file_contents(vertexFile);
-    std::string fragmentCode = get_file_contents(fragmentFile);
+    std::string vertexCode = get_shader_source(vertexFile);
+    std::string fragmentCode = get_shader_source(fragmentFile);
 
     // Convert the shader source strings into character arrays
     const char *vertexSource = vertexCode.c_str();
@@ -59,12 +95,42 @@ Shader::Shader(const char *vertexFile, const char *fragmentFile)
     // Delete the now useless Vertex and Fragment Shader objects
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+
+    // Resolve all uniform locations once so drawing never has to query the driver
+    reflect();
+    bindUniformBlocks();
+}
+
+Shader::Shader(const char *computeFile)
+{
+    ID = 0;
+#ifdef GL_VERSION_4_3
+    std::string computeCode = get_shader_source(computeFile);
+    const char *computeSource = computeCode.c_str();
+
+    GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(computeShader, 1, &computeSource, NULL);
+    glCompileShader(computeShader);
+    compileErrors(computeShader, "COMPUTE");
+
+    ID = glCreateProgram();
+    glAttachShader(ID, computeShader);
+    glLinkProgram(ID);
+    compileErrors(ID, "PROGRAM");
+    glDeleteShader(computeShader);
+
+    reflect();
+    bindUniformBlocks();
+#else
+    std::cout << "Compute shaders need GL 4.3: " << computeFile << std::endl;
+#endif
 }
 
 // Activates the Shader Program
 void Shader::Activate()
 {
     glUseProgram(ID);
+    RenderStats::frame.programSwitches++;
 }
 
 // Deletes the Shader Program
@@ -73,6 +139,139 @@ void Shader::Delete()
     glDeleteProgram(ID);
 }
 
+bool Shader::Linked() const
+{
+    if (ID == 0)
+        return false;
+    GLint linked = GL_FALSE;
+    glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+GLint Shader::Uniform(const std::string &name) const
+{
+    auto it = uniformLocations.find(name);
+    return it == uniformLocations.end() ? -1 : it->second;
+}
+
+GLint Shader::Attribute(const std::string &name) const
+{
+    auto it = attributeLocations.find(name);
+    return it == attributeLocations.end() ? -1 : it->second;
+}
+
+void Shader::SetInt(GLint location, int value)
+{
+    if (location != -1)
+        glUniform1i(location, value);
+}
+
+void Shader::SetFloat(GLint location, float value)
+{
+    if (location != -1)
+        glUniform1f(location, value);
+}
+
+void Shader::SetVec3(GLint location, const glm::vec3 &value)
+{
+    if (location != -1)
+        glUniform3f(location, value.x, value.y, value.z);
+}
+
+void Shader::SetMat4(GLint location, const glm::mat4 &value)
+{
+    if (location != -1)
+        glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::reflect()
+{
+    GLint count = 0;
+    GLint maxLength = 0;
+    GLint size;
+    GLenum type;
+
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> nameBuffer(maxLength + 1);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+
+        // Uniforms inside blocks have no location
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        if (location == -1)
+            continue;
+
+        // Arrays are reported as "name[0]", the remaining elements follow consecutively
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            std::string base = name.substr(0, name.size() - 3);
+            for (GLint element = 0; element < size; element++)
+                uniformLocations[base + "[" + std::to_string(element) + "]"] = location + element;
+            uniformLocations[base] = location;
+        }
+        else
+        {
+            uniformLocations[name] = location;
+        }
+    }
+
+    glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    nameBuffer.assign(maxLength + 1, 0);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        glGetActiveAttrib(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+        attributeLocations[name] = glGetAttribLocation(ID, name.c_str());
+    }
+    positionOnly = Attribute("aPos") != -1 && Attribute("aNormal") == -1 && Attribute("aTex") == -1;
+
+    uniforms.camMatrix = Uniform("camMatrix");
+    uniforms.viewPos = Uniform("viewPos");
+    uniforms.camPos = Uniform("camPos");
+    uniforms.model = Uniform("model");
+    uniforms.textured = Uniform("textured");
+    uniforms.albedoMap = Uniform("albedoMap");
+    uniforms.normalMap = Uniform("normalMap");
+    uniforms.armMap = Uniform("armMap");
+    uniforms.view = Uniform("view");
+    uniforms.projection = Uniform("projection");
+}
+
+void Shader::bindUniformBlocks()
+{
+    GLuint frameIndex = glGetUniformBlockIndex(ID, "FrameData");
+    if (frameIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, frameIndex, FRAME_DATA_BINDING);
+
+    GLuint materialIndex = glGetUniformBlockIndex(ID, "MaterialData");
+    if (materialIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, materialIndex, MATERIAL_DATA_BINDING);
+
+    GLuint irradianceIndex = glGetUniformBlockIndex(ID, "IrradianceData");
+    if (irradianceIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, irradianceIndex, IRRADIANCE_DATA_BINDING);
+
+    // The light cluster buffers sit on fixed units as well, a sampler left on unit 0 would clash with the skybox
+    GLint lightsLocation = glGetUniformLocation(ID, "pointLights");
+    GLint clustersLocation = glGetUniformLocation(ID, "lightClusters");
+    GLint indicesLocation = glGetUniformLocation(ID, "lightIndices");
+    if (lightsLocation < 0 && clustersLocation < 0 && indicesLocation < 0)
+        return;
+    GLint previous = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+    glUseProgram(ID);
+    glUniform1i(lightsLocation, POINT_LIGHT_TEXTURE_UNIT);
+    glUniform1i(clustersLocation, LIGHT_CLUSTER_TEXTURE_UNIT);
+    glUniform1i(indicesLocation, LIGHT_INDEX_TEXTURE_UNIT);
+    glUseProgram(previous);
+}
+
 // Checks if the different Shaders have compiled properly
 void Shader::compileErrors(unsigned int shader, const char *type)
 {
@@ -0,0 +1,100 @@
+#include "shadingBenchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+ShadingBenchmark::ShadingBenchmark(const std::vector<int> &lightCounts, const std::vector<int> &overdrawLayers)
+{
+    for (int lightCount : lightCounts)
+    {
+        for (int layers : overdrawLayers)
+        {
+            cases.push_back({lightCount, layers, false, false});
+            cases.push_back({lightCount, layers, false, true});
+            cases.push_back({lightCount, layers, true, false});
+        }
+    }
+    glGenQueries(1, &query);
+}
+
+ShadingBenchmark::~ShadingBenchmark()
+{
+    glDeleteQueries(1, &query);
+}
+
+void ShadingBenchmark::Setup()
+{
+    if (Done())
+        return;
+    const ShadingCase &shadingCase = cases[current];
+
+    // Same seed every run, and the first N lights are the same for every N
+    std::mt19937 random(7 + (unsigned)lights.size());
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    while ((int)lights.size() < shadingCase.lights)
+    {
+        lights.emplace_back(new Light("res/models/Shapes/icosphere.gltf", "Benchmark light " + std::to_string(lights.size()), "Point"));
+        Light &light = *lights.back();
+        light.translation = glm::vec3(unit(random) * 8.0f - 4.0f, unit(random) * 5.0f - 2.5f, unit(random) * 2.0f - 1.0f);
+        light.material.albedo = glm::vec3(unit(random), unit(random), unit(random)) * 0.5f;
+        light.quadratic = 8.0f + unit(random) * 16.0f;
+    }
+    for (size_t i = 0; i < lights.size(); i++)
+        lights[i]->display = (int)i < shadingCase.lights;
+
+    // Walls between the lights and the far end, the camera starts 2 units in front of the first
+    while ((int)walls.size() < shadingCase.layers)
+    {
+        walls.emplace_back(new Model("res/models/Shapes/cube.gltf", "Benchmark wall " + std::to_string(walls.size()), false));
+        walls.back()->translation = glm::vec3(0.0f, 0.0f, -1.5f - 0.25f * walls.size());
+        walls.back()->scale = glm::vec3(6.0f, 4.0f, 0.02f);
+    }
+}
+
+void ShadingBenchmark::DrawLayers(Shader &shader, Camera &camera)
+{
+    if (Done())
+        return;
+    for (int i = cases[current].layers - 1; i >= 0; i--)
+        walls[i]->Draw(shader, camera);
+}
+
+void ShadingBenchmark::BeginFrame()
+{
+    if (!Done() && frame >= warmupFrames)
+        glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void ShadingBenchmark::EndFrame()
+{
+    if (Done())
+        return;
+    if (frame >= warmupFrames)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        // Waits for the GPU, fine while benchmarking
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        timedMs += nanoseconds / 1e6;
+    }
+    if (++frame < framesPerCase)
+        return;
+
+    cases[current].gpuMs = timedMs / std::max(framesPerCase - warmupFrames, 1);
+    frame = 0;
+    timedMs = 0.0;
+    current++;
+}
+
+void ShadingBenchmark::Report(std::ostream &out) const
+{
+    char line[128];
+    out << "Scene pass GPU ms per frame" << std::endl;
+    out << "lights  layers   forward   prepass  deferred" << std::endl;
+    for (size_t i = 0; i + 2 < cases.size(); i += 3)
+    {
+        std::snprintf(line, sizeof(line), "%6d  %6d  %8.3f  %8.3f  %8.3f", cases[i].lights, cases[i].layers, cases[i].gpuMs, cases[i + 1].gpuMs, cases[i + 2].gpuMs);
+        out << line << std::endl;
+    }
+}
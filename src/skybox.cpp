@@ -1,19 +1,59 @@
 #include "Skybox.h"
+#include "uniformBlocks.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <stb_image.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+namespace
+{
+    // Kinds of background swap steps, each keeps its own cost estimate
+    enum SwapStepKind
+    {
+        STEP_UPLOAD,
+        STEP_CUBEMAP_FACE,
+        STEP_PREFILTER_FACE,
+        STEP_MIPMAPS,
+        STEP_READBACK,
+        STEP_READBACK_COPY,
+        STEP_BRDF,
+        STEP_FINISH,
+        SWAP_STEP_KINDS
+    };
+
+    // Smoothing of the per kind cost estimates
+    const float STEP_COST_BLEND = 0.25f;
+
+    void blendCost(float &estimate, float measured)
+    {
+        estimate = estimate == 0.0f ? measured : estimate + (measured - estimate) * STEP_COST_BLEND;
+    }
+}
+
 Skybox::Skybox(const std::string &hdrPath)
-    : equirectangularToCubemapShader("res/shaders/cubemap.vs", "res/shaders/equirectangular_to_cubemap.frag"),
-      irradianceShader("res/shaders/cubemap.vs", "res/shaders/irradiance.frag"),
+    : hdrPath(hdrPath),
+      equirectangularToCubemapShader("res/shaders/cubemap.vs", "res/shaders/equirectangular_to_cubemap.frag"),
       prefilterShader("res/shaders/cubemap.vs", "res/shaders/pre-filter.frag"),
       brdfShader("res/shaders/brdf.vs", "res/shaders/brdf.frag"),
       backgroundShader("res/shaders/skybox.vs", "res/shaders/skybox.frag"),
-      cubeMap("res/models/Shapes/cube.gltf", "cubemap", false)
+      cubeMap("res/models/Shapes/cube.gltf", "cubemap", false),
+      irradianceUBO(sizeof(IrradianceBlock)),
+      stepCpuMs(SWAP_STEP_KINDS, 0.0f),
+      stepGpuMs(SWAP_STEP_KINDS, 0.0f)
 {
+    std::strncpy(pathInput, hdrPath.c_str(), sizeof(pathInput) - 1);
+
+    // The cube is drawn around the camera with its own matrices, so world space culling doesn't apply
+    cubeMap.frustumCulling = false;
+    cubeMap.levelOfDetail = false;
+
     backgroundShader.Activate();
-    glUniform1i(glGetUniformLocation(backgroundShader.ID, "environmentMap"), 0);
+    backgroundShader.SetInt(backgroundShader.Uniform("environmentMap"), 0);
 
     // Initialize FBO and RBO
     glGenFramebuffers(1, &captureFBO);
@@ -21,10 +61,30 @@ Skybox::Skybox(const std::string &hdrPath)
 
     glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 2048, 2048);
+    setCaptureSize(IBL_ENVIRONMENT_SIZE);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(1, &uploadPBO);
+    glGenBuffers(2, readbackPBOs);
+
+    // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
+    // ----------------------------------------------------------------------------------------------
+    captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+    captureViews[0] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    captureViews[1] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    captureViews[2] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    captureViews[3] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+    captureViews[4] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    captureViews[5] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+}
 
-    LoadHDR(hdrPath);
+Skybox::~Skybox()
+{
+    if (decodeJob.valid())
+        decodeJob.wait();
+    if (saveJob.valid())
+        saveJob.wait();
 }
 
 void Skybox::LoadHDR(const std::string &hdrPath)
@@ -52,161 +112,631 @@ void Skybox::LoadHDR(const std::string &hdrPath)
 
 void Skybox::Init(Camera &camera)
 {
-    SetupCubemap(camera);
-    SetupIrradiance(camera);
-    SetupPrefilter(camera);
-    SetupBRDF(camera);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // The LUT only depends on the BRDF, so one bake serves every environment
+    bool brdfCached = loadBRDF();
+    if (!brdfCached)
+    {
+        SetupBRDF(camera);
+        saveBRDF();
+    }
+
+    uint64_t key = environmentKey();
+    bool environmentCached = loadEnvironment(key);
+    if (!environmentCached)
+    {
+        LoadHDR(hdrPath);
+        SetupCubemap(camera);
+        SetupPrefilter(camera);
+        saveEnvironment(key);
+    }
+    UpdateIrradiance();
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "IBL ready in " << elapsed.count() << " ms (environment " << (environmentCached ? "cached" : "baked")
+              << ", BRDF LUT " << (brdfCached ? "cached" : "baked") << ")" << std::endl;
+}
+
+uint64_t Skybox::environmentKey() const
+{
+    return IBLCache::EnvironmentKey(hdrPath);
+}
+
+bool Skybox::loadEnvironment(uint64_t key)
+{
+    std::vector<CachedTexture> textures;
+    if (!IBLCache::Read(cacheFolder + IBLCache::EnvironmentFile(key), key, textures) || textures.size() != 2)
+        return false;
+
+    envCubemap = textures[0].ID;
+    prefilterMap = textures[1].ID;
+
+    // Only the base level of the environment is stored, rebuild its chain like SetupCubemap does
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 1000);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    setCubemapFilters(envCubemap);
+    setCubemapFilters(prefilterMap);
+    return true;
+}
+
+void Skybox::saveEnvironment(uint64_t key)
+{
+    std::vector<CachedTexture> textures(2);
+    textures[0] = {envCubemap, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, IBL_ENVIRONMENT_SIZE, 1};
+    textures[1] = {prefilterMap, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS};
+
+    IBLCache::Write(cacheFolder + IBLCache::EnvironmentFile(key), key, textures);
+}
+
+bool Skybox::loadBRDF()
+{
+    std::vector<CachedTexture> textures;
+    if (!IBLCache::Read(cacheFolder + "brdf_lut.cache", IBL_CACHE_VERSION, textures) || textures.size() != 1)
+        return false;
+
+    brdfLUTTexture = textures[0].ID;
+    glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+void Skybox::saveBRDF()
+{
+    std::vector<CachedTexture> textures = {{brdfLUTTexture, GL_TEXTURE_2D, GL_RG16F, GL_RG, IBL_BRDF_SIZE, 1}};
+    IBLCache::Write(cacheFolder + "brdf_lut.cache", IBL_CACHE_VERSION, textures);
 }
 
 void Skybox::Render(Camera &camera)
 {
+    // Nothing to show until the first environment is ready
+    if (envCubemap == 0)
+        return;
+
     glDepthFunc(GL_LEQUAL);
 
     backgroundShader.Activate();
-    glUniformMatrix4fv(glGetUniformLocation(backgroundShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(camera.view));
+    backgroundShader.SetMat4(backgroundShader.uniforms.projection, camera.projection);
+    backgroundShader.SetMat4(backgroundShader.uniforms.view, camera.view);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    // glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
     // glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
     cubeMap.Draw(backgroundShader, camera);
 
     glDepthFunc(GL_LESS);
 }
 
-void Skybox::SetupCubemap(Camera &camera)
+void Skybox::UpdateIrradiance()
 {
-    // Convert HDR to cubemap
-    glGenTextures(1, &envCubemap);
+    // Read back the small mip instead of convolving a cubemap on the GPU, the projection itself takes microseconds
+    GLint level = 0;
+    while ((IBL_ENVIRONMENT_SIZE >> level) > IBL_SH_SOURCE_SIZE)
+        level++;
+    size_t faceFloats = (size_t)IBL_SH_SOURCE_SIZE * IBL_SH_SOURCE_SIZE * 3;
+    std::vector<float> pixels(faceFloats * 6);
+    const float *faces[6];
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
     glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     for (unsigned int i = 0; i < 6; ++i)
     {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 2048, 2048, 0, GL_RGB, GL_FLOAT, nullptr);
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGB, GL_FLOAT, &pixels[faceFloats * i]);
+        faces[i] = &pixels[faceFloats * i];
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
 
-    // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
-    // ----------------------------------------------------------------------------------------------
-    glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
-    glm::mat4 captureViews[] =
+    irradiance = SH9::ProjectCubemap(faces, IBL_SH_SOURCE_SIZE, ThreadPool::Shared());
+    irradiance.ConvolveCosine();
+
+    IrradianceBlock block;
+    for (int i = 0; i < 9; i++)
+        block.sh[i] = glm::vec4(irradiance.coefficients[i], 0.0f);
+    irradianceUBO.Update(&block, sizeof(block));
+    irradianceUBO.BindBase(IRRADIANCE_DATA_BINDING);
+}
+
+bool Skybox::RequestEnvironment(const std::string &path)
+{
+    if (swapState != SwapState::Idle)
+        return false;
+
+    swapPath = path;
+    swapError.clear();
+    swapState = SwapState::Decoding;
+    swapStart = std::chrono::high_resolution_clock::now();
+    lastUpdate = swapStart;
+    worstSwapFrameMs = 0.0f;
+    decodeJob = ThreadPool::Shared().Submit([this]()
+                                            { decodeEnvironment(); });
+    return true;
+}
+
+void Skybox::decodeEnvironment()
+{
+    // Runs on a worker, only fills the swap* results
+    swapKey = IBLCache::EnvironmentKey(swapPath);
+    decodeError.clear();
+    swapTextures.clear();
+    swapPixels.clear();
+    swapHDR.clear();
+    try
+    {
+        swapFile = MappedFile(cacheFolder + IBLCache::EnvironmentFile(swapKey));
+        uint64_t storedKey;
+        if (IBLCache::Parse(swapFile.Data(), swapFile.Size(), storedKey, swapTextures, swapPixels) && storedKey == swapKey && swapTextures.size() == 2)
+            return;
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+    swapFile = MappedFile();
+    swapTextures.clear();
+    swapPixels.clear();
+
+    // The flip flag is per thread here, so this doesn't race with loaders on other workers
+    stbi_set_flip_vertically_on_load_thread(true);
+    int components;
+    float *data = stbi_loadf(swapPath.c_str(), &swapWidth, &swapHeight, &components, 3);
+    if (!data)
+    {
+        decodeError = "Failed to load HDR image " + swapPath;
+        return;
+    }
+    swapHDR.assign(data, data + (size_t)swapWidth * swapHeight * 3);
+    stbi_image_free(data);
+}
+
+void Skybox::Update(Camera &camera)
+{
+    if (swapState == SwapState::Idle)
+        return;
+
+    auto now = std::chrono::high_resolution_clock::now();
+    worstSwapFrameMs = std::max(worstSwapFrameMs, std::chrono::duration<float, std::milli>(now - lastUpdate).count());
+    lastUpdate = now;
+
+    if (swapState == SwapState::Decoding)
+    {
+        if (decodeJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        decodeJob.get();
+        swapError = decodeError;
+        if (!swapError.empty())
         {
-            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
-            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))};
+            std::cerr << swapError << std::endl;
+            swapState = SwapState::Idle;
+            return;
+        }
+        queueSwapSteps();
+        swapState = SwapState::Baking;
+    }
 
-    // pbr: convert HDR equirectangular environment map to cubemap equivalent
-    // ----------------------------------------------------------------------
-    equirectangularToCubemapShader.Activate();
-    glUniform1i(glGetUniformLocation(equirectangularToCubemapShader.ID, "equirectangularMap"), 0);
-    glUniformMatrix4fv(glGetUniformLocation(equirectangularToCubemapShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrTexture);
+    pollStepQueries();
 
-    glViewport(0, 0, 2048, 2048); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
+    // The passes below change the framebuffer and viewport, put them back for the frame
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    float spent = 0.0f;
+    while (!swapSteps.empty())
     {
-        glUniformMatrix4fv(glGetUniformLocation(equirectangularToCubemapShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Postponed steps stay at the front for the next frame
+        SwapStep &next = swapSteps.front();
+        float estimate = stepCpuMs[next.kind] + stepGpuMs[next.kind];
+        if ((spent > 0.0f && spent + estimate > swapBudgetMs) || (next.ready && !next.ready()))
+            break;
+        SwapStep step = std::move(next);
+        swapSteps.pop_front();
+
+        GLuint query;
+        if (freeQueries.empty())
+        {
+            glGenQueries(1, &query);
+        }
+        else
+        {
+            query = freeQueries.back();
+            freeQueries.pop_back();
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        step.run(camera);
+        glEndQuery(GL_TIME_ELAPSED);
+        float cpuMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 
-        cubeMap.Draw(equirectangularToCubemapShader, camera);
+        blendCost(stepCpuMs[step.kind], cpuMs);
+        pendingQueries.emplace_back(query, step.kind);
+        // GPU time of this step is not known yet, charge the estimate
+        spent += cpuMs + stepGpuMs[step.kind];
     }
+
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 }
 
-void Skybox::SetupIrradiance(Camera &camera)
+void Skybox::pollStepQueries()
 {
-    glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-    for (unsigned int i = 0; i < 6; ++i)
+    // Results come back in submission order, stop at the first one still in flight
+    size_t done = 0;
+    for (; done < pendingQueries.size(); done++)
     {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
+        GLint available = 0;
+        glGetQueryObjectiv(pendingQueries[done].first, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(pendingQueries[done].first, GL_QUERY_RESULT, &nanoseconds);
+        blendCost(stepGpuMs[pendingQueries[done].second], nanoseconds / 1e6f);
+        freeQueries.push_back(pendingQueries[done].first);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    pendingQueries.erase(pendingQueries.begin(), pendingQueries.begin() + done);
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
+void Skybox::queueSwapSteps()
+{
+    swapSteps.clear();
+    swapReadback.clear();
+    bool cached = !swapTextures.empty();
 
-    // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
-    // -----------------------------------------------------------------------------
-    irradianceShader.Activate();
-    glUniform1i(glGetUniformLocation(irradianceShader.ID, "environmentMap"), 0);
-    glUniformMatrix4fv(glGetUniformLocation(irradianceShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    if (brdfLUTTexture == 0 && !loadBRDF())
+    {
+        swapSteps.push_back({STEP_BRDF, [this](Camera &camera)
+                             {
+                                 SetupBRDF(camera);
+                                 saveBRDF();
+                             }});
+    }
 
-    glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
+    if (cached)
     {
-        glUniformMatrix4fv(glGetUniformLocation(irradianceShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Stream the stored levels straight from the mapping, the environment's mips are rebuilt afterwards
+        swapEnvironment = createEnvironment();
+        swapPrefilter = createPrefilter();
+        GLuint targets[2] = {swapEnvironment, swapPrefilter};
+        for (size_t t = 0; t < 2; t++)
+        {
+            const CachedTexture &texture = swapTextures[t];
+            const unsigned char *data = swapPixels[t];
+            for (GLint level = 0; level < texture.levels; level++)
+            {
+                GLsizei side = std::max(1, texture.size >> level);
+                size_t rowBytes = (size_t)side * 3 * 2;
+                for (unsigned int face = 0; face < 6; face++)
+                {
+                    queueUpload(targets[t], GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, side, side, GL_RGB, GL_HALF_FLOAT, data, rowBytes);
+                    data += rowBytes * side;
+                }
+            }
+        }
+        swapSteps.push_back({STEP_MIPMAPS, [this](Camera &)
+                             {
+                                 glBindTexture(GL_TEXTURE_CUBE_MAP, swapEnvironment);
+                                 glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+                                 glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+                             }});
+    }
+    else
+    {
+        glGenTextures(1, &swapHDRTexture);
+        glBindTexture(GL_TEXTURE_2D, swapHDRTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, swapWidth, swapHeight, 0, GL_RGB, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        queueUpload(swapHDRTexture, GL_TEXTURE_2D, 0, swapWidth, swapHeight, GL_RGB, GL_FLOAT,
+                    reinterpret_cast<const unsigned char *>(swapHDR.data()), (size_t)swapWidth * 3 * sizeof(float));
+
+        swapEnvironment = createEnvironment();
+        swapPrefilter = createPrefilter();
+        for (unsigned int face = 0; face < 6; face++)
+        {
+            swapSteps.push_back({STEP_CUBEMAP_FACE, [this, face](Camera &camera)
+                                 { renderEnvironmentFace(swapEnvironment, swapHDRTexture, face, camera); }});
+        }
+        swapSteps.push_back({STEP_MIPMAPS, [this](Camera &)
+                             {
+                                 glBindTexture(GL_TEXTURE_CUBE_MAP, swapEnvironment);
+                                 glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+                                 glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+                             }});
+        for (unsigned int mip = 0; mip < IBL_PREFILTER_LEVELS; mip++)
+        {
+            for (unsigned int face = 0; face < 6; face++)
+            {
+                swapSteps.push_back({STEP_PREFILTER_FACE, [this, mip, face](Camera &camera)
+                                     { renderPrefilterFace(swapPrefilter, swapEnvironment, mip, face, camera); }});
+            }
+        }
 
-        cubeMap.Draw(irradianceShader, camera);
+        // Read the new maps back a face at a time, the file itself is written on a worker
+        swapReadback.assign(2, std::vector<uint16_t>());
+        queueReadback(swapEnvironment, IBL_ENVIRONMENT_SIZE, 1, swapReadback[0]);
+        queueReadback(swapPrefilter, IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS, swapReadback[1]);
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // The previous cache write may still be running, and this swap could be writing the same file
+    swapSteps.push_back({STEP_FINISH, [this](Camera &)
+                         { finishSwap(); },
+                         [this]()
+                         { return !saveJob.valid() || saveJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }});
+}
+
+void Skybox::queueUpload(GLuint texture, GLenum target, GLint level, GLsizei width, GLsizei height, GLenum format, GLenum type, const unsigned char *data, size_t rowBytes)
+{
+    GLenum bindTarget = target == GL_TEXTURE_2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+    GLsizei rowsPerStep = (GLsizei)std::max<size_t>(1, uploadChunkBytes / rowBytes);
+    for (GLsizei y = 0; y < height; y += rowsPerStep)
+    {
+        GLsizei rows = std::min(rowsPerStep, height - y);
+        const unsigned char *source = data + rowBytes * y;
+        swapSteps.push_back({STEP_UPLOAD, [this, texture, target, bindTarget, level, width, format, type, source, rowBytes, y, rows](Camera &)
+                             {
+                                 // Orphan the PBO so the copy never waits on the previous chunk's transfer
+                                 size_t bytes = rowBytes * rows;
+                                 glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+                                 glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+                                 void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+                                 if (mapped)
+                                 {
+                                     std::memcpy(mapped, source, bytes);
+                                     glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                                 }
+
+                                 glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                                 glBindTexture(bindTarget, texture);
+                                 glTexSubImage2D(target, level, 0, y, width, rows, format, type, (void *)0);
+                                 glBindTexture(bindTarget, 0);
+                                 glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                                 glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                             }});
+    }
+}
+
+void Skybox::queueReadback(GLuint texture, GLsizei size, GLint levels, std::vector<uint16_t> &destination)
+{
+    size_t total = 0;
+    for (GLint level = 0; level < levels; level++)
+    {
+        size_t side = std::max(1, size >> level);
+        total += side * side * 3 * 6;
+    }
+    destination.resize(total);
+
+    // Faces go into the two buffers in turn and each is copied out after the next one was started, a copy whose
+    // fence hasn't signalled yet is left for the next frame
+    size_t offset = 0;
+    unsigned int read = 0;
+    uint16_t *copyTarget = nullptr;
+    size_t copyBytes = 0;
+    for (GLint level = 0; level < levels; level++)
+    {
+        size_t side = std::max(1, size >> level);
+        for (unsigned int face = 0; face < 6; face++, read++)
+        {
+            unsigned int slot = read % 2;
+            size_t bytes = side * side * 3 * sizeof(uint16_t);
+            swapSteps.push_back({STEP_READBACK, [this, texture, level, face, slot, bytes](Camera &)
+                                 {
+                                     glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackPBOs[slot]);
+                                     glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+                                     glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                                     glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+                                     glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_HALF_FLOAT, (void *)0);
+                                     glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+                                     glPixelStorei(GL_PACK_ALIGNMENT, 4);
+                                     glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                                     readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                                 }});
+            if (read > 0)
+                queueReadbackCopy(1 - slot, copyTarget, copyBytes);
+            copyTarget = destination.data() + offset;
+            copyBytes = bytes;
+            offset += side * side * 3;
+        }
+    }
+    queueReadbackCopy((read - 1) % 2, copyTarget, copyBytes);
+}
+
+void Skybox::queueReadbackCopy(unsigned int slot, uint16_t *target, size_t bytes)
+{
+    swapSteps.push_back({STEP_READBACK_COPY, [this, slot, target, bytes](Camera &)
+                         {
+                             glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackPBOs[slot]);
+                             const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+                             if (mapped)
+                             {
+                                 std::memcpy(target, mapped, bytes);
+                                 glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                             }
+                             glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                             glDeleteSync(readbackFences[slot]);
+                             readbackFences[slot] = nullptr;
+                         },
+                         [this, slot]()
+                         {
+                             GLenum status = glClientWaitSync(readbackFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+                             return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+                         }});
+}
+
+void Skybox::finishSwap()
+{
+    // Swap every map at once, so no frame ever samples a half built environment
+    for (GLuint texture : {envCubemap, prefilterMap, hdrTexture})
+    {
+        if (texture != 0)
+            glDeleteTextures(1, &texture);
+    }
+    envCubemap = swapEnvironment;
+    prefilterMap = swapPrefilter;
+    hdrTexture = swapHDRTexture;
+    swapEnvironment = swapPrefilter = swapHDRTexture = 0;
+    hdrPath = swapPath;
+    UpdateIrradiance();
+
+    if (!swapReadback.empty())
+    {
+        // The job owns the pixels, so the next swap can read back while it is still writing
+        std::string path = cacheFolder + IBLCache::EnvironmentFile(swapKey);
+        uint64_t key = swapKey;
+        auto pixels = std::make_shared<std::vector<std::vector<uint16_t>>>(std::move(swapReadback));
+        swapReadback.clear();
+        saveJob = ThreadPool::Shared().Submit([path, key, pixels]()
+                                              {
+                                                  std::vector<CachedTexture> textures(2);
+                                                  textures[0] = {0, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, IBL_ENVIRONMENT_SIZE, 1};
+                                                  textures[1] = {0, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS};
+                                                  IBLCache::WritePixels(path, key, textures, {(*pixels)[0].data(), (*pixels)[1].data()}); });
+    }
+
+    // Drop the decoded data, the mapping and the CPU copies go with it
+    swapFile = MappedFile();
+    swapTextures.clear();
+    swapPixels.clear();
+    std::vector<float>().swap(swapHDR);
+
+    lastSwapMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - swapStart).count();
+    swapState = SwapState::Idle;
+}
+
+void Skybox::UI()
+{
+    ImGui::InputText("HDR", pathInput, sizeof(pathInput));
+    ImGui::SameLine();
+    if (ImGui::Button("Load"))
+        RequestEnvironment(pathInput);
+    ImGui::SliderFloat("Swap budget (ms)", &swapBudgetMs, 0.5f, 16.0f);
+
+    if (swapState == SwapState::Decoding)
+        ImGui::Text("Swap: decoding %s", swapPath.c_str());
+    else if (swapState == SwapState::Baking)
+        ImGui::Text("Swap: %zu steps left", swapSteps.size());
+    if (!swapError.empty())
+        ImGui::Text("%s", swapError.c_str());
+    ImGui::Text("Last swap: %.1f ms, worst frame %.2f ms", lastSwapMs, worstSwapFrameMs);
+}
+
+void Skybox::SetupCubemap(Camera &camera)
+{
+    // Convert HDR to cubemap
+    envCubemap = createEnvironment();
+    for (unsigned int i = 0; i < 6; ++i)
+        renderEnvironmentFace(envCubemap, hdrTexture, i, camera);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 }
 
 void Skybox::SetupPrefilter(Camera &camera)
 {
-    glGenTextures(1, &prefilterMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    prefilterMap = createPrefilter();
+    for (unsigned int mip = 0; mip < IBL_PREFILTER_LEVELS; ++mip)
+    {
+        for (unsigned int i = 0; i < 6; ++i)
+            renderPrefilterFace(prefilterMap, envCubemap, mip, i, camera);
+    }
+}
+
+GLuint Skybox::createEnvironment()
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, IBL_ENVIRONMENT_SIZE, IBL_ENVIRONMENT_SIZE, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
+    // pre-filter.frag picks source mips with textureLod, so the mipmapped min filter matters
+    setCubemapFilters(texture);
+    return texture;
+}
+
+GLuint Skybox::createPrefilter()
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
     for (unsigned int i = 0; i < 6; ++i)
     {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, IBL_PREFILTER_SIZE, IBL_PREFILTER_SIZE, 0, GL_RGB, GL_FLOAT, nullptr);
     }
+    setCubemapFilters(texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, IBL_PREFILTER_LEVELS - 1);
+    // Allocates the rest of the chain, every level is rendered over afterwards
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    return texture;
+}
+
+void Skybox::setCubemapFilters(GLuint texture)
+{
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
 
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+void Skybox::setCaptureSize(GLsizei size)
+{
+    // Reallocating the depth buffer is not free, most passes in a row share a size
+    if (size == captureSize)
+        return;
+    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    captureSize = size;
+}
 
-    prefilterShader.Activate();
-    glUniform1i(glGetUniformLocation(prefilterShader.ID, "environmentMap"), 0);
-    glUniformMatrix4fv(glGetUniformLocation(prefilterShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
+void Skybox::renderEnvironmentFace(GLuint target, GLuint source, unsigned int face, Camera &camera)
+{
+    // pbr: convert HDR equirectangular environment map to cubemap equivalent
+    equirectangularToCubemapShader.Activate();
+    equirectangularToCubemapShader.SetInt(equirectangularToCubemapShader.Uniform("equirectangularMap"), 0);
+    equirectangularToCubemapShader.SetMat4(equirectangularToCubemapShader.uniforms.projection, captureProjection);
+    equirectangularToCubemapShader.SetMat4(equirectangularToCubemapShader.uniforms.view, captureViews[face]);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glBindTexture(GL_TEXTURE_2D, source);
 
     glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    unsigned int maxMipLevels = 5;
-    for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
-    {
-        // reisze framebuffer according to mip-level size.
-        unsigned int mipWidth = static_cast<unsigned int>(128 * std::pow(0.5, mip));
-        unsigned int mipHeight = static_cast<unsigned int>(128 * std::pow(0.5, mip));
-        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-        glViewport(0, 0, mipWidth, mipHeight);
-
-        float roughness = (float)mip / (float)(maxMipLevels - 1);
-        glUniform1f(glGetUniformLocation(prefilterShader.ID, "roughness"), roughness);
-        for (unsigned int i = 0; i < 6; ++i)
-        {
-            glUniformMatrix4fv(glGetUniformLocation(prefilterShader.ID, "view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
+    setCaptureSize(IBL_ENVIRONMENT_SIZE);
+    glViewport(0, 0, IBL_ENVIRONMENT_SIZE, IBL_ENVIRONMENT_SIZE); // don't forget to configure the viewport to the capture dimensions.
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, target, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    cubeMap.Draw(equirectangularToCubemapShader, camera);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            cubeMap.Draw(prefilterShader, camera);
-        }
-    }
+void Skybox::renderPrefilterFace(GLuint target, GLuint source, unsigned int mip, unsigned int face, Camera &camera)
+{
+    prefilterShader.Activate();
+    prefilterShader.SetInt(prefilterShader.Uniform("environmentMap"), 0);
+    prefilterShader.SetMat4(prefilterShader.uniforms.projection, captureProjection);
+    prefilterShader.SetMat4(prefilterShader.uniforms.view, captureViews[face]);
+    float roughness = (float)mip / (float)(IBL_PREFILTER_LEVELS - 1);
+    prefilterShader.SetFloat(prefilterShader.Uniform("roughness"), roughness);
+    prefilterShader.SetFloat(prefilterShader.Uniform("sourceSize"), (float)IBL_ENVIRONMENT_SIZE);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, source);
+
+    // reisze framebuffer according to mip-level size.
+    GLsizei mipSize = std::max(1, IBL_PREFILTER_SIZE >> mip);
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    setCaptureSize(mipSize);
+    glViewport(0, 0, mipSize, mipSize);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, target, mip);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    cubeMap.Draw(prefilterShader, camera);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
@@ -216,27 +746,22 @@ void Skybox::SetupBRDF(Camera &camera)
 
     // pre-allocate enough memory for the LUT texture.
     glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, IBL_BRDF_SIZE, IBL_BRDF_SIZE, 0, GL_RG, GL_FLOAT, 0);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
+    setCaptureSize(IBL_BRDF_SIZE);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
 
-    glViewport(0, 0, 512, 512);
+    glViewport(0, 0, IBL_BRDF_SIZE, IBL_BRDF_SIZE);
     brdfShader.Activate();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     RenderQuad();
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    camera.updateMatrix(45.0f, 0.1f, 100.0f);
-    backgroundShader.Activate();
-    glUniformMatrix4fv(glGetUniformLocation(backgroundShader.ID, "projection"), 1, GL_FALSE, glm::value_ptr(camera.projection));
 }
 
 void Skybox::RenderQuad()
@@ -0,0 +1,90 @@
+#include "sphericalHarmonics.h"
+
+#include <cmath>
+#include <vector>
+
+void SH9::Basis(const glm::vec3 &n, float basis[9])
+{
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * n.y;
+    basis[2] = 0.488603f * n.z;
+    basis[3] = 0.488603f * n.x;
+    basis[4] = 1.092548f * n.x * n.y;
+    basis[5] = 1.092548f * n.y * n.z;
+    basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+    basis[7] = 1.092548f * n.x * n.z;
+    basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+glm::vec3 SH9::TexelDirection(int face, int x, int y, int size)
+{
+    float sc = 2.0f * (x + 0.5f) / size - 1.0f;
+    float tc = 2.0f * (y + 0.5f) / size - 1.0f;
+    glm::vec3 direction;
+    switch (face)
+    {
+    case 0: direction = glm::vec3(1.0f, -tc, -sc); break;
+    case 1: direction = glm::vec3(-1.0f, -tc, sc); break;
+    case 2: direction = glm::vec3(sc, 1.0f, tc); break;
+    case 3: direction = glm::vec3(sc, -1.0f, -tc); break;
+    case 4: direction = glm::vec3(sc, -tc, 1.0f); break;
+    default: direction = glm::vec3(-sc, -tc, -1.0f); break;
+    }
+    return glm::normalize(direction);
+}
+
+float SH9::TexelSolidAngle(int x, int y, int size)
+{
+    auto areaElement = [](float u, float v)
+    { return std::atan2(u * v, std::sqrt(u * u + v * v + 1.0f)); };
+    float u0 = 2.0f * x / size - 1.0f, u1 = 2.0f * (x + 1) / size - 1.0f;
+    float v0 = 2.0f * y / size - 1.0f, v1 = 2.0f * (y + 1) / size - 1.0f;
+    return areaElement(u0, v0) - areaElement(u0, v1) - areaElement(u1, v0) + areaElement(u1, v1);
+}
+
+SH9 SH9::ProjectCubemap(const float *const faces[6], int size, ThreadPool &pool)
+{
+    // One partial sum per face, added up afterwards so the workers never share a total
+    std::vector<SH9> partial(6);
+    pool.ParallelFor(6, [&](size_t face)
+                     {
+                         float basis[9];
+                         for (int y = 0; y < size; y++)
+                         {
+                             for (int x = 0; x < size; x++)
+                             {
+                                 const float *texel = faces[face] + ((size_t)y * size + x) * 3;
+                                 glm::vec3 radiance = glm::vec3(texel[0], texel[1], texel[2]) * TexelSolidAngle(x, y, size);
+                                 Basis(TexelDirection((int)face, x, y, size), basis);
+                                 for (int i = 0; i < 9; i++)
+                                     partial[face].coefficients[i] += radiance * basis[i];
+                             }
+                         } });
+
+    SH9 result;
+    for (const SH9 &sh : partial)
+    {
+        for (int i = 0; i < 9; i++)
+            result.coefficients[i] += sh.coefficients[i];
+    }
+    return result;
+}
+
+void SH9::ConvolveCosine()
+{
+    // Clamped cosine per band (PI, 2PI/3, PI/4), divided by PI
+    const float band[9] = {1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+    for (int i = 0; i < 9; i++)
+        coefficients[i] *= band[i];
+}
+
+glm::vec3 SH9::Evaluate(const glm::vec3 &direction) const
+{
+    float basis[9];
+    Basis(direction, basis);
+    glm::vec3 result(0.0f);
+    for (int i = 0; i < 9; i++)
+        result += coefficients[i] * basis[i];
+    // Ringing can dip below zero opposite very bright lights
+    return glm::max(result, glm::vec3(0.0f));
+}
@@ -1,78 +1,25 @@
 #include "Texture.h"
+#include "renderStats.h"
 
 Texture::Texture(const char *image, const char *texType, GLuint slot)
 {
     type = texType;
-
-    int widthImg, heightImg, numColCh;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *bytes = stbi_load(image, &widthImg, &heightImg, &numColCh, 0);
-
-    glGenTextures(1, &ID);
-    glActiveTexture(GL_TEXTURE0 + slot);
     unit = slot;
-    glBindTexture(GL_TEXTURE_2D, ID);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    if (numColCh == 4)
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RGBA,
-            widthImg,
-            heightImg,
-            0,
-            GL_RGBA,
-            GL_UNSIGNED_BYTE,
-            bytes);
-    else if (numColCh == 3)
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RGBA,
-            widthImg,
-            heightImg,
-            0,
-            GL_RGB,
-            GL_UNSIGNED_BYTE,
-            bytes);
-    else if (numColCh == 1)
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RGBA,
-            widthImg,
-            heightImg,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            bytes);
-    else
-        throw std::invalid_argument("Automatic Texture type recognition failed");
-
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(bytes);
-
-    glBindTexture(GL_TEXTURE_2D, 0);
+    entry = TextureCache::Shared().Acquire(image, texType);
+    ID = entry->ID;
 }
 
 void Texture::texUnit(Shader &shader, const char *uniform, GLuint unit)
 {
-    GLuint texUni = glGetUniformLocation(shader.ID, uniform);
     shader.Activate();
-    glUniform1i(texUni, unit);
+    shader.SetInt(shader.Uniform(uniform), unit);
 }
 
 void Texture::Bind()
 {
     glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    glBindTexture(GL_TEXTURE_2D, entry->resident ? ID : TextureCache::Shared().Placeholder(type));
+    RenderStats::frame.textureBinds++;
 }
 
 void Texture::Unbind()
@@ -82,5 +29,5 @@ void Texture::Unbind()
 
 void Texture::Delete()
 {
-    glDeleteTextures(1, &ID);
+    TextureCache::Shared().Release(entry);
 }
\ No newline at end of file
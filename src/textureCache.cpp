@@ -0,0 +1,453 @@
+#include "textureCache.h"
+#include "threadPool.h"
+#include "stb_image.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // Smallest format holding 'channels' channels: 8 bit (sRGB for color data) or half float for HDR images.
+    // One and two channel images are never sRGB here, decode expands those color maps to three and four channels.
+    GLenum internalFormatFor(int channels, bool srgb, bool hdr)
+    {
+        if (hdr)
+        {
+            const GLenum formats[4] = {GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F};
+            return formats[channels - 1];
+        }
+        switch (channels)
+        {
+        case 1: return GL_R8;
+        case 2: return GL_RG8;
+        case 3: return srgb ? GL_SRGB8 : GL_RGB8;
+        default: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        }
+    }
+
+    // Bytes per texel as drivers store it, three channel formats are padded to four
+    size_t texelBytes(int channels, bool hdr)
+    {
+        return (size_t)(channels == 3 ? 4 : channels) * (hdr ? 2 : 1);
+    }
+
+    GLint mipLevels(int width, int height)
+    {
+        GLint levels = 1;
+        while ((width | height) >> levels)
+            levels++;
+        return levels;
+    }
+
+    size_t chainBytes(int width, int height, GLint levels, size_t bytesPerTexel)
+    {
+        size_t bytes = 0;
+        for (GLint i = 0; i < levels; i++)
+            bytes += (size_t)std::max(1, width >> i) * std::max(1, height >> i) * bytesPerTexel;
+        return bytes;
+    }
+
+    // Allocates immutable storage for the bound texture when the context has glTexStorage2D, false if the
+    // caller has to fall back to glTexImage2D. Loaders generated for 3.3 don't declare it at all.
+    bool allocateStorage(GLenum internalFormat, int width, int height, GLint levels)
+    {
+#ifdef GL_VERSION_4_2
+        if (GLAD_GL_VERSION_4_2)
+        {
+            glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+            return true;
+        }
+#endif
+        return false;
+    }
+
+    const char *formatName(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_R8: return "R8";
+        case GL_RG8: return "RG8";
+        case GL_RGB8: return "RGB8";
+        case GL_RGBA8: return "RGBA8";
+        case GL_SRGB8: return "SRGB8";
+        case GL_SRGB8_ALPHA8: return "SRGB8_ALPHA8";
+        case GL_R16F: return "R16F";
+        case GL_RG16F: return "RG16F";
+        case GL_RGB16F: return "RGB16F";
+        case GL_RGBA16F: return "RGBA16F";
+        default: return CompressedTexture::FormatName(internalFormat);
+        }
+    }
+}
+
+TextureEntry *TextureCache::Acquire(const std::string &path, const char *type)
+{
+    auto found = entries.find(path);
+    if (found != entries.end())
+    {
+        hits++;
+        found->second->references++;
+        return found->second.get();
+    }
+
+    misses++;
+
+    std::unique_ptr<TextureEntry> entry(new TextureEntry());
+    entry->path = path;
+    entry->references = 1;
+    entry->decoding = true;
+    entry->srgb = std::strcmp(type, "albedo") == 0;
+    glGenTextures(1, &entry->ID);
+    TextureEntry *raw = entry.get();
+    entries.emplace(path, std::move(entry));
+    pending++;
+
+    ThreadPool::Shared().Submit([this, raw]()
+                                { decode(raw); });
+    return raw;
+}
+
+void TextureCache::decode(TextureEntry *entry)
+{
+    // "albedo.png" is served by "albedo.ktx2" or "albedo.dds" when one exists, a container can also be named directly
+    std::string base = entry->path.substr(0, entry->path.find_last_of('.'));
+    std::vector<std::string> candidates = {entry->path, base + ".ktx2", base + ".dds"};
+    bool found = false;
+    for (const std::string &candidate : candidates)
+    {
+        if (!CompressedTexture::Load(candidate, entry->compressed))
+            continue;
+        // Containers hold UNORM data, color maps are sampled through the sRGB twin
+        GLenum format = entry->srgb ? CompressedTexture::SRGBFormat(entry->compressed.internalFormat) : entry->compressed.internalFormat;
+        if (format != 0 && supported(format))
+        {
+            entry->compressed.internalFormat = format;
+            found = true;
+            break;
+        }
+    }
+
+    if (found)
+    {
+        entry->width = entry->compressed.width;
+        entry->height = entry->compressed.height;
+    }
+    else
+    {
+        entry->compressed = CompressedImage();
+        // The flip flag is per thread, other loaders on the pool keep their own
+        stbi_set_flip_vertically_on_load_thread(true);
+        entry->hdr = stbi_is_hdr(entry->path.c_str()) != 0;
+        if (entry->hdr)
+        {
+            entry->pixels = stbi_loadf(entry->path.c_str(), &entry->width, &entry->height, &entry->channels, 0);
+        }
+        else
+        {
+            // Core GL has no one or two channel sRGB formats, gray color maps are expanded to RGB(A) instead
+            int expanded = 0, width, height, channels;
+            if (entry->srgb && stbi_info(entry->path.c_str(), &width, &height, &channels) && channels <= 2)
+                expanded = channels + 2;
+            entry->pixels = stbi_load(entry->path.c_str(), &entry->width, &entry->height, &entry->channels, expanded);
+            if (entry->pixels && expanded != 0)
+                entry->channels = expanded;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(decodedMutex);
+    decoded.push_back(entry);
+}
+
+bool TextureCache::supported(GLenum internalFormat)
+{
+    // GL_COMPRESSED_TEXTURE_FORMATS may leave out formats that work, so go by version and extension
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_RG_RGTC2:
+        return true;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+#ifdef GL_VERSION_4_2
+        if (GLAD_GL_VERSION_4_2)
+            return true;
+#endif
+#ifdef GL_ARB_texture_compression_bptc
+        if (GLAD_GL_ARB_texture_compression_bptc)
+            return true;
+#endif
+        return false;
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+#ifdef GL_EXT_texture_compression_s3tc
+        return GLAD_GL_EXT_texture_compression_s3tc != 0;
+#else
+        return false;
+#endif
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        // The sRGB variants come with EXT_texture_sRGB
+#if defined(GL_EXT_texture_compression_s3tc) && defined(GL_EXT_texture_sRGB)
+        return GLAD_GL_EXT_texture_compression_s3tc && GLAD_GL_EXT_texture_sRGB;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+void TextureCache::Release(TextureEntry *entry)
+{
+    if (entry->references <= 0)
+    {
+        std::cerr << "Texture " << entry->path << " released more often than acquired" << std::endl;
+        return;
+    }
+    if (--entry->references > 0 || entry->decoding)
+        return;
+    // Still decoding entries are freed by Update once their job reports back
+    destroy(entry);
+}
+
+void TextureCache::Update()
+{
+    std::vector<TextureEntry *> ready;
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        ready.swap(decoded);
+    }
+
+    size_t uploaded = 0;
+    size_t next = 0;
+    for (; next < ready.size(); next++)
+    {
+        TextureEntry *entry = ready[next];
+        bool compressed = !entry->compressed.levels.empty();
+        size_t bytes = compressed ? entry->compressed.Bytes() : (size_t)entry->width * entry->height * entry->channels * (entry->hdr ? 4 : 1);
+        if (uploaded > 0 && uploaded + bytes > uploadBudgetBytes)
+            break;
+
+        entry->decoding = false;
+        pending--;
+        if (entry->references == 0)
+        {
+            destroy(entry);
+            continue;
+        }
+        if (compressed)
+        {
+            uploadCompressed(entry);
+            uploaded += bytes;
+            continue;
+        }
+        if (!entry->pixels)
+        {
+            std::cerr << "Failed to load texture " << entry->path << std::endl;
+            entry->failed = true;
+            continue;
+        }
+        upload(entry);
+        uploaded += bytes;
+    }
+
+    // Whatever didn't fit goes first next frame
+    if (next < ready.size())
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        decoded.insert(decoded.begin(), ready.begin() + next, ready.end());
+    }
+}
+
+void TextureCache::upload(TextureEntry *entry)
+{
+    GLenum format;
+    if (entry->channels == 4)
+        format = GL_RGBA;
+    else if (entry->channels == 3)
+        format = GL_RGB;
+    else if (entry->channels == 2)
+        format = GL_RG;
+    else if (entry->channels == 1)
+        format = GL_RED;
+    else
+    {
+        std::cerr << "Automatic Texture type recognition failed for " << entry->path << std::endl;
+        entry->failed = true;
+        stbi_image_free(entry->pixels);
+        entry->pixels = nullptr;
+        return;
+    }
+
+    // Stage through a PBO so glTexImage2D only schedules the copy instead of reading client memory
+    GLenum type = entry->hdr ? GL_FLOAT : GL_UNSIGNED_BYTE;
+    size_t bytes = (size_t)entry->width * entry->height * entry->channels * (entry->hdr ? 4 : 1);
+    if (uploadPBO == 0)
+        glGenBuffers(1, &uploadPBO);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    const void *source = (void *)0;
+    if (mapped)
+    {
+        std::memcpy(mapped, entry->pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else
+    {
+        // Mapping failed, fall back to a plain client memory upload
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        source = entry->pixels;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, entry->ID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    GLenum internalFormat = internalFormatFor(entry->channels, entry->srgb, entry->hdr);
+    GLint levels = mipLevels(entry->width, entry->height);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (allocateStorage(internalFormat, entry->width, entry->height, levels))
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry->width, entry->height, format, type, source);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, entry->width, entry->height, 0, format, type, source);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    stbi_image_free(entry->pixels);
+    entry->pixels = nullptr;
+    entry->resident = true;
+    entry->internalFormat = internalFormat;
+    entry->bytes = chainBytes(entry->width, entry->height, levels, texelBytes(entry->channels, entry->hdr));
+    residentBytes += entry->bytes;
+}
+
+void TextureCache::uploadCompressed(TextureEntry *entry)
+{
+    // Levels go into the PBO back to back, whatever order the container keeps them in
+    const CompressedImage &image = entry->compressed;
+    size_t bytes = image.Bytes();
+    if (uploadPBO == 0)
+        glGenBuffers(1, &uploadPBO);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    unsigned char *mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped)
+    {
+        size_t offset = 0;
+        for (const CompressedLevel &level : image.levels)
+        {
+            std::memcpy(mapped + offset, image.Data(level), level.size);
+            offset += level.size;
+        }
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, entry->ID);
+    GLint levels = (GLint)image.levels.size();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_NEAREST_MIPMAP_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    bool immutable = allocateStorage(image.internalFormat, image.width, image.height, levels);
+    size_t offset = 0;
+    for (GLint i = 0; i < levels; i++)
+    {
+        const CompressedLevel &level = image.levels[i];
+        const void *source = mapped ? (const void *)offset : (const void *)image.Data(level);
+        if (immutable)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, image.internalFormat, (GLsizei)level.size, source);
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, image.internalFormat, level.width, level.height, 0, (GLsizei)level.size, source);
+        offset += level.size;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    entry->internalFormat = image.internalFormat;
+    entry->compressed = CompressedImage();
+    entry->resident = true;
+    entry->blockCompressed = true;
+    entry->bytes = bytes;
+    residentBytes += bytes;
+    compressedBytes += bytes;
+}
+
+void TextureCache::destroy(TextureEntry *entry)
+{
+    if (entry->resident)
+        residentBytes -= entry->bytes;
+    if (entry->resident && entry->blockCompressed)
+        compressedBytes -= entry->bytes;
+    if (entry->pixels)
+        stbi_image_free(entry->pixels);
+    glDeleteTextures(1, &entry->ID);
+    evictions++;
+    entries.erase(entry->path);
+}
+
+void TextureCache::UI()
+{
+    ImGui::Text("Textures: %zu (%zu loading), hit rate %.0f%%, %u evicted", Size(), Pending(), HitRate() * 100.0f, evictions);
+    ImGui::Text("Texture memory: %.1f MB (%.1f MB block compressed)", residentBytes / (1024.0f * 1024.0f), compressedBytes / (1024.0f * 1024.0f));
+    if (!ImGui::TreeNode("Texture memory by image"))
+        return;
+
+    // Largest first
+    std::vector<const TextureEntry *> resident;
+    for (const auto &entry : entries)
+        if (entry.second->resident)
+            resident.push_back(entry.second.get());
+    std::sort(resident.begin(), resident.end(), [](const TextureEntry *a, const TextureEntry *b)
+              { return a->bytes > b->bytes; });
+    for (const TextureEntry *entry : resident)
+        ImGui::Text("%8.2f MB  %-12s %5dx%-5d %s", entry->bytes / (1024.0f * 1024.0f), formatName(entry->internalFormat), entry->width, entry->height, entry->path.c_str());
+    ImGui::TreePop();
+}
+
+GLuint TextureCache::Placeholder(const char *type)
+{
+    if (placeholderWhite == 0)
+    {
+        placeholderWhite = createPlaceholder(255, 255, 255);
+        // Flat tangent space normal, and full AO / roughness with no metal, so the material values pass through
+        placeholderNormal = createPlaceholder(128, 128, 255);
+        placeholderARM = createPlaceholder(255, 255, 0);
+    }
+    if (std::strcmp(type, "normal") == 0)
+        return placeholderNormal;
+    if (std::strcmp(type, "arm") == 0)
+        return placeholderARM;
+    return placeholderWhite;
+}
+
+GLuint TextureCache::createPlaceholder(unsigned char r, unsigned char g, unsigned char b)
+{
+    const unsigned char pixel[4] = {r, g, b, 255};
+    GLuint ID;
+    glGenTextures(1, &ID);
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return ID;
+}
+
+TextureCache &TextureCache::Shared()
+{
+    static TextureCache cache;
+    return cache;
+}
@@ -0,0 +1,180 @@
+#include "vertexLayout.h"
+#include "halfFloat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    size_t positionBytes(PositionFormat format)
+    {
+        // Three 16 bit components are padded to four
+        return format == PositionFormat::Float ? 12 : 8;
+    }
+
+    size_t normalBytes(NormalFormat format)
+    {
+        switch (format)
+        {
+        case NormalFormat::Float: return 8;
+        case NormalFormat::SNorm16: return 4;
+        default: return 4; // two bytes padded to four
+        }
+    }
+
+    size_t texCoordBytes(TexCoordFormat format)
+    {
+        return format == TexCoordFormat::Float ? 8 : 4;
+    }
+
+    template <typename T>
+    void write(unsigned char *&out, T value)
+    {
+        std::memcpy(out, &value, sizeof(T));
+        out += sizeof(T);
+    }
+
+    int16_t snorm16(float value)
+    {
+        return (int16_t)std::lround(std::min(1.0f, std::max(-1.0f, value)) * 32767.0f);
+    }
+
+    int8_t snorm8(float value)
+    {
+        return (int8_t)std::lround(std::min(1.0f, std::max(-1.0f, value)) * 127.0f);
+    }
+}
+
+std::vector<VertexAttribute> VertexLayout::Attributes() const
+{
+    std::vector<VertexAttribute> attributes;
+    size_t offset = 0;
+    switch (position)
+    {
+    case PositionFormat::Float: attributes.push_back({POSITION_ATTRIB_LOCATION, 3, GL_FLOAT, GL_FALSE, offset}); break;
+    case PositionFormat::Half: attributes.push_back({POSITION_ATTRIB_LOCATION, 3, GL_HALF_FLOAT, GL_FALSE, offset}); break;
+    case PositionFormat::UNorm16: attributes.push_back({POSITION_ATTRIB_LOCATION, 3, GL_UNSIGNED_SHORT, GL_TRUE, offset}); break;
+    }
+    offset += positionBytes(position);
+    switch (normal)
+    {
+    case NormalFormat::Float: attributes.push_back({NORMAL_ATTRIB_LOCATION, 2, GL_FLOAT, GL_FALSE, offset}); break;
+    case NormalFormat::SNorm16: attributes.push_back({NORMAL_ATTRIB_LOCATION, 2, GL_SHORT, GL_TRUE, offset}); break;
+    case NormalFormat::SNorm8: attributes.push_back({NORMAL_ATTRIB_LOCATION, 2, GL_BYTE, GL_TRUE, offset}); break;
+    }
+    offset += normalBytes(normal);
+    attributes.push_back({TEXCOORD_ATTRIB_LOCATION, 2, texCoord == TexCoordFormat::Float ? (GLenum)GL_FLOAT : (GLenum)GL_HALF_FLOAT, GL_FALSE, offset});
+    return attributes;
+}
+
+GLsizei VertexLayout::Stride() const
+{
+    return (GLsizei)(positionBytes(position) + normalBytes(normal) + texCoordBytes(texCoord));
+}
+
+GLsizei VertexLayout::PositionStride() const
+{
+    return (GLsizei)positionBytes(position);
+}
+
+std::vector<unsigned char> VertexLayout::Pack(const std::vector<Vertex> &vertices, const AABB &bounds) const
+{
+    glm::vec3 scale, offset;
+    Dequantization(bounds, scale, offset);
+
+    size_t stride = (size_t)Stride();
+    std::vector<unsigned char> packed(vertices.size() * stride, 0);
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex &vertex = vertices[i];
+        unsigned char *out = &packed[i * stride];
+
+        glm::vec3 stored = (vertex.position - offset) / scale;
+        switch (position)
+        {
+        case PositionFormat::Float:
+            write(out, stored);
+            break;
+        case PositionFormat::Half:
+            for (int c = 0; c < 3; c++)
+                write(out, FloatToHalf(stored[c]));
+            out += 2;
+            break;
+        case PositionFormat::UNorm16:
+            for (int c = 0; c < 3; c++)
+                write(out, (uint16_t)std::lround(std::min(1.0f, std::max(0.0f, stored[c])) * 65535.0f));
+            out += 2;
+            break;
+        }
+
+        glm::vec2 octahedral = EncodeOctahedral(vertex.normal);
+        switch (normal)
+        {
+        case NormalFormat::Float:
+            write(out, octahedral);
+            break;
+        case NormalFormat::SNorm16:
+            write(out, snorm16(octahedral.x));
+            write(out, snorm16(octahedral.y));
+            break;
+        case NormalFormat::SNorm8:
+            write(out, snorm8(octahedral.x));
+            write(out, snorm8(octahedral.y));
+            out += 2;
+            break;
+        }
+
+        if (texCoord == TexCoordFormat::Float)
+        {
+            write(out, vertex.texUV);
+        }
+        else
+        {
+            write(out, FloatToHalf(vertex.texUV.x));
+            write(out, FloatToHalf(vertex.texUV.y));
+        }
+    }
+    return packed;
+}
+
+void VertexLayout::Dequantization(const AABB &bounds, glm::vec3 &scale, glm::vec3 &offset) const
+{
+    if (position == PositionFormat::Float)
+    {
+        scale = glm::vec3(1.0f);
+        offset = glm::vec3(0.0f);
+        return;
+    }
+    // Flat axes keep a unit scale so the division in Pack stays finite
+    scale = bounds.max - bounds.min;
+    for (int c = 0; c < 3; c++)
+        if (scale[c] <= 0.0f)
+            scale[c] = 1.0f;
+    offset = bounds.min;
+}
+
+glm::vec2 VertexLayout::EncodeOctahedral(const glm::vec3 &normal)
+{
+    float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (sum <= 0.0f)
+        return glm::vec2(0.0f);
+    glm::vec2 p = glm::vec2(normal.x, normal.y) / sum;
+    // The lower hemisphere folds over the diagonals
+    if (normal.z < 0.0f)
+    {
+        glm::vec2 folded = glm::vec2(1.0f - std::fabs(p.y), 1.0f - std::fabs(p.x));
+        p = glm::vec2(p.x >= 0.0f ? folded.x : -folded.x, p.y >= 0.0f ? folded.y : -folded.y);
+    }
+    return p;
+}
+
+glm::vec3 VertexLayout::DecodeOctahedral(const glm::vec2 &encoded)
+{
+    glm::vec3 n(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
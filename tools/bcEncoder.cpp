@@ -0,0 +1,514 @@
+// Offline block compression, no GL context needed.
+// Turns PNG / JPG / TGA textures into .ktx2 files next to them, which TextureCache picks up in place of the image.
+// Rows are written bottom first and marked so, the order the renderer uploads in.
+// The format follows the file name: "normal" maps go to BC5, "arm" / "roughness" / "metallic" / "ao" maps to BC1,
+// single channel images to BC4 and everything else (albedo) to BC7.
+// Usage:
+//   bcEncoder <image>... [--format bc1|bc4|bc5|bc7] [--threads N] [--report]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "stb_image.h"
+#include "compressedTexture.h"
+#include "threadPool.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Interpolation weights of a 4 bit BC7 index
+const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// RGBA8 image, rows bottom first like every texture the renderer uploads
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+
+    const unsigned char *Texel(int x, int y) const
+    {
+        x = std::min(x, width - 1);
+        y = std::min(y, height - 1);
+        return &pixels[((size_t)y * width + x) * 4];
+    }
+};
+
+// Half size box filtered copy of 'source', normal maps are renormalized so the mips stay unit length
+static Image downsample(const Image &source, bool normalMap)
+{
+    Image result;
+    result.width = std::max(1, source.width / 2);
+    result.height = std::max(1, source.height / 2);
+    result.pixels.resize((size_t)result.width * result.height * 4);
+    for (int y = 0; y < result.height; y++)
+    {
+        for (int x = 0; x < result.width; x++)
+        {
+            float sum[4] = {};
+            for (int dy = 0; dy < 2; dy++)
+                for (int dx = 0; dx < 2; dx++)
+                {
+                    const unsigned char *texel = source.Texel(x * 2 + dx, y * 2 + dy);
+                    for (int c = 0; c < 4; c++)
+                        sum[c] += texel[c] * 0.25f;
+                }
+            if (normalMap)
+            {
+                float n[3];
+                float length = 0.0f;
+                for (int c = 0; c < 3; c++)
+                {
+                    n[c] = sum[c] / 127.5f - 1.0f;
+                    length += n[c] * n[c];
+                }
+                length = length > 0.0f ? std::sqrt(length) : 1.0f;
+                for (int c = 0; c < 3; c++)
+                    sum[c] = (n[c] / length + 1.0f) * 127.5f;
+            }
+            unsigned char *texel = &result.pixels[((size_t)y * result.width + x) * 4];
+            for (int c = 0; c < 4; c++)
+                texel[c] = (unsigned char)std::min(255.0f, std::max(0.0f, sum[c] + 0.5f));
+        }
+    }
+    return result;
+}
+
+// Principal axis of the block's first 'channels' channels, found by power iteration on the covariance
+static void principalAxis(const float block[16][4], int channels, float mean[4], float axis[4])
+{
+    for (int c = 0; c < 4; c++)
+    {
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            mean[c] += block[i][c] / 16.0f;
+    }
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < channels; a++)
+            for (int b = 0; b < channels; b++)
+                covariance[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+
+    for (int c = 0; c < 4; c++)
+        axis[c] = c < channels ? 1.0f : 0.0f;
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < channels; a++)
+        {
+            for (int b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        // Flat block, any axis will do
+        if (length < 1e-8f)
+            break;
+        length = std::sqrt(length);
+        for (int a = 0; a < channels; a++)
+            axis[a] = next[a] / length;
+    }
+}
+
+// Ends of the block's extent along its principal axis
+static void rangeFit(const float block[16][4], int channels, float low[4], float high[4])
+{
+    float mean[4], axis[4];
+    principalAxis(block, channels, mean, axis);
+    float minimum = 0.0f, maximum = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+            t += (block[i][c] - mean[c]) * axis[c];
+        minimum = std::min(minimum, t);
+        maximum = std::max(maximum, t);
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minimum));
+        high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maximum));
+    }
+}
+
+static void loadBlock(const Image &image, int blockX, int blockY, float block[16][4])
+{
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++)
+        {
+            const unsigned char *texel = image.Texel(blockX * 4 + x, blockY * 4 + y);
+            for (int c = 0; c < 4; c++)
+                block[y * 4 + x][c] = texel[c];
+        }
+}
+
+static uint16_t packRGB565(const float color[4])
+{
+    int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+    int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+    int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t packed, float color[3])
+{
+    color[0] = (float)(((packed >> 11) & 31) * 255 / 31);
+    color[1] = (float)(((packed >> 5) & 63) * 255 / 63);
+    color[2] = (float)((packed & 31) * 255 / 31);
+}
+
+// BC1 in four color mode, alpha is ignored
+static void encodeBC1(const float block[16][4], unsigned char *out)
+{
+    float low[4], high[4];
+    rangeFit(block, 3, low, high);
+    uint16_t color0 = packRGB565(high);
+    uint16_t color1 = packRGB565(low);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    // color0 == color1 would switch to three color mode, index 0 covers the whole block then
+    if (color0 != color1)
+    {
+        float palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestError = 1e30f;
+            for (int p = 0; p < 4; p++)
+            {
+                float error = 0.0f;
+                for (int c = 0; c < 3; c++)
+                    error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    std::memcpy(out, &color0, 2);
+    std::memcpy(out + 2, &color1, 2);
+    std::memcpy(out + 4, &indices, 4);
+}
+
+// BC4 in eight value mode for one channel
+static void encodeBC4(const float block[16][4], int channel, unsigned char *out)
+{
+    float minimum = 255.0f, maximum = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        minimum = std::min(minimum, block[i][channel]);
+        maximum = std::max(maximum, block[i][channel]);
+    }
+    int value0 = (int)std::lround(maximum);
+    int value1 = (int)std::lround(minimum);
+
+    uint64_t bits = (uint64_t)value0 | ((uint64_t)value1 << 8);
+    if (value0 != value1)
+    {
+        // Codes 0 and 1 are the ends, 2..7 step from value0 towards value1
+        float palette[8];
+        palette[0] = (float)value0;
+        palette[1] = (float)value1;
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * value0 + i * value1) / 7.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestError = 1e30f;
+            for (int p = 0; p < 8; p++)
+            {
+                float error = std::fabs(block[i][channel] - palette[p]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            bits |= (uint64_t)best << (16 + i * 3);
+        }
+    }
+    std::memcpy(out, &bits, 8);
+}
+
+// Red and green as two BC4 blocks
+static void encodeBC5(const float block[16][4], unsigned char *out)
+{
+    encodeBC4(block, 0, out);
+    encodeBC4(block, 1, out + 8);
+}
+
+// Appends 'count' bits of 'value' to a 128 bit block, least significant bit first
+struct BlockWriter
+{
+    unsigned char *out;
+    int position = 0;
+
+    void Write(uint32_t value, int count)
+    {
+        for (int i = 0; i < count; i++, position++)
+            if (value & (1u << i))
+                out[position / 8] |= (unsigned char)(1u << (position % 8));
+    }
+};
+
+// 7 bit endpoint plus a p-bit shared by its channels, picking the p-bit that lands closer to 'color'
+static void quantizeBC7(const float color[4], int endpoint[4], int &pBit)
+{
+    float bestError = 1e30f;
+    for (int p = 0; p < 2; p++)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++)
+        {
+            candidate[c] = std::min(127, std::max(0, (int)std::lround((color[c] - p) / 2.0f)));
+            float value = (float)((candidate[c] << 1) | p);
+            error += (value - color[c]) * (value - color[c]);
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = p;
+            std::copy(candidate, candidate + 4, endpoint);
+        }
+    }
+}
+
+// BC7 mode 6: one subset, RGBA endpoints with p-bits and 4 bit indices
+static void encodeBC7(const float block[16][4], unsigned char *out)
+{
+    float low[4], high[4];
+    rangeFit(block, 4, low, high);
+    int endpoints[2][4];
+    int pBits[2];
+    quantizeBC7(low, endpoints[0], pBits[0]);
+    quantizeBC7(high, endpoints[1], pBits[1]);
+
+    int palette[16][4];
+    for (int w = 0; w < 16; w++)
+        for (int c = 0; c < 4; c++)
+        {
+            int e0 = (endpoints[0][c] << 1) | pBits[0];
+            int e1 = (endpoints[1][c] << 1) | pBits[1];
+            palette[w][c] = ((64 - BC7_WEIGHTS[w]) * e0 + BC7_WEIGHTS[w] * e1 + 32) >> 6;
+        }
+    int indices[16];
+    for (int i = 0; i < 16; i++)
+    {
+        float bestError = 1e30f;
+        for (int w = 0; w < 16; w++)
+        {
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+                error += (block[i][c] - palette[w][c]) * (block[i][c] - palette[w][c]);
+            if (error < bestError)
+            {
+                bestError = error;
+                indices[i] = w;
+            }
+        }
+    }
+
+    // The first index drops its top bit, swapping the endpoints keeps it clear
+    if (indices[0] >= 8)
+    {
+        std::swap(endpoints[0], endpoints[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (int &index : indices)
+            index = 15 - index;
+    }
+
+    std::memset(out, 0, 16);
+    BlockWriter writer{out};
+    writer.Write(1u << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writer.Write((uint32_t)endpoints[0][c], 7);
+        writer.Write((uint32_t)endpoints[1][c], 7);
+    }
+    writer.Write((uint32_t)pBits[0], 1);
+    writer.Write((uint32_t)pBits[1], 1);
+    writer.Write((uint32_t)indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        writer.Write((uint32_t)indices[i], 4);
+}
+
+// Compresses one level, a row of blocks per job
+static std::vector<unsigned char> encodeLevel(ThreadPool &pool, const Image &image, GLenum format)
+{
+    int blocksX = (image.width + 3) / 4;
+    int blocksY = (image.height + 3) / 4;
+    size_t blockBytes = CompressedTexture::BlockBytes(format);
+    std::vector<unsigned char> data((size_t)blocksX * blocksY * blockBytes);
+    pool.ParallelFor((size_t)blocksY, [&](size_t row)
+                     {
+                         float block[16][4];
+                         for (int x = 0; x < blocksX; x++)
+                         {
+                             loadBlock(image, x, (int)row, block);
+                             unsigned char *out = &data[(row * blocksX + x) * blockBytes];
+                             if (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT)
+                                 encodeBC1(block, out);
+                             else if (format == GL_COMPRESSED_RED_RGTC1)
+                                 encodeBC4(block, 0, out);
+                             else if (format == GL_COMPRESSED_RG_RGTC2)
+                                 encodeBC5(block, out);
+                             else
+                                 encodeBC7(block, out);
+                         } });
+    return data;
+}
+
+static bool contains(std::string text, const char *word)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                   { return (char)std::tolower(c); });
+    return text.find(word) != std::string::npos;
+}
+
+static GLenum formatFor(const std::string &path, int channels)
+{
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    if (contains(name, "normal"))
+        return GL_COMPRESSED_RG_RGTC2;
+    if (contains(name, "arm") || contains(name, "rough") || contains(name, "metal") || contains(name, "ao"))
+        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    if (channels == 1)
+        return GL_COMPRESSED_RED_RGTC1;
+    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+}
+
+static GLenum formatFromName(const char *name)
+{
+    if (std::strcmp(name, "bc1") == 0)
+        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    if (std::strcmp(name, "bc4") == 0)
+        return GL_COMPRESSED_RED_RGTC1;
+    if (std::strcmp(name, "bc5") == 0)
+        return GL_COMPRESSED_RG_RGTC2;
+    if (std::strcmp(name, "bc7") == 0)
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    return 0;
+}
+
+// Bytes of the same image as TextureCache uploads it uncompressed: RGBA8 plus a third for the mips
+static size_t uncompressedBytes(int width, int height)
+{
+    return (size_t)width * height * 4 * 4 / 3;
+}
+
+static double megabytes(size_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> paths;
+    GLenum forcedFormat = 0;
+    unsigned int threads = 0;
+    bool report = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            forcedFormat = formatFromName(argv[++i]);
+            if (forcedFormat == 0)
+            {
+                std::cerr << "Unknown format " << argv[i] << ", expected bc1, bc4, bc5 or bc7" << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = (unsigned int)std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--report") == 0)
+            report = true;
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty())
+    {
+        std::cerr << "Usage: bcEncoder <image>... [--format bc1|bc4|bc5|bc7] [--threads N] [--report]" << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(threads);
+    // Same row order as TextureCache's stb path
+    stbi_set_flip_vertically_on_load(true);
+
+    size_t totalUncompressed = 0, totalCompressed = 0;
+    int failures = 0;
+    for (const std::string &path : paths)
+    {
+        Clock::time_point start = Clock::now();
+        Image image;
+        int channels = 0;
+        unsigned char *pixels = stbi_load(path.c_str(), &image.width, &image.height, &channels, 4);
+        if (!pixels)
+        {
+            std::cerr << "Failed to load " << path << std::endl;
+            failures++;
+            continue;
+        }
+        image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+        stbi_image_free(pixels);
+
+        int width = image.width, height = image.height;
+        GLenum format = forcedFormat != 0 ? forcedFormat : formatFor(path, channels);
+        bool normalMap = format == GL_COMPRESSED_RG_RGTC2;
+        std::vector<std::vector<unsigned char>> levels;
+        size_t compressed = 0;
+        while (true)
+        {
+            levels.push_back(encodeLevel(pool, image, format));
+            compressed += levels.back().size();
+            if (image.width == 1 && image.height == 1)
+                break;
+            image = downsample(image, normalMap);
+        }
+
+        std::string output = path.substr(0, path.find_last_of('.')) + ".ktx2";
+        if (!CompressedTexture::WriteKTX2(output, format, width, height, levels))
+        {
+            std::cerr << "Failed to write " << output << std::endl;
+            failures++;
+            continue;
+        }
+
+        size_t uncompressed = uncompressedBytes(width, height);
+        totalUncompressed += uncompressed;
+        totalCompressed += compressed;
+        std::printf("%s: %s, %zu levels, %.1f ms -> %s\n", path.c_str(), CompressedTexture::FormatName(format), levels.size(), millisecondsSince(start), output.c_str());
+        if (report)
+            std::printf("  RGBA8 %.2f MB, %s %.2f MB (%.1fx smaller)\n", megabytes(uncompressed), CompressedTexture::FormatName(format), megabytes(compressed), (double)uncompressed / (double)compressed);
+    }
+
+    if (report && totalCompressed > 0)
+        std::printf("Total: RGBA8 %.2f MB, compressed %.2f MB, saved %.2f MB (%.1fx smaller)\n", megabytes(totalUncompressed), megabytes(totalCompressed),
+                    megabytes(totalUncompressed - totalCompressed), (double)totalUncompressed / (double)totalCompressed);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Headless benchmark of the scene BVH: build, refit and query times for 1k to 1M random boxes.
+// Usage: bvhBench [max objects]
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bvh.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void benchmark(size_t count, std::mt19937 &random)
+{
+    // Keep the density constant so every size sees a similar number of hits per query
+    float side = 4.0f * std::cbrt((float)count);
+    std::uniform_real_distribution<float> position(-side * 0.5f, side * 0.5f);
+    std::uniform_real_distribution<float> size(0.2f, 1.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<AABB> boxes(count);
+    for (AABB &box : boxes)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        glm::vec3 extents(size(random), size(random), size(random));
+        box.min = center - extents;
+        box.max = center + extents;
+    }
+
+    BVH bvh;
+    std::vector<int> proxies(count);
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < count; i++)
+        proxies[i] = bvh.Insert(boxes[i], &boxes[i]);
+    double insertTime = millisecondsSince(start);
+
+    start = Clock::now();
+    bvh.Rebuild();
+    double rebuildTime = millisecondsSince(start);
+    float rebuiltCost = bvh.Cost();
+
+    // Nudge a tenth of the objects, enough to escape the leaf margin
+    size_t moved = std::max<size_t>(1, count / 10);
+    start = Clock::now();
+    for (size_t i = 0; i < moved; i++)
+    {
+        size_t index = random() % count;
+        glm::vec3 offset = glm::vec3(unit(random), unit(random), unit(random)) * 0.5f;
+        boxes[index].min += offset;
+        boxes[index].max += offset;
+        bvh.Move(proxies[index], boxes[index]);
+    }
+    double refitTime = millisecondsSince(start);
+
+    // Frustum queries from random cameras inside the scene, seeing a fraction of it
+    const int frustumQueries = 64;
+    size_t frustumHits = 0;
+    size_t mismatches = 0;
+    double frustumTime = 0.0;
+    for (int q = 0; q < frustumQueries; q++)
+    {
+        glm::vec3 eye(position(random), position(random), position(random));
+        glm::vec3 target(position(random), position(random), position(random));
+        glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, side * 0.25f) *
+                                   glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = Frustum::FromMatrix(viewProjection);
+
+        size_t hits = 0;
+        start = Clock::now();
+        bvh.QueryFrustum(frustum, [&](void *)
+                         { hits++; });
+        frustumTime += millisecondsSince(start);
+        frustumHits += hits;
+
+        // The tree may only report extra boxes (from the leaf margin), never miss one
+        if (q == 0)
+        {
+            size_t expected = 0;
+            for (const AABB &box : boxes)
+                expected += frustum.Intersects(box) ? 1 : 0;
+            if (hits < expected)
+                mismatches++;
+        }
+    }
+
+    const int rayQueries = 4096;
+    size_t rayHits = 0;
+    start = Clock::now();
+    for (int q = 0; q < rayQueries; q++)
+    {
+        glm::vec3 origin = glm::normalize(glm::vec3(unit(random), unit(random), unit(random))) * side;
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) * 0.25f - origin);
+        float distance;
+        rayHits += bvh.Raycast(origin, direction, distance) ? 1 : 0;
+    }
+    double rayTime = millisecondsSince(start);
+
+    const int sphereQueries = 4096;
+    size_t sphereHits = 0;
+    start = Clock::now();
+    for (int q = 0; q < sphereQueries; q++)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        bvh.QuerySphere(center, 3.0f, [&](void *)
+                        { sphereHits++; });
+    }
+    double sphereTime = millisecondsSince(start);
+
+    std::cout << count << " objects\n"
+              << "  insert " << insertTime << " ms, SAH rebuild " << rebuildTime << " ms, height " << bvh.Height()
+              << ", cost " << rebuiltCost << " -> " << bvh.Cost() << " after refits\n"
+              << "  refit " << moved << " moves in " << refitTime << " ms (" << refitTime * 1000.0 / moved << " us each)\n"
+              << "  frustum " << frustumTime / frustumQueries << " ms/query, " << frustumHits / frustumQueries << " hits/query"
+              << (mismatches ? ", MISSED BOXES" : "") << "\n"
+              << "  ray " << rayTime * 1000.0 / rayQueries << " us/query, " << rayHits << "/" << rayQueries << " hit\n"
+              << "  sphere " << sphereTime * 1000.0 / sphereQueries << " us/query, " << sphereHits / sphereQueries << " hits/query"
+              << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    size_t maxCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937 random(1234);
+    for (size_t count = 1000; count <= maxCount; count *= 10)
+        benchmark(count, random);
+    return 0;
+}
@@ -0,0 +1,604 @@
+// Offline image based lighting baker, no GL context needed.
+// Turns an equirectangular .hdr into the same cache files Skybox::Init loads, and diffs cache files.
+// The BRDF LUT sums run four samples at a time with SSE2 where the compiler targets it, every bake checks them
+// against the plain scalar loop before writing anything. The cubemap, prefilter and SH passes are scalar per texel.
+// Usage:
+//   iblBaker <file.hdr> [output folder] [--threads N]
+//   iblBaker --compare <reference.cache> <test.cache> [tolerance]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IBL_BAKER_SSE2 1
+#endif
+
+#include "stb_image.h"
+#include "halfFloat.h"
+#include "iblCache.h"
+#include "mappedFile.h"
+#include "sphericalHarmonics.h"
+#include "threadPool.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+const float PI = 3.14159265359f;
+const unsigned int SAMPLE_COUNT = 1024;
+// Floats per SSE2 register, the BRDF sample tables are padded to a multiple of it
+const int LANES = 4;
+// Relative RMSE the SSE2 BRDF LUT may differ from the scalar one by, only the summation order differs
+const float VERIFY_TOLERANCE = 1e-4f;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Van der Corput radical inverse paired with i / n, same sequence as the GL shaders
+static void hammersley(unsigned int i, unsigned int n, float &x, float &y)
+{
+    unsigned int bits = i;
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    x = (float)i / (float)n;
+    y = bits * 2.3283064365386963e-10f;
+}
+
+// GGX half vector around +Z for the sample (x, y)
+static glm::vec3 importanceSampleGGX(float x, float y, float roughness)
+{
+    float a = roughness * roughness;
+    float phi = 2.0f * PI * x;
+    float cosTheta = std::sqrt((1.0f - y) / (1.0f + (a * a - 1.0f) * y));
+    float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+    return glm::vec3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+}
+
+// RGB float cubemap, faces in GL order (+X, -X, +Y, -Y, +Z, -Z) with rows in upload order
+struct Cubemap
+{
+    int size = 0;
+    std::vector<float> faces[6];
+
+    void Allocate(int faceSize)
+    {
+        size = faceSize;
+        for (std::vector<float> &face : faces)
+            face.assign((size_t)size * size * 3, 0.0f);
+    }
+
+    float *Texel(int face, int x, int y) { return &faces[face][((size_t)y * size + x) * 3]; }
+    const float *Texel(int face, int x, int y) const { return &faces[face][((size_t)y * size + x) * 3]; }
+
+    // Bilinear lookup, clamped to the face edges like a cubemap without seamless filtering
+    glm::vec3 Sample(const glm::vec3 &direction) const
+    {
+        glm::vec3 a = glm::abs(direction);
+        int face;
+        float sc, tc, ma;
+        if (a.x >= a.y && a.x >= a.z)
+        {
+            face = direction.x > 0.0f ? 0 : 1;
+            sc = direction.x > 0.0f ? -direction.z : direction.z;
+            tc = -direction.y;
+            ma = a.x;
+        }
+        else if (a.y >= a.z)
+        {
+            face = direction.y > 0.0f ? 2 : 3;
+            sc = direction.x;
+            tc = direction.y > 0.0f ? direction.z : -direction.z;
+            ma = a.y;
+        }
+        else
+        {
+            face = direction.z > 0.0f ? 4 : 5;
+            sc = direction.z > 0.0f ? direction.x : -direction.x;
+            tc = -direction.y;
+            ma = a.z;
+        }
+
+        float x = ((sc / ma + 1.0f) * 0.5f) * size - 0.5f;
+        float y = ((tc / ma + 1.0f) * 0.5f) * size - 0.5f;
+        x = std::min(std::max(x, 0.0f), (float)(size - 1));
+        y = std::min(std::max(y, 0.0f), (float)(size - 1));
+        int x0 = (int)x, y0 = (int)y;
+        int x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+        float fx = x - x0, fy = y - y0;
+
+        glm::vec3 result(0.0f);
+        for (int c = 0; c < 3; c++)
+        {
+            float top = Texel(face, x0, y0)[c] * (1.0f - fx) + Texel(face, x1, y0)[c] * fx;
+            float bottom = Texel(face, x0, y1)[c] * (1.0f - fx) + Texel(face, x1, y1)[c] * fx;
+            result[c] = top * (1.0f - fy) + bottom * fy;
+        }
+        return result;
+    }
+};
+
+// Environment with its box filtered mip chain, sampled like textureLod with trilinear filtering
+struct MipmappedCubemap
+{
+    std::vector<Cubemap> levels;
+
+    glm::vec3 Sample(const glm::vec3 &direction, float lod) const
+    {
+        lod = std::min(std::max(lod, 0.0f), (float)(levels.size() - 1));
+        int level = (int)lod;
+        float blend = lod - level;
+        glm::vec3 color = levels[level].Sample(direction);
+        if (blend > 0.0f && level + 1 < (int)levels.size())
+            color = color * (1.0f - blend) + levels[level + 1].Sample(direction) * blend;
+        return color;
+    }
+};
+
+// Bilinear lookup into the equirectangular image, uv as computed by equirectangular_to_cubemap.frag
+static glm::vec3 sampleEquirectangular(const float *image, int width, int height, const glm::vec3 &direction)
+{
+    float u = std::atan2(direction.z, direction.x) * 0.1591f + 0.5f;
+    float v = std::asin(std::min(std::max(direction.y, -1.0f), 1.0f)) * 0.3183f + 0.5f;
+
+    float x = std::min(std::max(u * width - 0.5f, 0.0f), (float)(width - 1));
+    float y = std::min(std::max(v * height - 0.5f, 0.0f), (float)(height - 1));
+    int x0 = (int)x, y0 = (int)y;
+    int x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+    float fx = x - x0, fy = y - y0;
+
+    glm::vec3 result(0.0f);
+    for (int c = 0; c < 3; c++)
+    {
+        float top = image[((size_t)y0 * width + x0) * 3 + c] * (1.0f - fx) + image[((size_t)y0 * width + x1) * 3 + c] * fx;
+        float bottom = image[((size_t)y1 * width + x0) * 3 + c] * (1.0f - fx) + image[((size_t)y1 * width + x1) * 3 + c] * fx;
+        result[c] = top * (1.0f - fy) + bottom * fy;
+    }
+    return result;
+}
+
+static void bakeEnvironment(ThreadPool &pool, const float *image, int width, int height, MipmappedCubemap &environment)
+{
+    environment.levels.resize(1);
+    Cubemap &base = environment.levels[0];
+    base.Allocate(IBL_ENVIRONMENT_SIZE);
+    pool.ParallelFor(6 * (size_t)base.size, [&](size_t job)
+                     {
+                         int face = (int)(job / base.size), y = (int)(job % base.size);
+                         for (int x = 0; x < base.size; x++)
+                         {
+                             glm::vec3 color = sampleEquirectangular(image, width, height, SH9::TexelDirection(face, x, y, base.size));
+                             std::memcpy(base.Texel(face, x, y), &color[0], sizeof(float) * 3);
+                         } });
+
+    // 2x2 box filter down to 1x1, what glGenerateMipmap gives on the GPU
+    while (environment.levels.back().size > 1)
+    {
+        const Cubemap &source = environment.levels.back();
+        Cubemap level;
+        level.Allocate(source.size / 2);
+        pool.ParallelFor(6 * (size_t)level.size, [&](size_t job)
+                         {
+                             int face = (int)(job / level.size), y = (int)(job % level.size);
+                             for (int x = 0; x < level.size; x++)
+                             {
+                                 for (int c = 0; c < 3; c++)
+                                 {
+                                     level.Texel(face, x, y)[c] = 0.25f * (source.Texel(face, 2 * x, 2 * y)[c] + source.Texel(face, 2 * x + 1, 2 * y)[c] +
+                                                                           source.Texel(face, 2 * x, 2 * y + 1)[c] + source.Texel(face, 2 * x + 1, 2 * y + 1)[c]);
+                                 }
+                             } });
+        environment.levels.push_back(std::move(level));
+    }
+}
+
+// Same estimator as pre-filter.frag (N = V = R, GGX importance sampling, source lod from the sample's pdf).
+// The sample set only depends on the roughness, so it is built once per level in tangent space.
+static void bakePrefilter(ThreadPool &pool, const MipmappedCubemap &environment, std::vector<Cubemap> &prefilter)
+{
+    prefilter.resize(IBL_PREFILTER_LEVELS);
+    // Texel solid angle of the source's top level, as pre-filter.frag gets it through 'sourceSize'
+    const float resolution = (float)environment.levels[0].size;
+    const float saTexel = 4.0f * PI / (6.0f * resolution * resolution);
+
+    for (int mip = 0; mip < IBL_PREFILTER_LEVELS; mip++)
+    {
+        float roughness = (float)mip / (float)(IBL_PREFILTER_LEVELS - 1);
+        Cubemap &level = prefilter[mip];
+        level.Allocate(IBL_PREFILTER_SIZE >> mip);
+
+        std::vector<glm::vec3> directions;
+        std::vector<float> weights, lods;
+        for (unsigned int i = 0; i < SAMPLE_COUNT; i++)
+        {
+            float x, y;
+            hammersley(i, SAMPLE_COUNT, x, y);
+            glm::vec3 h = importanceSampleGGX(x, y, roughness);
+            glm::vec3 l = glm::vec3(2.0f * h.z * h.x, 2.0f * h.z * h.y, 2.0f * h.z * h.z - 1.0f);
+            if (l.z <= 0.0f)
+                continue;
+
+            float a = roughness * roughness;
+            float denom = h.z * h.z * (a * a - 1.0f) + 1.0f;
+            float d = a * a / (PI * denom * denom);
+            float pdf = d * h.z / (4.0f * h.z) + 0.0001f;
+            float saSample = 1.0f / (SAMPLE_COUNT * pdf + 0.0001f);
+
+            directions.push_back(glm::normalize(l));
+            weights.push_back(l.z);
+            lods.push_back(roughness == 0.0f ? 0.0f : 0.5f * std::log2(saSample / saTexel));
+        }
+
+        pool.ParallelFor(6 * (size_t)level.size, [&](size_t job)
+                         {
+                             int face = (int)(job / level.size), y = (int)(job % level.size);
+                             for (int x = 0; x < level.size; x++)
+                             {
+                                 glm::vec3 n = SH9::TexelDirection(face, x, y, level.size);
+                                 glm::vec3 color(0.0f);
+                                 if (roughness == 0.0f)
+                                 {
+                                     // Every sample is the normal itself
+                                     color = environment.Sample(n, 0.0f);
+                                 }
+                                 else
+                                 {
+                                     glm::vec3 up = std::abs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+                                     glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+                                     glm::vec3 bitangent = glm::cross(n, tangent);
+                                     float totalWeight = 0.0f;
+                                     for (size_t i = 0; i < directions.size(); i++)
+                                     {
+                                         glm::vec3 l = tangent * directions[i].x + bitangent * directions[i].y + n * directions[i].z;
+                                         color += environment.Sample(l, lods[i]) * weights[i];
+                                         totalWeight += weights[i];
+                                     }
+                                     color /= totalWeight;
+                                 }
+                                 std::memcpy(level.Texel(face, x, y), &color[0], sizeof(float) * 3);
+                             } });
+    }
+}
+
+// Half vectors around N = +Z for one roughness, rounded up to whole lanes (padding has zero weight)
+struct BRDFSamples
+{
+    std::vector<float> hx, hz, valid;
+};
+
+// Sums of the split sum terms (scale and bias of F0) over every sample, one at a time like brdf.frag
+static void brdfSumsScalar(const BRDFSamples &samples, float vx, float vz, float k, float gV, float &a, float &b)
+{
+    a = b = 0.0f;
+    for (unsigned int i = 0; i < SAMPLE_COUNT; i++)
+    {
+        float x = samples.hx[i], z = samples.hz[i];
+        float vDotH = std::max(vx * x + vz * z, 0.0f);
+        float nDotL = 2.0f * vDotH * z - vz;
+        if (nDotL <= 0.0f)
+            continue;
+
+        float gL = nDotL / (nDotL * (1.0f - k) + k);
+        float gVis = gV * gL * vDotH / (z * vz);
+        float f = 1.0f - vDotH;
+        float fc = f * f * f * f * f;
+        a += (1.0f - fc) * gVis;
+        b += fc * gVis;
+    }
+}
+
+#ifdef IBL_BAKER_SSE2
+// Same sums four samples at a time, samples behind the light are masked out instead of skipped
+static void brdfSumsSSE2(const BRDFSamples &samples, float vx, float vz, float k, float gV, float &a, float &b)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 viewX = _mm_set1_ps(vx), viewZ = _mm_set1_ps(vz);
+    const __m128 kk = _mm_set1_ps(k), oneMinusK = _mm_set1_ps(1.0f - k);
+    const __m128 geometryV = _mm_set1_ps(gV);
+    __m128 sumA = zero, sumB = zero;
+    for (size_t i = 0; i < samples.hx.size(); i += LANES)
+    {
+        __m128 x = _mm_loadu_ps(&samples.hx[i]);
+        __m128 z = _mm_loadu_ps(&samples.hz[i]);
+        __m128 vDotH = _mm_max_ps(_mm_add_ps(_mm_mul_ps(viewX, x), _mm_mul_ps(viewZ, z)), zero);
+        __m128 nDotL = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, vDotH), z), viewZ);
+        __m128 mask = _mm_and_ps(_mm_cmpgt_ps(nDotL, zero), _mm_cmpgt_ps(_mm_loadu_ps(&samples.valid[i]), zero));
+        nDotL = _mm_max_ps(nDotL, zero);
+
+        __m128 gL = _mm_div_ps(nDotL, _mm_add_ps(_mm_mul_ps(nDotL, oneMinusK), kk));
+        __m128 gVis = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(geometryV, gL), vDotH), _mm_mul_ps(z, viewZ));
+        gVis = _mm_and_ps(mask, gVis);
+        __m128 f = _mm_sub_ps(one, vDotH);
+        __m128 f2 = _mm_mul_ps(f, f);
+        __m128 fc = _mm_mul_ps(_mm_mul_ps(f2, f2), f);
+        sumA = _mm_add_ps(sumA, _mm_mul_ps(_mm_sub_ps(one, fc), gVis));
+        sumB = _mm_add_ps(sumB, _mm_mul_ps(fc, gVis));
+    }
+
+    float lanesA[LANES], lanesB[LANES];
+    _mm_storeu_ps(lanesA, sumA);
+    _mm_storeu_ps(lanesB, sumB);
+    a = lanesA[0] + lanesA[1] + lanesA[2] + lanesA[3];
+    b = lanesB[0] + lanesB[1] + lanesB[2] + lanesB[3];
+}
+#endif
+
+// Split sum BRDF term of brdf.frag, stored as RG with NdotV along x and roughness along y.
+// 'scalar' forces the reference loop even where SSE2 is available.
+static void bakeBRDF(ThreadPool &pool, std::vector<float> &lut, bool scalar)
+{
+    const int size = IBL_BRDF_SIZE;
+    lut.assign((size_t)size * size * 2, 0.0f);
+
+    pool.ParallelFor(size, [&](size_t row)
+                     {
+                         float roughness = (row + 0.5f) / size;
+                         float k = roughness * roughness / 2.0f;
+
+                         size_t padded = (SAMPLE_COUNT + LANES - 1) / LANES * LANES;
+                         BRDFSamples samples;
+                         samples.hx.assign(padded, 0.0f);
+                         samples.hz.assign(padded, 1.0f);
+                         samples.valid.assign(padded, 0.0f);
+                         for (unsigned int i = 0; i < SAMPLE_COUNT; i++)
+                         {
+                             float x, y;
+                             hammersley(i, SAMPLE_COUNT, x, y);
+                             glm::vec3 h = importanceSampleGGX(x, y, roughness);
+                             // V lies in the xz plane, so H's y never enters the sums
+                             samples.hx[i] = h.x;
+                             samples.hz[i] = h.z;
+                             samples.valid[i] = 1.0f;
+                         }
+
+                         for (int column = 0; column < size; column++)
+                         {
+                             float nDotV = (column + 0.5f) / size;
+                             float vx = std::sqrt(1.0f - nDotV * nDotV), vz = nDotV;
+                             float gV = nDotV / (nDotV * (1.0f - k) + k);
+
+                             float a, b;
+#ifdef IBL_BAKER_SSE2
+                             if (!scalar)
+                                 brdfSumsSSE2(samples, vx, vz, k, gV, a, b);
+                             else
+#endif
+                                 brdfSumsScalar(samples, vx, vz, k, gV, a, b);
+                             lut[(row * size + column) * 2] = a / SAMPLE_COUNT;
+                             lut[(row * size + column) * 2 + 1] = b / SAMPLE_COUNT;
+                         } });
+}
+
+// Converts float texels to the half floats the cache stores
+static void appendHalves(ThreadPool &pool, const std::vector<float> &source, std::vector<uint16_t> &destination)
+{
+    size_t offset = destination.size();
+    destination.resize(offset + source.size());
+    const size_t chunk = 1 << 16;
+    pool.ParallelFor((source.size() + chunk - 1) / chunk, [&](size_t job)
+                     {
+                         size_t end = std::min(source.size(), (job + 1) * chunk);
+                         for (size_t i = job * chunk; i < end; i++)
+                             destination[offset + i] = FloatToHalf(source[i]); });
+}
+
+// Prints the error of every level of texture 't', false if any level's RMSE relative to the reference's mean exceeds 'tolerance'
+static bool compareTexture(size_t t, const CachedTexture &texture, const uint16_t *reference, const uint16_t *test, float tolerance)
+{
+    bool passed = true;
+    size_t components = texture.format == GL_RG ? 2 : 3;
+    size_t faces = texture.target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    for (GLint level = 0; level < texture.levels; level++)
+    {
+        size_t side = std::max(1, texture.size >> level);
+        size_t count = side * side * components * faces;
+        double squared = 0.0, magnitude = 0.0, maxError = 0.0;
+        for (size_t i = 0; i < count; i++)
+        {
+            double a = HalfToFloat(reference[i]);
+            double b = HalfToFloat(test[i]);
+            squared += (a - b) * (a - b);
+            magnitude += std::abs(a);
+            maxError = std::max(maxError, std::abs(a - b));
+        }
+        reference += count;
+        test += count;
+
+        double rmse = std::sqrt(squared / count);
+        double relative = rmse / std::max(magnitude / count, 1e-6);
+        bool ok = relative <= tolerance;
+        passed &= ok;
+        std::cout << "texture " << t << " level " << level << ": RMSE " << rmse << " (" << relative * 100.0 << "% of mean), max error "
+                  << maxError << (ok ? "" : "  <-- over tolerance") << std::endl;
+    }
+    return passed;
+}
+
+static int bake(const std::string &hdrPath, const std::string &folder, unsigned int threads)
+{
+    ThreadPool pool(threads);
+    std::cout << "Baking " << hdrPath << " on " << pool.Size() + 1 << " thread(s)" << std::endl;
+
+    Clock::time_point total = Clock::now();
+    Clock::time_point start = Clock::now();
+    // Same orientation as Skybox::LoadHDR
+    stbi_set_flip_vertically_on_load(true);
+    int width, height, components;
+    float *image = stbi_loadf(hdrPath.c_str(), &width, &height, &components, 3);
+    if (!image)
+    {
+        std::cerr << "Failed to load HDR image " << hdrPath << std::endl;
+        return 1;
+    }
+    uint64_t key = IBLCache::EnvironmentKey(hdrPath);
+    std::cout << "  load        " << millisecondsSince(start) << " ms (" << width << "x" << height << ")" << std::endl;
+
+    start = Clock::now();
+    MipmappedCubemap environment;
+    bakeEnvironment(pool, image, width, height, environment);
+    stbi_image_free(image);
+    std::cout << "  cubemap     " << millisecondsSince(start) << " ms" << std::endl;
+
+    // Skybox projects the irradiance harmonics at load time, this only times that step
+    start = Clock::now();
+    const Cubemap *shSource = &environment.levels[0];
+    for (const Cubemap &level : environment.levels)
+    {
+        if (level.size >= IBL_SH_SOURCE_SIZE)
+            shSource = &level;
+    }
+    const float *shFaces[6];
+    for (int face = 0; face < 6; face++)
+        shFaces[face] = shSource->faces[face].data();
+    SH9 irradiance = SH9::ProjectCubemap(shFaces, shSource->size, pool);
+    irradiance.ConvolveCosine();
+    std::cout << "  SH project  " << millisecondsSince(start) << " ms" << std::endl;
+
+    start = Clock::now();
+    std::vector<Cubemap> prefilter;
+    bakePrefilter(pool, environment, prefilter);
+    std::cout << "  prefilter   " << millisecondsSince(start) << " ms" << std::endl;
+
+    start = Clock::now();
+    std::vector<float> lut;
+    bakeBRDF(pool, lut, false);
+    std::cout << "  BRDF LUT    " << millisecondsSince(start) << " ms" << std::endl;
+
+#ifdef IBL_BAKER_SSE2
+    // Nothing is written unless the SSE2 sums match the scalar loop, checked like --compare checks two caches
+    start = Clock::now();
+    std::vector<float> referenceLut;
+    bakeBRDF(pool, referenceLut, true);
+    std::vector<uint16_t> referenceHalves, fastHalves;
+    appendHalves(pool, referenceLut, referenceHalves);
+    appendHalves(pool, lut, fastHalves);
+    CachedTexture lutLayout = {0, GL_TEXTURE_2D, GL_RG16F, GL_RG, IBL_BRDF_SIZE, 1};
+    bool verified = compareTexture(0, lutLayout, referenceHalves.data(), fastHalves.data(), VERIFY_TOLERANCE);
+    std::cout << "  verify      " << millisecondsSince(start) << " ms, SSE2 BRDF LUT against the scalar loop: " << (verified ? "PASS" : "FAIL") << std::endl;
+    if (!verified)
+        return 1;
+#endif
+
+    // Same textures, in the same order, as Skybox::saveEnvironment
+    start = Clock::now();
+    std::vector<std::vector<uint16_t>> halves(2);
+    for (const std::vector<float> &face : environment.levels[0].faces)
+        appendHalves(pool, face, halves[0]);
+    for (const Cubemap &level : prefilter)
+    {
+        for (const std::vector<float> &face : level.faces)
+            appendHalves(pool, face, halves[1]);
+    }
+
+    std::vector<CachedTexture> textures(2);
+    textures[0] = {0, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, IBL_ENVIRONMENT_SIZE, 1};
+    textures[1] = {0, GL_TEXTURE_CUBE_MAP, GL_RGB16F, GL_RGB, IBL_PREFILTER_SIZE, IBL_PREFILTER_LEVELS};
+    bool written = IBLCache::WritePixels(folder + IBLCache::EnvironmentFile(key), key, textures,
+                                         {halves[0].data(), halves[1].data()});
+
+    std::vector<uint16_t> lutHalves;
+    appendHalves(pool, lut, lutHalves);
+    std::vector<CachedTexture> lutTexture = {{0, GL_TEXTURE_2D, GL_RG16F, GL_RG, IBL_BRDF_SIZE, 1}};
+    written &= IBLCache::WritePixels(folder + "brdf_lut.cache", IBL_CACHE_VERSION, lutTexture, {lutHalves.data()});
+    std::cout << "  write       " << millisecondsSince(start) << " ms" << std::endl;
+
+    if (!written)
+        return 1;
+    std::cout << "Wrote " << folder << IBLCache::EnvironmentFile(key) << " and " << folder << "brdf_lut.cache in "
+              << millisecondsSince(total) << " ms" << std::endl;
+    return 0;
+}
+
+// Per level error of 'test' against 'reference', fails if any level's RMSE relative to the reference's mean exceeds 'tolerance'
+static int compare(const std::string &referencePath, const std::string &testPath, float tolerance)
+{
+    MappedFile referenceFile, testFile;
+    try
+    {
+        referenceFile = MappedFile(referencePath);
+        testFile = MappedFile(testPath);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cout << "FAIL" << std::endl;
+        return 1;
+    }
+    uint64_t referenceKey, testKey;
+    std::vector<CachedTexture> referenceTextures, testTextures;
+    std::vector<const unsigned char *> referencePixels, testPixels;
+    if (!IBLCache::Parse(referenceFile.Data(), referenceFile.Size(), referenceKey, referenceTextures, referencePixels) ||
+        !IBLCache::Parse(testFile.Data(), testFile.Size(), testKey, testTextures, testPixels))
+    {
+        std::cerr << "Not a valid IBL cache file" << std::endl;
+        std::cout << "FAIL" << std::endl;
+        return 1;
+    }
+    if (referenceTextures.size() != testTextures.size())
+    {
+        std::cerr << "Texture count differs" << std::endl;
+        std::cout << "FAIL" << std::endl;
+        return 1;
+    }
+
+    bool passed = true;
+    for (size_t t = 0; t < referenceTextures.size(); t++)
+    {
+        const CachedTexture &texture = referenceTextures[t];
+        const CachedTexture &other = testTextures[t];
+        if (texture.size != other.size || texture.levels != other.levels || texture.format != other.format || texture.target != other.target)
+        {
+            std::cerr << "Texture " << t << " layout differs" << std::endl;
+            std::cout << "FAIL" << std::endl;
+            return 1;
+        }
+
+        passed &= compareTexture(t, texture, reinterpret_cast<const uint16_t *>(referencePixels[t]),
+                                 reinterpret_cast<const uint16_t *>(testPixels[t]), tolerance);
+    }
+
+    std::cout << (passed ? "PASS" : "FAIL") << std::endl;
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 4 && std::strcmp(argv[1], "--compare") == 0)
+        return compare(argv[2], argv[3], argc > 4 ? (float)std::atof(argv[4]) : 0.05f);
+
+    std::string hdrPath;
+    std::string folder = "saveData/";
+    unsigned int threads = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = (unsigned int)std::atoi(argv[++i]);
+        else if (hdrPath.empty())
+            hdrPath = argv[i];
+        else
+            folder = argv[i];
+    }
+    if (hdrPath.empty())
+    {
+        std::cerr << "Usage: iblBaker <file.hdr> [output folder] [--threads N]" << std::endl
+                  << "       iblBaker --compare <reference.cache> <test.cache> [tolerance]" << std::endl;
+        return 1;
+    }
+    if (folder.back() != '/' && folder.back() != '\\')
+        folder += '/';
+
+    return bake(hdrPath, folder, threads);
+}
@@ -0,0 +1,390 @@
+// Headless benchmark of glTF geometry decoding: the original getFloats/getIndices path (one push_back per
+// float, then regrouped into vectors and vertices) against AccessorView copying straight into the vertices.
+// Runs on the bundled models and on a synthetic grid of size x size vertices.
+// Usage: loadBench [grid size] [runs] [model.gltf...]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "accessor.h"
+#include "mappedFile.h"
+#include "VBO.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// A glTF document and the bytes of its first buffer
+struct Asset
+{
+    std::string name;
+    json gltf;
+    std::vector<unsigned char> data;
+};
+
+// Decoded geometry of every primitive, kept so the two paths can be compared
+struct Geometry
+{
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+};
+
+// The decoding Model used before AccessorView, copied here unchanged apart from sequencing the reads
+namespace original
+{
+    std::vector<float> getFloats(const json &gltf, const std::vector<unsigned char> &data, json accessor)
+    {
+        std::vector<float> floatVec;
+
+        unsigned int buffViewInd = accessor.value("bufferView", 1);
+        unsigned int count = accessor["count"];
+        unsigned int accByteOffset = accessor.value("byteOffset", 0);
+        std::string type = accessor["type"];
+
+        json bufferView = gltf["bufferViews"][buffViewInd];
+        unsigned int byteOffset = bufferView["byteOffset"];
+
+        unsigned int numPerVert;
+        if (type == "SCALAR")
+            numPerVert = 1;
+        else if (type == "VEC2")
+            numPerVert = 2;
+        else if (type == "VEC3")
+            numPerVert = 3;
+        else if (type == "VEC4")
+            numPerVert = 4;
+        else
+            throw std::invalid_argument("Type is invalid (not SCALAR, VEC2, VEC3, or VEC4)");
+
+        unsigned int beginningOfData = byteOffset + accByteOffset;
+        unsigned int lengthOfData = count * 4 * numPerVert;
+        for (unsigned int i = beginningOfData; i < beginningOfData + lengthOfData;)
+        {
+            unsigned char bytes[] = {data[i++], data[i++], data[i++], data[i++]};
+            float value;
+            std::memcpy(&value, bytes, sizeof(float));
+            floatVec.push_back(value);
+        }
+
+        return floatVec;
+    }
+
+    std::vector<GLuint> getIndices(const json &gltf, const std::vector<unsigned char> &data, json accessor)
+    {
+        std::vector<GLuint> indices;
+
+        unsigned int buffViewInd = accessor.value("bufferView", 0);
+        unsigned int count = accessor["count"];
+        unsigned int accByteOffset = accessor.value("byteOffset", 0);
+        unsigned int componentType = accessor["componentType"];
+
+        json bufferView = gltf["bufferViews"][buffViewInd];
+        unsigned int byteOffset = bufferView["byteOffset"];
+
+        unsigned int beginningOfData = byteOffset + accByteOffset;
+        if (componentType == 5125)
+        {
+            for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 4;)
+            {
+                unsigned char bytes[] = {data[i++], data[i++], data[i++], data[i++]};
+                unsigned int value;
+                std::memcpy(&value, bytes, sizeof(unsigned int));
+                indices.push_back((GLuint)value);
+            }
+        }
+        else if (componentType == 5123)
+        {
+            for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 2;)
+            {
+                unsigned char bytes[] = {data[i++], data[i++]};
+                unsigned short value;
+                std::memcpy(&value, bytes, sizeof(unsigned short));
+                indices.push_back((GLuint)value);
+            }
+        }
+        else if (componentType == 5122)
+        {
+            for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 2;)
+            {
+                unsigned char bytes[] = {data[i++], data[i++]};
+                short value;
+                std::memcpy(&value, bytes, sizeof(short));
+                indices.push_back((GLuint)value);
+            }
+        }
+
+        return indices;
+    }
+
+    std::vector<glm::vec2> groupFloatsVec2(std::vector<float> floatVec)
+    {
+        std::vector<glm::vec2> vectors;
+        for (size_t i = 0; i + 1 < floatVec.size(); i += 2)
+            vectors.push_back(glm::vec2(floatVec[i], floatVec[i + 1]));
+        return vectors;
+    }
+
+    std::vector<glm::vec3> groupFloatsVec3(std::vector<float> floatVec)
+    {
+        std::vector<glm::vec3> vectors;
+        for (size_t i = 0; i + 2 < floatVec.size(); i += 3)
+            vectors.push_back(glm::vec3(floatVec[i], floatVec[i + 1], floatVec[i + 2]));
+        return vectors;
+    }
+
+    std::vector<Vertex> assembleVertices(
+        std::vector<glm::vec3> positions,
+        std::vector<glm::vec3> normals,
+        std::vector<glm::vec2> texUVs)
+    {
+        std::vector<Vertex> vertices;
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            vertices.push_back(
+                Vertex{
+                    positions[i],
+                    normals[i],
+                    texUVs[i]});
+        }
+        return vertices;
+    }
+
+    Geometry decode(const Asset &asset, const json &primitive)
+    {
+        const json &gltf = asset.gltf;
+        const json &attributes = primitive["attributes"];
+        std::vector<glm::vec3> positions = groupFloatsVec3(getFloats(gltf, asset.data, gltf["accessors"][(unsigned int)attributes["POSITION"]]));
+        std::vector<glm::vec3> normals = groupFloatsVec3(getFloats(gltf, asset.data, gltf["accessors"][(unsigned int)attributes["NORMAL"]]));
+        std::vector<glm::vec2> texUVs = groupFloatsVec2(getFloats(gltf, asset.data, gltf["accessors"][(unsigned int)attributes["TEXCOORD_0"]]));
+
+        Geometry geometry;
+        geometry.vertices = assembleVertices(positions, normals, texUVs);
+        geometry.indices = getIndices(gltf, asset.data, gltf["accessors"][(unsigned int)primitive["indices"]]);
+        return geometry;
+    }
+}
+
+// The current path, the same calls Model::decodePrimitive makes
+static Geometry decodeViews(const Asset &asset, const json &primitive)
+{
+    const json &gltf = asset.gltf;
+    const json &attributes = primitive["attributes"];
+    const unsigned char *data = asset.data.data();
+    size_t dataSize = asset.data.size();
+    AccessorView positions(gltf, gltf["accessors"][(unsigned int)attributes["POSITION"]], data, dataSize);
+    AccessorView normals(gltf, gltf["accessors"][(unsigned int)attributes["NORMAL"]], data, dataSize);
+    AccessorView texUVs(gltf, gltf["accessors"][(unsigned int)attributes["TEXCOORD_0"]], data, dataSize);
+    AccessorView indices(gltf, gltf["accessors"][(unsigned int)primitive["indices"]], data, dataSize);
+
+    Geometry geometry;
+    geometry.vertices.resize(positions.count);
+    if (!geometry.vertices.empty())
+    {
+        positions.CopyFloats(&geometry.vertices[0].position.x, 3, sizeof(Vertex));
+        normals.CopyFloats(&geometry.vertices[0].normal.x, 3, sizeof(Vertex));
+        texUVs.CopyFloats(&geometry.vertices[0].texUV.x, 2, sizeof(Vertex));
+    }
+    geometry.indices.resize(indices.count);
+    indices.CopyIndices(geometry.indices.data());
+    return geometry;
+}
+
+// The original path only read tightly packed float attributes and integer indices
+static bool decodable(const json &gltf, const json &primitive)
+{
+    const json &attributes = primitive["attributes"];
+    if (!primitive.contains("indices"))
+        return false;
+    for (const char *attribute : {"POSITION", "NORMAL", "TEXCOORD_0"})
+    {
+        if (!attributes.contains(attribute))
+            return false;
+        const json &accessor = gltf["accessors"][(unsigned int)attributes[attribute]];
+        if (accessor["componentType"] != COMPONENT_FLOAT || !accessor.contains("bufferView"))
+            return false;
+        if (gltf["bufferViews"][(unsigned int)accessor["bufferView"]].contains("byteStride"))
+            return false;
+    }
+    return true;
+}
+
+static Asset loadAsset(const std::string &path)
+{
+    Asset asset;
+    asset.name = path;
+    MappedFile file(path);
+    asset.gltf = json::parse(file.Data(), file.Data() + file.Size());
+
+    std::string uri = asset.gltf["buffers"][0]["uri"];
+    MappedFile bin(path.substr(0, path.find_last_of('/') + 1) + uri);
+    asset.data.assign(bin.Data(), bin.Data() + bin.Size());
+    return asset;
+}
+
+// A flat grid of size x size vertices with float positions, normals and UVs and 32 bit indices
+static Asset syntheticGrid(unsigned int size)
+{
+    size_t vertexCount = (size_t)size * size;
+    size_t indexCount = (size_t)(size - 1) * (size - 1) * 6;
+    size_t positionsOffset = 0;
+    size_t normalsOffset = positionsOffset + vertexCount * 12;
+    size_t uvsOffset = normalsOffset + vertexCount * 12;
+    size_t indicesOffset = uvsOffset + vertexCount * 8;
+
+    Asset asset;
+    asset.name = "synthetic " + std::to_string(size) + "x" + std::to_string(size) + " grid";
+    asset.data.resize(indicesOffset + indexCount * 4);
+    float *positions = (float *)&asset.data[positionsOffset];
+    float *normals = (float *)&asset.data[normalsOffset];
+    float *uvs = (float *)&asset.data[uvsOffset];
+    GLuint *indices = (GLuint *)&asset.data[indicesOffset];
+    for (unsigned int y = 0; y < size; y++)
+    {
+        for (unsigned int x = 0; x < size; x++)
+        {
+            size_t v = (size_t)y * size + x;
+            float u = (float)x / (size - 1), w = (float)y / (size - 1);
+            positions[v * 3 + 0] = u * 2.0f - 1.0f;
+            positions[v * 3 + 1] = 0.0f;
+            positions[v * 3 + 2] = w * 2.0f - 1.0f;
+            normals[v * 3 + 0] = 0.0f;
+            normals[v * 3 + 1] = 1.0f;
+            normals[v * 3 + 2] = 0.0f;
+            uvs[v * 2 + 0] = u;
+            uvs[v * 2 + 1] = w;
+        }
+    }
+    for (unsigned int y = 0; y + 1 < size; y++)
+    {
+        for (unsigned int x = 0; x + 1 < size; x++)
+        {
+            GLuint corner = y * size + x;
+            GLuint quad[] = {corner, corner + size, corner + 1, corner + 1, corner + size, corner + size + 1};
+            std::memcpy(indices, quad, sizeof(quad));
+            indices += 6;
+        }
+    }
+
+    json &gltf = asset.gltf;
+    gltf["buffers"] = json::array({{{"byteLength", asset.data.size()}}});
+    gltf["bufferViews"] = json::array({
+        {{"buffer", 0}, {"byteOffset", positionsOffset}, {"byteLength", vertexCount * 12}},
+        {{"buffer", 0}, {"byteOffset", normalsOffset}, {"byteLength", vertexCount * 12}},
+        {{"buffer", 0}, {"byteOffset", uvsOffset}, {"byteLength", vertexCount * 8}},
+        {{"buffer", 0}, {"byteOffset", indicesOffset}, {"byteLength", indexCount * 4}}});
+    gltf["accessors"] = json::array({
+        {{"bufferView", 0}, {"componentType", COMPONENT_FLOAT}, {"count", vertexCount}, {"type", "VEC3"}},
+        {{"bufferView", 1}, {"componentType", COMPONENT_FLOAT}, {"count", vertexCount}, {"type", "VEC3"}},
+        {{"bufferView", 2}, {"componentType", COMPONENT_FLOAT}, {"count", vertexCount}, {"type", "VEC2"}},
+        {{"bufferView", 3}, {"componentType", COMPONENT_UNSIGNED_INT}, {"count", indexCount}, {"type", "SCALAR"}}});
+    gltf["meshes"] = json::array({{{"primitives", json::array({{{"attributes", {{"POSITION", 0}, {"NORMAL", 1}, {"TEXCOORD_0", 2}}}, {"indices", 3}}})}}});
+    return asset;
+}
+
+static bool sameGeometry(const std::vector<Geometry> &a, const std::vector<Geometry> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].indices != b[i].indices || a[i].vertices.size() != b[i].vertices.size())
+            return false;
+        if (!a[i].vertices.empty() && std::memcmp(a[i].vertices.data(), b[i].vertices.data(), a[i].vertices.size() * sizeof(Vertex)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Decodes every primitive of 'asset' with both paths, best of 'runs' for each
+static void benchmark(const Asset &asset, int runs)
+{
+    std::vector<const json *> primitives;
+    size_t skipped = 0;
+    for (const json &mesh : asset.gltf["meshes"])
+    {
+        for (const json &primitive : mesh["primitives"])
+        {
+            if (decodable(asset.gltf, primitive))
+                primitives.push_back(&primitive);
+            else
+                skipped++;
+        }
+    }
+
+    std::vector<Geometry> before, after;
+    double originalTime = 1e30, viewTime = 1e30;
+    for (int run = 0; run < runs; run++)
+    {
+        Clock::time_point start = Clock::now();
+        before.clear();
+        for (const json *primitive : primitives)
+            before.push_back(original::decode(asset, *primitive));
+        originalTime = std::min(originalTime, millisecondsSince(start));
+
+        start = Clock::now();
+        after.clear();
+        for (const json *primitive : primitives)
+            after.push_back(decodeViews(asset, *primitive));
+        viewTime = std::min(viewTime, millisecondsSince(start));
+    }
+
+    size_t vertices = 0, indices = 0;
+    for (const Geometry &geometry : after)
+    {
+        vertices += geometry.vertices.size();
+        indices += geometry.indices.size();
+    }
+
+    std::cout << asset.name << ": " << primitives.size() << " primitive(s), " << vertices << " vertices, "
+              << indices / 3 << " triangles";
+    if (skipped > 0)
+        std::cout << " (" << skipped << " skipped, not readable by the original path)";
+    std::cout << std::endl;
+    std::cout << "  getFloats/getIndices " << originalTime << " ms, AccessorView " << viewTime << " ms, "
+              << (viewTime > 0.0 ? originalTime / viewTime : 0.0) << "x"
+              << (sameGeometry(before, after) ? "" : "  MISMATCH") << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int gridSize = argc > 1 ? (unsigned int)std::max(2, std::atoi(argv[1])) : 1024;
+    int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    std::vector<std::string> paths;
+    for (int i = 3; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+    {
+        paths = {"res/models/monkey/monkey.gltf",
+                 "res/models/Shapes/abstract.gltf",
+                 "res/models/Shapes/bg.gltf",
+                 "res/models/Shapes/cube.gltf",
+                 "res/models/Shapes/icosphere.gltf",
+                 "res/models/Shapes/sphere.gltf"};
+    }
+
+    std::cout << "Best of " << runs << " run(s)" << std::endl;
+    for (const std::string &path : paths)
+    {
+        try
+        {
+            benchmark(loadAsset(path), runs);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << path << ": " << e.what() << std::endl;
+        }
+    }
+    benchmark(syntheticGrid(gridSize), runs);
+    return 0;
+}
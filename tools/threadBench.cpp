@@ -0,0 +1,241 @@
+// Headless benchmark of the import work Model::loadMeshes spreads over the thread pool: decoding, MeshOptimizer
+// and LOD generation of every primitive, repeated at 1 to N threads (the caller counts as one, like ParallelFor).
+// The bundled models are joined by a set of synthetic meshes so there are enough primitives to share out.
+// Usage: threadBench [max threads] [synthetic meshes] [runs] [model.gltf...]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "accessor.h"
+#include "mappedFile.h"
+#include "meshOptimizer.h"
+#include "renderStats.h"
+#include "threadPool.h"
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// A glTF document and the bytes of its first buffer
+struct Asset
+{
+    json gltf;
+    std::vector<unsigned char> data;
+};
+
+// One primitive to import
+struct Job
+{
+    const Asset *asset;
+    const json *primitive;
+};
+
+static Asset loadAsset(const std::string &path)
+{
+    Asset asset;
+    MappedFile file(path);
+    asset.gltf = json::parse(file.Data(), file.Data() + file.Size());
+
+    std::string uri = asset.gltf["buffers"][0]["uri"];
+    MappedFile bin(path.substr(0, path.find_last_of('/') + 1) + uri);
+    asset.data.assign(bin.Data(), bin.Data() + bin.Size());
+    return asset;
+}
+
+// A size x size grid displaced into hills, float positions, normals and UVs with 32 bit indices
+static Asset syntheticHills(unsigned int size, float phase)
+{
+    size_t vertexCount = (size_t)size * size;
+    size_t indexCount = (size_t)(size - 1) * (size - 1) * 6;
+    size_t indicesOffset = vertexCount * sizeof(Vertex);
+
+    Asset asset;
+    asset.data.resize(indicesOffset + indexCount * 4);
+    Vertex *vertices = (Vertex *)asset.data.data();
+    GLuint *indices = (GLuint *)&asset.data[indicesOffset];
+    for (unsigned int y = 0; y < size; y++)
+    {
+        for (unsigned int x = 0; x < size; x++)
+        {
+            float u = (float)x / (size - 1), v = (float)y / (size - 1);
+            float height = 0.2f * std::sin(u * 9.0f + phase) * std::cos(v * 7.0f - phase);
+            vertices[y * size + x] = Vertex{glm::vec3(u * 2.0f - 1.0f, height, v * 2.0f - 1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(u, v)};
+        }
+    }
+    for (unsigned int y = 0; y + 1 < size; y++)
+    {
+        for (unsigned int x = 0; x + 1 < size; x++)
+        {
+            GLuint corner = y * size + x;
+            GLuint quad[] = {corner, corner + size, corner + 1, corner + 1, corner + size, corner + size + 1};
+            std::memcpy(indices, quad, sizeof(quad));
+            indices += 6;
+        }
+    }
+
+    // Interleaved vertices, as exporters often write them
+    json &gltf = asset.gltf;
+    gltf["buffers"] = json::array({{{"byteLength", asset.data.size()}}});
+    gltf["bufferViews"] = json::array({
+        {{"buffer", 0}, {"byteOffset", 0}, {"byteLength", indicesOffset}, {"byteStride", sizeof(Vertex)}},
+        {{"buffer", 0}, {"byteOffset", indicesOffset}, {"byteLength", indexCount * 4}}});
+    gltf["accessors"] = json::array({
+        {{"bufferView", 0}, {"byteOffset", offsetof(Vertex, position)}, {"componentType", COMPONENT_FLOAT}, {"count", vertexCount}, {"type", "VEC3"}},
+        {{"bufferView", 0}, {"byteOffset", offsetof(Vertex, normal)}, {"componentType", COMPONENT_FLOAT}, {"count", vertexCount}, {"type", "VEC3"}},
+        {{"bufferView", 0}, {"byteOffset", offsetof(Vertex, texUV)}, {"componentType", COMPONENT_FLOAT}, {"count", vertexCount}, {"type", "VEC2"}},
+        {{"bufferView", 1}, {"componentType", COMPONENT_UNSIGNED_INT}, {"count", indexCount}, {"type", "SCALAR"}}});
+    gltf["meshes"] = json::array({{{"primitives", json::array({{{"attributes", {{"POSITION", 0}, {"NORMAL", 1}, {"TEXCOORD_0", 2}}}, {"indices", 3}}})}}});
+    return asset;
+}
+
+static AccessorView attribute(const Asset &asset, const json &primitive, const char *name)
+{
+    const json &attributes = primitive["attributes"];
+    if (!attributes.contains(name))
+        return AccessorView();
+    return AccessorView(asset.gltf, asset.gltf["accessors"][(unsigned int)attributes[name]], asset.data.data(), asset.data.size());
+}
+
+// Same steps as Model::decodePrimitive, returns the triangles of all levels so the work can't be skipped
+static size_t importPrimitive(const Job &job)
+{
+    const json &primitive = *job.primitive;
+    AccessorView positions = attribute(*job.asset, primitive, "POSITION");
+    AccessorView normals = attribute(*job.asset, primitive, "NORMAL");
+    AccessorView texUVs = attribute(*job.asset, primitive, "TEXCOORD_0");
+
+    std::vector<Vertex> vertices(positions.count);
+    if (vertices.empty())
+        return 0;
+    positions.CopyFloats(&vertices[0].position.x, 3, sizeof(Vertex));
+    if (normals.count == positions.count)
+        normals.CopyFloats(&vertices[0].normal.x, 3, sizeof(Vertex));
+    if (texUVs.count == positions.count)
+        texUVs.CopyFloats(&vertices[0].texUV.x, 2, sizeof(Vertex));
+
+    std::vector<GLuint> indices;
+    if (primitive.contains("indices"))
+    {
+        AccessorView view(job.asset->gltf, job.asset->gltf["accessors"][(unsigned int)primitive["indices"]], job.asset->data.data(), job.asset->data.size());
+        indices.resize(view.count);
+        view.CopyIndices(indices.data());
+    }
+    else
+    {
+        indices.resize(vertices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+            indices[i] = (GLuint)i;
+    }
+    if (indices.size() % 3 != 0)
+        return 0;
+
+    MeshOptimizer::Optimize(vertices, indices);
+    std::vector<MeshLOD> lods;
+    MeshOptimizer::GenerateLODs(vertices, indices, lods, MAX_MESH_LODS);
+    return indices.size() / 3;
+}
+
+// Best time of 'runs' imports of every job on 'threads' threads
+static double benchmark(const std::vector<Job> &jobs, unsigned int threads, int runs, size_t &triangles)
+{
+    // ThreadPool(0) sizes itself to the machine, so a single thread runs the jobs in place instead
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1)
+        pool.reset(new ThreadPool(threads - 1));
+
+    std::vector<size_t> results(jobs.size());
+    double best = 1e30;
+    for (int run = 0; run < runs; run++)
+    {
+        Clock::time_point start = Clock::now();
+        if (pool)
+        {
+            pool->ParallelFor(jobs.size(), [&](size_t i)
+                              { results[i] = importPrimitive(jobs[i]); });
+        }
+        else
+        {
+            for (size_t i = 0; i < jobs.size(); i++)
+                results[i] = importPrimitive(jobs[i]);
+        }
+        best = std::min(best, millisecondsSince(start));
+    }
+
+    triangles = 0;
+    for (size_t count : results)
+        triangles += count;
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int maxThreads = argc > 1 ? (unsigned int)std::max(1, std::atoi(argv[1])) : std::max(1u, std::thread::hardware_concurrency());
+    int synthetic = argc > 2 ? std::max(0, std::atoi(argv[2])) : 32;
+    int runs = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+
+    std::vector<std::string> paths;
+    for (int i = 4; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+    {
+        paths = {"res/models/monkey/monkey.gltf",
+                 "res/models/Shapes/abstract.gltf",
+                 "res/models/Shapes/bg.gltf",
+                 "res/models/Shapes/cube.gltf",
+                 "res/models/Shapes/icosphere.gltf",
+                 "res/models/Shapes/sphere.gltf"};
+    }
+
+    std::vector<Asset> assets;
+    assets.reserve(paths.size() + synthetic);
+    for (const std::string &path : paths)
+    {
+        try
+        {
+            assets.push_back(loadAsset(path));
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << path << ": " << e.what() << std::endl;
+        }
+    }
+    for (int i = 0; i < synthetic; i++)
+        assets.push_back(syntheticHills(96, (float)i));
+
+    std::vector<Job> jobs;
+    for (const Asset &asset : assets)
+        for (const json &mesh : asset.gltf["meshes"])
+            for (const json &primitive : mesh["primitives"])
+                jobs.push_back(Job{&asset, &primitive});
+
+    std::cout << jobs.size() << " primitive(s) from " << paths.size() << " model(s) and " << synthetic
+              << " synthetic mesh(es), best of " << runs << " run(s)" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "ms" << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << std::endl;
+
+    double serial = 0.0;
+    for (unsigned int threads = 1; threads <= maxThreads; threads++)
+    {
+        size_t triangles = 0;
+        double time = benchmark(jobs, threads, runs, triangles);
+        if (threads == 1)
+            serial = time;
+        double speedup = time > 0.0 ? serial / time : 0.0;
+        std::cout << std::setw(8) << threads << std::setw(12) << std::fixed << std::setprecision(2) << time
+                  << std::setw(9) << speedup << "x" << std::setw(11) << std::setprecision(0) << 100.0 * speedup / threads << "%"
+                  << std::endl;
+    }
+    return 0;
+}